@@ -18,6 +18,7 @@ DEFINE_int32 (epoch,       1,        "epochs");
 DEFINE_int32 (iters,       99999,    "iterations");
 DEFINE_double(init_scale,  0.1f,     "init random scale of variables");
 DEFINE_double(lr,          1.f,      "learning rate");
+DEFINE_string(activation_precision, "fp32", "storage of the saved activations(fp32/fp16/bf16)");
 
 int MAX_LEN = 56;
 int MAX_DEPENDENCY = 111;
@@ -203,7 +204,12 @@ int main(int argc, char* argv[]) {
   Sym loss = graph_output.FullyConnected(weight, bias).SoftmaxEntropyLoss(label_reshape);
   Sym train      = loss.Optimizer({}, FLAGS_lr);
   Sym perplexity = loss.Reduce_mean();
-  Session sess(OPT_BATCHING);
+  int opt = OPT_BATCHING;
+  if (FLAGS_activation_precision == "fp16")
+    opt += OPT_ACTIVATION_FP16;
+  else if (FLAGS_activation_precision == "bf16")
+    opt += OPT_ACTIVATION_BF16;
+  Session sess(opt);
   //int iterations = NUM_SAMPLES / FLAGS_batch_size; 
   int iterations = FLAGS_iters;
   //vector<float> input_data(FLAGS_batch_size*MAX_LEN, -1);
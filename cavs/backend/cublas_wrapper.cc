@@ -45,6 +45,24 @@ void MatMulMatCublasWrapper<double>(
       N, M, K, &alpha, B, ldb, A, lda, &beta, C, N));
 }
 
+template <>
+void BatchedMatMulMatCublasWrapper<float>(
+    cublasHandle_t handle,
+    const bool TransA, const bool TransB, 
+    const int M, const int N, const int K, 
+    const float alpha, const float* const* A, const float* const* B,
+    const float beta, float* const* C, const int batch) {
+  int lda = (TransA == false) ? K : M;
+  int ldb = (TransB == false) ? N : K;
+  cublasOperation_t cuTransA =
+      (TransA == false) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == false) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  checkCublasError(cublasSgemmBatched(handle,
+      cuTransB, cuTransA,
+      N, M, K, &alpha, B, ldb, A, lda, &beta, C, N, batch));
+}
+
 template <>
 void MatMulVecCublasWrapper<float>(
     const bool TransA,
@@ -17,6 +17,15 @@ void MatMulMatCublasWrapper(
     const T alpha, const T* A, const T* B,
     const T beta, T* C);
 
+//level3, the pointer arrays are in the device memory
+template <typename T>
+void BatchedMatMulMatCublasWrapper(
+    cublasHandle_t handle,
+    const bool TransA, const bool TransB, 
+    const int M, const int N, const int K, 
+    const T alpha, const T* const* A, const T* const* B,
+    const T beta, T* const* C, const int batch);
+
 //level2
 template <typename T>
 void MatMulVecCublasWrapper(
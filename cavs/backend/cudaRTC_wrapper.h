@@ -1,6 +1,7 @@
 #ifndef CAVS_BACKEND_CUDARTC_WRAPPER_H_
 #define CAVS_BACKEND_CUDARTC_WRAPPER_H_
 
+#include "cavs/backend/kernel_cache.h"
 #include "cavs/util/macros_gpu.h"
 
 #include <cuda.h>
@@ -39,14 +40,27 @@ class CudaRTCWrapper {
       checkCUDADriverError(cuModuleUnload(module_));
     }
   }
+  //the ptx is kept in the kernel cache,
+  //a warm start only loads it into the driver
   void Compile(const std::string& name, const std::string& src) {
+    const int flags_num = 2;
+    const char *compiler_flags[] =
+      {{"--gpu-architecture=compute_52"}, {"--fmad=false"}};
+    int major, minor;
+    checkNVRTCError(nvrtcVersion(&major, &minor));
+    const std::string key = KernelCache::Key(src,
+        "nvrtc " + std::to_string(major) + "." + std::to_string(minor),
+        std::string(compiler_flags[0]) + " " + compiler_flags[1]);
+    std::vector<char> nvrtc_ptx;
+    if (KernelCache::Lookup(key, ".ptx", &nvrtc_ptx)) {
+      Load(name, nvrtc_ptx);
+      return;
+    }
+
     nvrtcProgram prog;
     checkNVRTCError(nvrtcCreateProgram(&prog, src.c_str(),
                                        ("cavs_" + name + ".cu").c_str(),
                                        0, NULL, NULL));
-    const int flags_num = 2;
-    const char *compiler_flags[] =
-      {{"--gpu-architecture=compute_52"}, {"--fmad=false"}};
     nvrtcResult compile_result = nvrtcCompileProgram(prog, flags_num, compiler_flags);
     if (compile_result != NVRTC_SUCCESS) {
       size_t log_size;
@@ -61,16 +75,11 @@ class CudaRTCWrapper {
 
     size_t ptx_size;
     checkNVRTCError(nvrtcGetPTXSize(prog, &ptx_size));
-    std::vector<char> nvrtc_ptx(ptx_size);
+    nvrtc_ptx.resize(ptx_size);
     checkNVRTCError(nvrtcGetPTX(prog, nvrtc_ptx.data()));
     checkNVRTCError(nvrtcDestroyProgram(&prog));
-
-    if (module_loaded_) {
-      checkCUDADriverError(cuModuleUnload(module_));
-    }
-    checkCUDADriverError(cuModuleLoadDataEx(&module_, nvrtc_ptx.data(), 0, 0, 0));
-    module_loaded_ = true;
-    checkCUDADriverError(cuModuleGetFunction(&kernel_, module_, name.c_str()));
+    KernelCache::Insert(key, ".ptx", nvrtc_ptx);
+    Load(name, nvrtc_ptx);
   }
 
   void Launch(const std::vector<void*>& outputs,
@@ -78,27 +87,50 @@ class CudaRTCWrapper {
               const std::vector<int>& outputs_size,
               const std::vector<int>& inputs_size,
               unsigned int num_elements,
+              unsigned int num_cols,
+              void* partials,
+              void* arrived,
               unsigned int gridDimX,
               unsigned int gridDimY,
               unsigned int gridDimZ,
               unsigned int blockDimX,
               unsigned int blockDimY,
               unsigned int blockDimZ, 
-              cudaStream_t stream) {
+              cudaStream_t stream,
+              const std::vector<int*>& ids = {},
+              const std::vector<int>& ids_size = {},
+              const std::vector<int>& strides = {}) {
     CHECK(module_loaded_);
     CHECK(kernel_);
+    CHECK(ids.size() == ids_size.size() && ids.size() == strides.size());
     std::vector<void*> args;
     for (int i = 0; i < outputs.size(); i++) args.push_back((void*)(&outputs[i]));
     for (int i = 0; i < inputs.size(); i++)  args.push_back((void*)(&inputs[i]));
     for (int i = 0; i < outputs_size.size(); i++) args.push_back((void*)&outputs_size[i]);
     for (int i = 0; i < inputs_size.size(); i++) args.push_back((void*)&inputs_size[i]);
     args.push_back(&num_elements);
+    args.push_back(&num_cols);
+    args.push_back(&partials);
+    args.push_back(&arrived);
+    //the rows of the fused graph ops
+    for (int i = 0; i < ids.size(); i++)      args.push_back((void*)&ids[i]);
+    for (int i = 0; i < ids_size.size(); i++) args.push_back((void*)&ids_size[i]);
+    for (int i = 0; i < strides.size(); i++)  args.push_back((void*)&strides[i]);
     checkCUDADriverError(cuLaunchKernel(kernel_,
           gridDimX, gridDimY, gridDimZ, blockDimX, blockDimY, blockDimZ,
           0, stream, args.data(), 0));
   }
 
  private:
+  void Load(const std::string& name, const std::vector<char>& ptx) {
+    if (module_loaded_) {
+      checkCUDADriverError(cuModuleUnload(module_));
+    }
+    checkCUDADriverError(cuModuleLoadDataEx(&module_, ptx.data(), 0, 0, 0));
+    module_loaded_ = true;
+    checkCUDADriverError(cuModuleGetFunction(&kernel_, module_, name.c_str()));
+  }
+
   CUmodule module_;
   bool module_loaded_;
   CUfunction kernel_;
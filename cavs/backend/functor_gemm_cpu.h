@@ -0,0 +1,68 @@
+#ifndef CAVS_BACKEND_FUNCTOR_GEMM_CPU_H_
+#define CAVS_BACKEND_FUNCTOR_GEMM_CPU_H_
+
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace backend {
+
+//The rows [m_begin, m_end) of C(MxN) = op(A)(MxK) * op(B)(KxN), row-major,
+//for several pairs of A and C sharing B, the rows of the pairs are numbered
+//one after another(the row r is the row r%M of the pair r/M).
+//A panel of op(B) is packed into a contiguous block once for all the pairs,
+//so that each row of C is updated by the vectorized axpys over the block and
+//stays in the cache, the callers run their epilogue on the rows right after.
+template <typename T>
+void GemmRowsBatchedCPU(bool TransA, bool TransB, int M, int N, int K,
+                        const std::vector<const T*>& A, const T* B,
+                        const std::vector<T*>& C, int m_begin, int m_end) {
+  CHECK(A.size() == C.size());
+  const int kBlockK = 128;
+  const int kBlockN = 512;
+  thread_local std::vector<T> packed;
+  packed.resize(kBlockK * kBlockN);
+  for (int jj = 0; jj < N; jj += kBlockN) {
+    const int nc = std::min(kBlockN, N - jj);
+    for (int kk = 0; kk < K; kk += kBlockK) {
+      const int kc = std::min(kBlockK, K - kk);
+      for (int k = 0; k < kc; k++) {
+        T* dst = packed.data() + k*nc;
+        if (!TransB) {
+          std::copy(B + (kk+k)*N + jj, B + (kk+k)*N + jj + nc, dst);
+        }else {
+          for (int j = 0; j < nc; j++)
+            dst[j] = B[(jj+j)*K + kk+k];
+        }
+      }
+      for (int r = m_begin; r < m_end; r++) {
+        const int i = r % M;
+        const T* a_mat = A[r / M];
+        T* c = C[r / M] + i*N + jj;
+        if (kk == 0)
+          std::fill(c, c + nc, T(0));
+        for (int k = 0; k < kc; k++) {
+          const T a = TransA ? a_mat[(kk+k)*M + i] : a_mat[i*K + kk+k];
+          const T* b = packed.data() + k*nc;
+          for (int j = 0; j < nc; j++)
+            c[j] += a * b[j];
+        }
+      }
+    }
+  }
+  if (K == 0) {
+    for (int r = m_begin; r < m_end; r++)
+      std::fill(C[r / M] + (r % M)*N, C[r / M] + (r % M + 1)*N, T(0));
+  }
+}
+
+template <typename T>
+void GemmRowsCPU(bool TransA, bool TransB, int M, int N, int K,
+                 const T* A, const T* B, T* C, int m_begin, int m_end) {
+  GemmRowsBatchedCPU<T>(TransA, TransB, M, N, K, {A}, B, {C}, m_begin, m_end);
+}
+
+} //namespace backend
+
+#endif
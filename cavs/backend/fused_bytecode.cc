@@ -0,0 +1,151 @@
+#include "cavs/backend/fused_bytecode.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using std::vector;
+
+namespace backend {
+namespace RTC {
+
+namespace {
+
+//the loops over a tile are simple enough to be vectorized
+inline void Binary(BytecodeOp op, float* dst, const float* a, const float* b, int n) {
+  switch (op) {
+    case BC_ADD:
+      for (int i = 0; i < n; i++) dst[i] = a[i] + b[i];
+      break;
+    case BC_SUB:
+      for (int i = 0; i < n; i++) dst[i] = a[i] - b[i];
+      break;
+    case BC_MUL:
+      for (int i = 0; i < n; i++) dst[i] = a[i] * b[i];
+      break;
+    case BC_TANH_GRAD:
+      for (int i = 0; i < n; i++) dst[i] = a[i] * (1 - b[i]*b[i]);
+      break;
+    case BC_SIGMOID_GRAD:
+      for (int i = 0; i < n; i++) dst[i] = a[i] * (b[i]*(1-b[i]));
+      break;
+    default:
+      LOG(FATAL) << "Not a binary bytecode: " << op;
+  }
+}
+
+inline void Unary(BytecodeOp op, float* dst, const float* a, int n) {
+  switch (op) {
+    case BC_COPY:
+      memcpy(dst, a, n*sizeof(float));
+      break;
+    case BC_ACCUMULATE:
+      for (int i = 0; i < n; i++) dst[i] += a[i];
+      break;
+    case BC_TANH:
+      for (int i = 0; i < n; i++) dst[i] = tanhf(a[i]);
+      break;
+    case BC_SIGMOID:
+      for (int i = 0; i < n; i++) dst[i] = 1.f / (1.f + expf(-a[i]));
+      break;
+    case BC_RELU:
+      for (int i = 0; i < n; i++) dst[i] = fmaxf(0.f, a[i]);
+      break;
+    default:
+      LOG(FATAL) << "Not a unary bytecode: " << op;
+  }
+}
+
+//the arrays smaller than the elements are broadcast
+inline void LoadTile(float* dst, const float* src, int count, int start, int n) {
+  if (start % count + n <= count) {
+    memcpy(dst, src + start % count, n*sizeof(float));
+  }else {
+    for (int i = 0; i < n; i++) dst[i] = src[(start+i) % count];
+  }
+}
+
+} //namespace
+
+//odr-used by std::min
+const int BytecodeInterpreter::kTile;
+const int BytecodeInterpreter::kInstrLength;
+
+void BytecodeInterpreter::Load(const vector<int>& code, int num_registers) {
+  CHECK(code.size() % kInstrLength == 0) << code.size();
+  CHECK(num_registers > 0);
+  for (int pc = 0; pc < code.size(); pc += kInstrLength) {
+    CHECK(code[pc] >= 0 && code[pc] < BC_NUM_OPS) << code[pc];
+    if (code[pc] != BC_STORE)
+      CHECK(code[pc+1] >= 0 && code[pc+1] < num_registers);
+  }
+  code_ = code;
+  num_registers_ = num_registers;
+}
+
+void BytecodeInterpreter::Run(const vector<void*>& outputs,
+    const vector<const void*>& inputs,
+    const vector<int>& outputs_size,
+    const vector<int>& inputs_size,
+    int num_elements, int cols,
+    int row_begin, int row_end, int col_begin, int col_end) const {
+  CHECK(!code_.empty());
+  //the registers of the thread, reused by the following runs
+  thread_local vector<float> registers;
+  if (registers.size() < num_registers_*kTile)
+    registers.resize(num_registers_*kTile);
+  auto reg = [&](int r) { return registers.data() + r*kTile; };
+
+  //the tiles do not cross the rows, so a row vector is loaded by a copy
+  for (int row = row_begin; row < row_end; row++) {
+    const int end = row*cols + col_end;
+    for (int start = row*cols + col_begin; start < end; start += kTile) {
+      const int n = std::min(kTile, end - start);
+      for (int pc = 0; pc < code_.size(); pc += kInstrLength) {
+        const BytecodeOp op = static_cast<BytecodeOp>(code_[pc]);
+        const int dst = code_[pc+1], a = code_[pc+2], b = code_[pc+3];
+        switch (op) {
+          case BC_LOAD_INPUT:
+            LoadTile(reg(dst), static_cast<const float*>(inputs[a]),
+                     inputs_size[a], start, n);
+            break;
+          case BC_LOAD_OUTPUT:
+            LoadTile(reg(dst), static_cast<const float*>(outputs[a]),
+                     outputs_size[a], start, n);
+            break;
+          case BC_ZERO:
+            std::fill(reg(dst), reg(dst) + n, 0.f);
+            break;
+          case BC_STORE: {
+            float* out = static_cast<float*>(outputs[dst]);
+            const int count = outputs_size[dst];
+            if (count == num_elements) {
+              memcpy(out + start, reg(a), n*sizeof(float));
+            }else if (b >= 0) {
+              //reduced into, by the change from the value loaded
+              for (int i = 0; i < n; i++)
+                out[(start+i) % count] += reg(a)[i] - reg(b)[i];
+            }else {
+              for (int i = 0; i < n; i++)
+                out[(start+i) % count] = reg(a)[i];
+            }
+            break;
+          }
+          case BC_ADD:
+          case BC_SUB:
+          case BC_MUL:
+          case BC_TANH_GRAD:
+          case BC_SIGMOID_GRAD:
+            Binary(op, reg(dst), reg(a), reg(b), n);
+            break;
+          default:
+            Unary(op, reg(dst), reg(a), n);
+        }
+      }
+    }
+  }
+}
+
+} //namespace RTC
+} //namespace backend
@@ -0,0 +1,54 @@
+#ifndef CAVS_BACKEND_FUSED_BYTECODE_H_
+#define CAVS_BACKEND_FUSED_BYTECODE_H_
+
+#include <vector>
+
+namespace backend {
+namespace RTC {
+
+//A fused elementwise group as register bytecode, for the hosts without a
+//compiler at runtime. Each instruction is four ints: the opcode,
+//the destination and two operands. A register holds one tile of the
+//elements, so the intermediates of a tile stay in the L1 cache.
+enum BytecodeOp {
+  BC_LOAD_INPUT = 0,  //dst, input index
+  BC_LOAD_OUTPUT,     //dst, output index(the stateful outputs)
+  BC_ZERO,            //dst
+  BC_COPY,            //dst, a
+  BC_ADD,             //dst, a, b
+  BC_SUB,             //dst, a, b
+  BC_MUL,             //dst, a, b
+  BC_ACCUMULATE,      //dst += a
+  BC_TANH,            //dst, a
+  BC_SIGMOID,         //dst, a
+  BC_RELU,            //dst, a
+  BC_TANH_GRAD,       //dst, a(the gradient), b(the output)
+  BC_SIGMOID_GRAD,    //dst, a(the gradient), b(the output)
+  BC_STORE,           //output index, a, the register loaded from the output or -1
+  BC_NUM_OPS
+};
+
+class BytecodeInterpreter {
+ public:
+  static const int kTile = 256;
+  static const int kInstrLength = 4;
+  BytecodeInterpreter() : num_registers_(0) {}
+  void Load(const std::vector<int>& code, int num_registers);
+  //runs the block [row_begin, row_end) x [col_begin, col_end)
+  //of the loop(of cols columns), as the generated host kernels
+  void Run(const std::vector<void*>& outputs,
+           const std::vector<const void*>& inputs,
+           const std::vector<int>& outputs_size,
+           const std::vector<int>& inputs_size,
+           int num_elements, int cols,
+           int row_begin, int row_end, int col_begin, int col_end) const;
+
+ private:
+  std::vector<int> code_;
+  int num_registers_;
+};
+
+} //namespace RTC
+} //namespace backend
+
+#endif
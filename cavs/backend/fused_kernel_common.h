@@ -0,0 +1,40 @@
+#ifndef CAVS_BACKEND_FUSED_KERNEL_COMMON_H_
+#define CAVS_BACKEND_FUSED_KERNEL_COMMON_H_
+
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace backend {
+namespace RTC {
+
+//The loop of a fused kernel is a matrix of num_elements/cols rows.
+//The columns are the size of the outputs reduced into, which are summed by
+//the threads(shards) of their columns, otherwise the shortest broadcast
+//input of at least min_cols elements, so that the row vectors are indexed
+//by the column alone, otherwise the whole loop is one row.
+inline int FusedKernelColumns(const std::vector<int>& outputs_size,
+                              const std::vector<int>& inputs_size,
+                              int num_elements, int min_cols) {
+  int cols = num_elements;
+  for (int count : outputs_size) {
+    if (count < num_elements) {
+      CHECK(cols == num_elements || cols == count)
+        << "Reduced into " << cols << " and " << count << " elements";
+      cols = count;
+    }
+  }
+  if (cols == num_elements) {
+    for (int count : inputs_size) {
+      if (count >= min_cols && count < cols && num_elements % count == 0)
+        cols = count;
+    }
+  }
+  return std::max(cols, 1);
+}
+
+} //namespace RTC
+} //namespace backend
+
+#endif
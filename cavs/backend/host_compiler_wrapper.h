@@ -0,0 +1,172 @@
+#ifndef CAVS_BACKEND_HOST_COMPILER_WRAPPER_H_
+#define CAVS_BACKEND_HOST_COMPILER_WRAPPER_H_
+
+#include "cavs/backend/kernel_cache.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/macros.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace backend {
+namespace RTC {
+
+//Compiles the generated C++ into a shared object with the host compiler
+//($CXX, or c++), and loads the kernel with dlopen.
+//The object is kept in the kernel cache, otherwise the files are removed
+//once it is loaded. The cache may be shared by the hosts(a home directory
+//on NFS), so the objects are keyed by the cpu -march=native resolves to.
+class HostCompilerWrapper {
+ public:
+  typedef void (*Kernel)(void* const* outputs, const void* const* inputs,
+                         const int* outputs_count, const int* inputs_count,
+                         const int n_elements, const int n_cols,
+                         const int row_begin, const int row_end,
+                         const int col_begin, const int col_end);
+
+  HostCompilerWrapper() : handle_(NULL), kernel_(NULL) {}
+  ~HostCompilerWrapper() {
+    if (handle_) dlclose(handle_);
+  }
+
+  static std::string Compiler() {
+    const char* cxx = getenv("CXX");
+    return cxx ? cxx : "c++";
+  }
+  //the first line of --version, empty if the compiler does not run on this host
+  static const std::string& Version() {
+    static const std::string version = [] {
+      std::string line;
+      FILE* pipe = popen((Compiler() + " --version 2>/dev/null").c_str(), "r");
+      if (!pipe) return line;
+      char buf[256];
+      if (fgets(buf, sizeof(buf), pipe)) line = buf;
+      if (pclose(pipe) != 0) line.clear();
+      return line;
+    }();
+    return version;
+  }
+  static bool Available() { return !Version().empty(); }
+  //what -march=native means on this host: the target options the compiler
+  //resolves it to(only gcc prints them), and the model and the features
+  //of the cpu
+  static const std::string& Target() {
+    static const std::string target = [] {
+      std::string text;
+      char buf[4096];
+      FILE* pipe = popen((Compiler() + " -march=native -Q --help=target"
+                          " 2>/dev/null").c_str(), "r");
+      if (pipe) {
+        while (fgets(buf, sizeof(buf), pipe)) text += buf;
+        if (pclose(pipe) != 0) text.clear();
+      }
+      std::ifstream cpuinfo("/proc/cpuinfo");
+      std::string line;
+      while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0 ||
+            line.compare(0, 5, "flags") == 0 ||
+            line.compare(0, 8, "Features") == 0) {
+          text += line + "\n";
+        }
+        //the first core
+        if (line.empty() && !text.empty()) break;
+      }
+      return text;
+    }();
+    return target;
+  }
+
+  void Compile(const std::string& name, const std::string& src) {
+    //no contraction, as --fmad=false on the gpu
+    const std::string flags = "-O3 -march=native -ffp-contract=off -fPIC -shared";
+    const std::string key = KernelCache::Key(src, Compiler() + " " + Version(),
+                                             flags + "\n" + Target());
+    const std::string cached = KernelCache::Path(key, ".so");
+    if (KernelCache::Enabled() && access(cached.c_str(), R_OK) == 0) {
+      //a broken(or foreign) object is compiled again and replaced
+      if (Load(name, cached)) {
+        VLOG(V_DEBUG) << name << " is loaded from " << cached;
+        return;
+      }
+      LOG(WARNING) << "The cached " << cached << " of " << name
+                   << " can not be loaded, compiling it again";
+    }
+
+    char dir[] = "/tmp/cavs_rtc_XXXXXX";
+    CHECK(mkdtemp(dir)) << "Creating the directory for " << name;
+    const std::string prefix = std::string(dir) + "/" + name;
+    {
+      std::ofstream out(prefix + ".cc");
+      CHECK(out.is_open()) << prefix << ".cc";
+      out << src;
+    }
+    const std::string cmd = Compiler() + " " + flags
+      + " -o " + prefix + ".so " + prefix + ".cc > " + prefix + ".log 2>&1";
+    if (system(cmd.c_str()) != 0) {
+      std::ifstream log(prefix + ".log");
+      std::stringstream compile_log;
+      compile_log << log.rdbuf();
+      LOG(FATAL) << "Compile Error:\n" << cmd << "\n"
+                 << compile_log.str()
+                 << "\nKernel Source:\n" << src;
+    }
+
+    if (KernelCache::Enabled()) {
+      KernelCache::InsertFile(key, ".so", prefix + ".so");
+      CHECK(Load(name, cached)) << cached;
+    }else {
+      CHECK(Load(name, prefix + ".so")) << prefix << ".so";
+    }
+    for (const char* suffix : {".cc", ".so", ".log"})
+      remove((prefix + suffix).c_str());
+    rmdir(dir);
+  }
+
+  void Launch(const std::vector<void*>& outputs,
+              const std::vector<const void*>& inputs,
+              const std::vector<int>& outputs_size,
+              const std::vector<int>& inputs_size,
+              int num_elements, int cols,
+              int row_begin, int row_end, int col_begin, int col_end) const {
+    CHECK(kernel_);
+    kernel_(outputs.data(), inputs.data(),
+            outputs_size.data(), inputs_size.data(),
+            num_elements, cols, row_begin, row_end, col_begin, col_end);
+  }
+
+ private:
+  bool Load(const std::string& name, const std::string& so) {
+    if (handle_) dlclose(handle_);
+    kernel_ = NULL;
+    handle_ = dlopen(so.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle_) {
+      LOG(WARNING) << dlerror();
+      return false;
+    }
+    kernel_ = reinterpret_cast<Kernel>(dlsym(handle_, name.c_str()));
+    if (!kernel_) {
+      LOG(WARNING) << dlerror();
+      dlclose(handle_);
+      handle_ = NULL;
+      return false;
+    }
+    return true;
+  }
+
+  void* handle_;
+  Kernel kernel_;
+
+  DISALLOW_COPY_AND_ASSIGN(HostCompilerWrapper);
+};
+
+} //namespace RTC
+} //namespace backend
+
+#endif
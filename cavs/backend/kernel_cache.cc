@@ -0,0 +1,124 @@
+#include "cavs/backend/kernel_cache.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+namespace backend {
+namespace RTC {
+
+namespace {
+
+const string& CacheDir() {
+  static const string dir = [] {
+    const char* env = getenv("CAVS_KERNEL_CACHE");
+    if (env) return string(env);
+    const char* home = getenv("HOME");
+    return home ? string(home) + "/.cache/cavs/kernels" : string();
+  }();
+  return dir;
+}
+
+//mkdir -p
+bool MakeDirs(const string& dir) {
+  for (size_t pos = 1; pos != string::npos; ) {
+    pos = dir.find('/', pos + 1);
+    string sub = dir.substr(0, pos);
+    if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+  }
+  return true;
+}
+
+//another process may be writing the same entry,
+//so the entries only appear by a rename
+string TempName(const string& path) {
+  return path + ".tmp" + std::to_string(getpid());
+}
+
+} //namespace
+
+bool KernelCache::Enabled() {
+  static const bool enabled = [] {
+    if (CacheDir().empty())
+      return false;
+    if (!MakeDirs(CacheDir())) {
+      LOG(WARNING) << "The kernel cache " << CacheDir()
+                   << " is disabled: " << strerror(errno);
+      return false;
+    }
+    return true;
+  }();
+  return enabled;
+}
+
+string KernelCache::Key(const string& source, const string& compiler,
+                        const string& flags) {
+  return HashToString(GetStableHash(source + '\0' + compiler + '\0' + flags));
+}
+
+string KernelCache::Path(const string& key, const string& suffix) {
+  return CacheDir() + "/" + key + suffix;
+}
+
+bool KernelCache::Lookup(const string& key, const string& suffix,
+                         vector<char>* blob) {
+  if (!Enabled())
+    return false;
+  std::ifstream in(Path(key, suffix), std::ios::binary);
+  if (!in.is_open())
+    return false;
+  blob->assign(std::istreambuf_iterator<char>(in),
+               std::istreambuf_iterator<char>());
+  VLOG(V_DEBUG) << "Kernel " << key << suffix << " found in the cache";
+  return !blob->empty();
+}
+
+void KernelCache::Insert(const string& key, const string& suffix,
+                         const vector<char>& blob) {
+  if (!Enabled())
+    return;
+  const string path = Path(key, suffix);
+  const string tmp = TempName(path);
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out.is_open()) {
+      LOG(WARNING) << "Caching " << path << ": " << strerror(errno);
+      return;
+    }
+    out.write(blob.data(), blob.size());
+  }
+  if (rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Caching " << path << ": " << strerror(errno);
+    remove(tmp.c_str());
+  }
+}
+
+void KernelCache::InsertFile(const string& key, const string& suffix,
+                             const string& filename) {
+  if (!Enabled())
+    return;
+  const string path = Path(key, suffix);
+  //across the file systems, it is copied first
+  if (rename(filename.c_str(), path.c_str()) != 0) {
+    std::ifstream in(filename, std::ios::binary);
+    vector<char> blob((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+    Insert(key, suffix, blob);
+  }
+}
+
+} //namespace RTC
+} //namespace backend
@@ -0,0 +1,35 @@
+#ifndef CAVS_BACKEND_KERNEL_CACHE_H_
+#define CAVS_BACKEND_KERNEL_CACHE_H_
+
+#include <string>
+#include <vector>
+
+namespace backend {
+namespace RTC {
+
+//The compiled fused kernels(ptx for the gpu, shared objects for the cpu)
+//kept on disk across the processes, keyed by the hash of the source,
+//the compiler and its flags.
+//The directory is $CAVS_KERNEL_CACHE, or $HOME/.cache/cavs/kernels,
+//and the cache is disabled if CAVS_KERNEL_CACHE is set to empty.
+class KernelCache {
+ public:
+  static bool Enabled();
+  static std::string Key(const std::string& source,
+                         const std::string& compiler,
+                         const std::string& flags);
+  //the file of the entry, which may not exist yet
+  static std::string Path(const std::string& key, const std::string& suffix);
+  static bool Lookup(const std::string& key, const std::string& suffix,
+                     std::vector<char>* blob);
+  static void Insert(const std::string& key, const std::string& suffix,
+                     const std::vector<char>& blob);
+  //moves a file compiled elsewhere into the cache
+  static void InsertFile(const std::string& key, const std::string& suffix,
+                         const std::string& filename);
+};
+
+} //namespace RTC
+} //namespace backend
+
+#endif
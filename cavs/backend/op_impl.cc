@@ -22,12 +22,12 @@ void OpImplRegister::InitInternal(const string& name,
 
 } //namespace op_factory
 
-OpImpl* CreateOp(const OpDef& def) {
+OpImpl* CreateOp(const OpDef& def, Arena* arena) {
   const string& key = op_factory::Key(def).ToString();
   if (op_factory::GlobalOpImplRegistry()->count(key) == 0)
     return NULL;
   else
-    return op_factory::GlobalOpImplRegistry()->at(key)(def);
+    return op_factory::GlobalOpImplRegistry()->at(key)(def, arena);
 }
 
 } //namespace backend
@@ -2,6 +2,7 @@
 #define CAVS_BACKEND_OP_IMPL_H_
 
 #include "cavs/midend/op_context.h"
+#include "cavs/midend/arena.h"
 #include "cavs/proto/op_def.pb.h"
 #include "cavs/util/op_util.h"
 
@@ -10,10 +11,12 @@
 namespace backend {
 
 using ::midend::OpContext;
+using ::midend::Arena;
 
 class OpImpl {
  public:
   explicit OpImpl(const OpDef& def) : op_def_(def) {}
+  virtual ~OpImpl() {}
   //explicit Op(const OpDef& def): name_(def.name()) {}
   virtual void Compute(OpContext* context) = 0;
   std::string DebugInfo(int level=V_DEBUG) const {
@@ -23,11 +26,14 @@ class OpImpl {
       return op_def_.name();
   }
   std::string name() const { return op_def_.name(); }
+  const OpDef& op_def() const { return op_def_; }
  protected:
   OpDef op_def_;
 };
 
-OpImpl* CreateOp(const OpDef& def);
+//with an arena, the op is placed in it and destroyed with it,
+//otherwise the caller owns the op
+OpImpl* CreateOp(const OpDef& def, Arena* arena = NULL);
 
 #define REGISTER_OP_IMPL_BUILDER(key, ...)                         \
     REGISTER_OP_IMPL_BUILDER_UNIQ(__COUNTER__, key, __VA_ARGS__)
@@ -37,7 +43,9 @@ OpImpl* CreateOp(const OpDef& def);
     static op_factory::OpImplRegister                              \
       register_body_##ctr##_op_impl(                               \
         op_factory::key.ToString(),                                \
-          [](const OpDef& def) -> OpImpl* {                        \
+          [](const OpDef& def, Arena* arena) -> OpImpl* {          \
+              if (arena)                                           \
+                return arena->New<__VA_ARGS__>(def);               \
               return new __VA_ARGS__(def);                         \
             });
 
@@ -63,7 +71,7 @@ class Key {
 
 class OpImplRegister {
  public:
-  typedef OpImpl* (*Factory)(const OpDef& def);
+  typedef OpImpl* (*Factory)(const OpDef& def, Arena* arena);
 
   OpImplRegister(const std::string& name, Factory factory) {
     InitInternal(name, factory); 
@@ -0,0 +1,114 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/functor_gemm_cpu.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/midend/tensor.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace backend {
+
+using ::midend::OpContext;
+using ::midend::Tensor;
+using std::vector;
+
+template <typename T>
+class MatMulMatOpCPU : public OpImpl {
+ public:
+  explicit MatMulMatOpCPU(const OpDef& def)
+    : OpImpl(def), TransA(false), TransB(false) {
+    for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
+      if (t == 0) TransA = true;
+      if (t == 1) TransB = true;
+    }
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  bool TransA;
+  bool TransB;
+};
+
+template <typename T>
+void MatMulMatOpCPU<T>::Compute(OpContext* context) {
+  const Tensor& A = context->Input(0);
+  const Tensor& B = context->Input(1);
+  Tensor* C = context->Output(0);
+
+  int MA = (TransA == false)? A.dims(0) : A.dims(1);
+  int KA = (TransA == false)? A.dims(1) : A.dims(0);
+  int KB = (TransB == false)? B.dims(0) : B.dims(1);
+  int NB = (TransB == false)? B.dims(1) : B.dims(0);
+  CHECK(KA == KB);
+  CHECK(C->dims(0) == MA) << "C.dims(0): " << C->dims(0) << "\tMA: " << MA;
+  CHECK(C->dims(1) == NB) << "C.dims(1): " << C->dims(1) << "\tNB: " << NB;
+
+  const T* a = A.data<T>();
+  const T* b = B.data<T>();
+  T* c = C->mutable_data<T>();
+  //a fraction of a nanosecond per multiply-add
+  context->ParallelFor(MA, std::max(1.0, 0.25 * NB * KA), [&](int64_t begin, int64_t end) {
+    GemmRowsCPU<T>(TransA, TransB, MA, NB, KA, a, b, c, begin, end);
+  });
+  A.DebugNumerical<T>();
+  B.DebugNumerical<T>();
+  C->DebugNumerical<T>();
+}
+
+//The MatMuls sharing the weight B, merged by the GemmBatcher:
+//C_i = op(A_i) * op(B) for the inputs A_0, ..., A_n-1, B,
+//the panels of B are packed once for all of them
+template <typename T>
+class BatchedMatMulOpCPU : public OpImpl {
+ public:
+  explicit BatchedMatMulOpCPU(const OpDef& def)
+    : OpImpl(def), TransA(false), TransB(false) {
+    for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
+      if (t == 0) TransA = true;
+      if (t == 1) TransB = true;
+    }
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  bool TransA;
+  bool TransB;
+};
+
+template <typename T>
+void BatchedMatMulOpCPU<T>::Compute(OpContext* context) {
+  const int batch = context->OutputSize();
+  CHECK(context->InputSize() == batch + 1);
+  const Tensor& B = context->Input(batch);
+  int MA = (TransA == false)? context->Input(0).dims(0) : context->Input(0).dims(1);
+  int KA = (TransA == false)? context->Input(0).dims(1) : context->Input(0).dims(0);
+  int KB = (TransB == false)? B.dims(0) : B.dims(1);
+  int NB = (TransB == false)? B.dims(1) : B.dims(0);
+  CHECK(KA == KB);
+
+  vector<const T*> a;
+  vector<T*> c;
+  for (int i = 0; i < batch; i++) {
+    const Tensor& A = context->Input(i);
+    Tensor* C = context->Output(i);
+    CHECK(A.dims(0) == context->Input(0).dims(0) && A.dims(1) == context->Input(0).dims(1));
+    CHECK(C->dims(0) == MA) << "C.dims(0): " << C->dims(0) << "\tMA: " << MA;
+    CHECK(C->dims(1) == NB) << "C.dims(1): " << C->dims(1) << "\tNB: " << NB;
+    a.push_back(A.data<T>());
+    c.push_back(C->mutable_data<T>());
+  }
+  const T* b = B.data<T>();
+  context->ParallelFor(batch * MA, std::max(1.0, 0.25 * NB * KA), [&](int64_t begin, int64_t end) {
+    GemmRowsBatchedCPU<T>(TransA, TransB, MA, NB, KA, a, b, c, begin, end);
+  });
+  for (int i = 0; i < batch; i++) {
+    context->Input(i).DebugNumerical<T>();
+    context->Output(i)->DebugNumerical<T>();
+  }
+  B.DebugNumerical<T>();
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("MatMul").Device("CPU"), MatMulMatOpCPU<float>);
+REGISTER_OP_IMPL_BUILDER(Key("BatchedMatMul").Device("CPU"), BatchedMatMulOpCPU<float>);
+
+} //namespace backend
@@ -5,9 +5,12 @@
 #include "cavs/util/macros_gpu.h"
 #include "cavs/util/stream_event_handle_pool.h"
 
+#include <vector>
+
 namespace backend {
 
 using ::midend::Tensor;
+using std::vector;
 
 template <typename T>
 class MatMulMatOpCublas : public OpImpl {
@@ -69,6 +72,88 @@ void MatMulMatOpCublas<T>::Compute(OpContext* context) {
   C->DebugNumerical<T>();
 }
 
+//The MatMuls sharing the weight B, merged by the GemmBatcher:
+//C_i = op(A_i) * op(B) for the inputs A_0, ..., A_n-1, B, in one launch
+template <typename T>
+class BatchedMatMulOpCublas : public OpImpl {
+ public:
+  explicit BatchedMatMulOpCublas(const OpDef& def);
+  ~BatchedMatMulOpCublas() {
+    if (ptr_buf_) checkCudaError(cudaFree(ptr_buf_));
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  bool TransA;
+  bool TransB;
+  cublasHandle_t handle_;
+  //the pointers of A, B and C, copied at once
+  vector<void*> ptrs_;
+  void** ptr_buf_;
+  int ptr_buf_size_;
+};
+
+template <typename T>
+BatchedMatMulOpCublas<T>::BatchedMatMulOpCublas(const OpDef& def)
+    : OpImpl(def), TransA(false), TransB(false), handle_(NULL),
+      ptr_buf_(NULL), ptr_buf_size_(0) {
+  for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
+    if (t == 0) TransA = true;
+    if (t == 1) TransB = true;
+  }
+}
+
+template <typename T>
+void BatchedMatMulOpCublas<T>::Compute(OpContext* context) {
+  const int batch = context->OutputSize();
+  CHECK(context->InputSize() == batch + 1);
+  const Tensor& B = context->Input(batch);
+  int MA = (TransA == false)? context->Input(0).dims(0) : context->Input(0).dims(1);
+  int KA = (TransA == false)? context->Input(0).dims(1) : context->Input(0).dims(0);
+  int KB = (TransB == false)? B.dims(0) : B.dims(1);
+  int NB = (TransB == false)? B.dims(1) : B.dims(0);
+  CHECK(KA == KB);
+
+  ptrs_.resize(3*batch);
+  for (int i = 0; i < batch; i++) {
+    const Tensor& A = context->Input(i);
+    Tensor* C = context->Output(i);
+    CHECK(A.dims(0) == context->Input(0).dims(0) && A.dims(1) == context->Input(0).dims(1));
+    CHECK(C->dims(0) == MA) << "C.dims(0): " << C->dims(0) << "\tMA: " << MA;
+    CHECK(C->dims(1) == NB) << "C.dims(1): " << C->dims(1) << "\tNB: " << NB;
+    ptrs_[i]         = (void*)A.data<T>();
+    ptrs_[batch+i]   = (void*)B.data<T>();
+    ptrs_[2*batch+i] = (void*)C->mutable_data<T>();
+  }
+  if (ptrs_.size() > ptr_buf_size_) {
+    if (ptr_buf_) checkCudaError(cudaFree(ptr_buf_));
+    checkCudaError(cudaMalloc((void**)&ptr_buf_, ptrs_.size()*sizeof(void*)));
+    ptr_buf_size_ = ptrs_.size();
+  }
+
+  if (!handle_) {
+    if (context->GetStreamID() != -1) {
+      handle_ = StreamEventHandlePool::GetCublasHandle(context->GetStreamID());
+    }else {
+      handle_ = CudaCommon::cublasHandle();
+    }
+  }
+  cudaStream_t stream;
+  checkCublasError(cublasGetStream(handle_, &stream));
+  checkCudaError(cudaMemcpyAsync(ptr_buf_, ptrs_.data(), ptrs_.size()*sizeof(void*),
+                 cudaMemcpyHostToDevice, stream));
+
+  BatchedMatMulMatCublasWrapper<T>(handle_, TransA, TransB,
+      MA, NB, KA, 1.f, (const T* const*)ptr_buf_, (const T* const*)(ptr_buf_ + batch),
+      0, (T* const*)(ptr_buf_ + 2*batch), batch);
+  for (int i = 0; i < batch; i++) {
+    context->Input(i).DebugNumerical<T>();
+    context->Output(i)->DebugNumerical<T>();
+  }
+  B.DebugNumerical<T>();
+}
+
 REGISTER_OP_IMPL_BUILDER(Key("MatMul").Device("GPU"), MatMulMatOpCublas<float>);
+REGISTER_OP_IMPL_BUILDER(Key("BatchedMatMul").Device("GPU"), BatchedMatMulOpCublas<float>);
 
 } //namespace backend
@@ -0,0 +1,191 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/host_compiler_wrapper.h"
+#include "cavs/backend/fused_bytecode.h"
+#include "cavs/backend/fused_kernel_common.h"
+#include "cavs/backend/functor_gemm_cpu.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/midend/tensor.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace backend {
+
+using ::midend::OpContext;
+using ::midend::Tensor;
+using std::string;
+using std::vector;
+
+//The fused elementwise group generated for the cpu, compiled by the host
+//compiler, or interpreted when there is none(or CAVS_FUSION_INTERPRET is set).
+//A group headed by a MatMul computes the product block by block, and the
+//elementwise epilogue runs on each block while it is still in the cache,
+//the product not fetched is only buffered a tile of rows at a time
+//(the whole of it when the group is reduced over the rows).
+template <typename T>
+class HostFusedKernelOpImpl : public OpImpl {
+ public:
+  explicit HostFusedKernelOpImpl(const OpDef& def)
+    : OpImpl(def), TransA(false), TransB(false) {
+    gemm_ = GetSingleArg<bool>(def, "Gemm", false);
+    gemm_output_ = GetSingleArg<bool>(def, "GemmOutput", false);
+    if (gemm_) {
+      for (int t : GetListArg<int>(def, "GemmTranspose")) {
+        if (t == 0) TransA = true;
+        if (t == 1) TransB = true;
+      }
+    }
+    const char* interpret = getenv("CAVS_FUSION_INTERPRET");
+    interpreted_ = (interpret && string(interpret) != "0") ||
+                   !RTC::HostCompilerWrapper::Available();
+    if (interpreted_) {
+      interpreter_.Load(GetListArg<int>(def, "KernelBytecode"),
+                        GetSingleArg<int>(def, "KernelRegisters"));
+    }else {
+      const string& kernel_name = GetSingleArg<string>(def, "KernelName");
+      const string& kernel_src  = GetSingleArg<string>(def, "KernelSource");
+      wrapper_.Compile(kernel_name, kernel_src);
+    }
+  }
+
+  void Compute(OpContext* context) override;
+
+ private:
+  void Launch(const vector<void*>& outputs, const vector<const void*>& inputs,
+              const vector<int>& outputs_size, const vector<int>& inputs_size,
+              int num_elements, int cols,
+              int row_begin, int row_end, int col_begin, int col_end) const {
+    if (interpreted_)
+      interpreter_.Run(outputs, inputs, outputs_size, inputs_size,
+                       num_elements, cols, row_begin, row_end, col_begin, col_end);
+    else
+      wrapper_.Launch(outputs, inputs, outputs_size, inputs_size,
+                      num_elements, cols, row_begin, row_end, col_begin, col_end);
+  }
+  bool interpreted_;
+  RTC::HostCompilerWrapper wrapper_;
+  RTC::BytecodeInterpreter interpreter_;
+  bool gemm_;
+  bool gemm_output_;
+  bool TransA;
+  bool TransB;
+  //the product of a reduced group when it is not an output of the group
+  vector<T> gemm_buf_;
+};
+
+template <typename T>
+void HostFusedKernelOpImpl<T>::Compute(OpContext* context) {
+  vector<void*> outputs;
+  vector<const void*> inputs;
+  vector<int> outputs_size;
+  vector<int> inputs_size;
+  int num_elements = 0;
+  //the operands of the gemm are the first two inputs, its product is the
+  //last output(if materialized) and the first input of the kernel
+  const int gemm_inputs = gemm_ ? 2 : 0;
+  const int kernel_outputs = context->OutputSize() - (gemm_output_ ? 1 : 0);
+  int M = 0, N = 0, K = 0;
+  const T* a = NULL;
+  const T* b = NULL;
+  T* c = NULL;
+  if (gemm_) {
+    const Tensor& A = context->Input(0);
+    const Tensor& B = context->Input(1);
+    M = TransA ? A.dims(1) : A.dims(0);
+    K = TransA ? A.dims(0) : A.dims(1);
+    N = TransB ? B.dims(0) : B.dims(1);
+    CHECK(K == (TransB ? B.dims(1) : B.dims(0)));
+    a = A.data<T>();
+    b = B.data<T>();
+    if (gemm_output_) {
+      Tensor* C = context->Output(kernel_outputs);
+      CHECK(C->count() == M*N) << C->count() << "\t" << M << "\t" << N;
+      c = C->mutable_data<T>();
+    }
+    //set below when it is buffered
+    inputs.push_back(c);
+    inputs_size.push_back(M*N);
+    num_elements = M*N;
+  }
+  for (int i = 0; i < kernel_outputs; i++) {
+    outputs.push_back(context->Output(i)->mutable_data<T>());
+    outputs_size.push_back(context->Output(i)->count());
+    num_elements = std::max(num_elements, outputs_size.back());
+  }
+  for (int i = gemm_inputs; i < context->InputSize(); i++) {
+    inputs.push_back(context->Input(i).data<T>());
+    inputs_size.push_back(context->Input(i).count());
+    num_elements = std::max(num_elements, inputs_size.back());
+  }
+  //an output smaller than the others is reduced into,
+  //by the shards of its columns
+  bool reduced = false;
+  for (int count : outputs_size) {
+    CHECK(num_elements % count == 0) << count << "\t" << num_elements;
+    reduced |= (count < num_elements);
+  }
+  //a few nanoseconds per element and array
+  const double cost = 1 + outputs.size() + inputs.size();
+  if (gemm_ && !reduced) {
+    CHECK(num_elements == M*N) << num_elements << "\t" << M << "\t" << N;
+    //the rows of the loop are the rows of the product
+    const int kTileElements = 16384;
+    const int tile_rows = std::max(1, kTileElements / std::max(N, 1));
+    context->ParallelFor(M, std::max(1.0, 0.25 * N * K) + N * cost, [&](int64_t begin, int64_t end) {
+      if (gemm_output_) {
+        GemmRowsCPU<T>(TransA, TransB, M, N, K, a, b, c, begin, end);
+        Launch(outputs, inputs, outputs_size, inputs_size,
+               num_elements, N, begin, end, 0, N);
+        return;
+      }
+      thread_local vector<T> tile;
+      tile.resize(tile_rows * N);
+      vector<const void*> tile_inputs(inputs);
+      for (int64_t r = begin; r < end; r += tile_rows) {
+        const int64_t r_end = std::min<int64_t>(end, r + tile_rows);
+        //only the rows [r, r_end) of the product are written and read
+        T* c_tile = tile.data() - r * N;
+        GemmRowsCPU<T>(TransA, TransB, M, N, K, a, b, c_tile, r, r_end);
+        tile_inputs[0] = c_tile;
+        Launch(outputs, tile_inputs, outputs_size, inputs_size,
+               num_elements, N, r, r_end, 0, N);
+      }
+    });
+  }else {
+    if (gemm_ && !gemm_output_) {
+      gemm_buf_.resize(M*N);
+      c = gemm_buf_.data();
+      inputs[0] = c;
+    }
+    if (gemm_) {
+      context->ParallelFor(M, std::max(1.0, 0.25 * N * K), [&](int64_t begin, int64_t end) {
+        GemmRowsCPU<T>(TransA, TransB, M, N, K, a, b, c, begin, end);
+      });
+    }
+    //the vector lanes of a row
+    const int cols = RTC::FusedKernelColumns(outputs_size, inputs_size, num_elements, 16);
+    const int rows = num_elements / cols;
+    if (reduced || rows == 1) {
+      context->ParallelFor(cols, rows * cost, [&](int64_t begin, int64_t end) {
+        Launch(outputs, inputs, outputs_size, inputs_size,
+               num_elements, cols, 0, rows, begin, end);
+      });
+    }else {
+      context->ParallelFor(rows, cols * cost, [&](int64_t begin, int64_t end) {
+        Launch(outputs, inputs, outputs_size, inputs_size,
+               num_elements, cols, begin, end, 0, cols);
+      });
+    }
+  }
+  for (int i = 0; i < context->InputSize(); i++) {
+    context->Input(i).DebugNumerical<T>();
+  }
+  for (int i = 0; i < context->OutputSize(); i++) {
+    context->Output(i)->DebugNumerical<T>();
+  }
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("FusedKernel").Device("CPU"), HostFusedKernelOpImpl<float>);
+
+} //namespace backend
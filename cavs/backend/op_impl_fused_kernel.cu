@@ -1,6 +1,8 @@
 #include "cavs/backend/op_impl.h"
 #include "cavs/backend/cuda_common.h"
 #include "cavs/backend/cudaRTC_wrapper.h"
+#include "cavs/backend/fused_kernel_common.h"
+#include "cavs/midend/graph_scheduler.h"
 
 #include <string>
 #include <set>
@@ -10,6 +12,7 @@
 namespace backend {
 
 using ::midend::Tensor;
+using ::midend::GraphSchedulerBase;
 using std::string;
 using std::vector;
 using std::set;
@@ -18,17 +21,60 @@ template <typename T>
 class FusedKernelOpImpl : public OpImpl {
  public:
   explicit FusedKernelOpImpl(const OpDef& def)
-    : OpImpl(def), stream_(cudaStreamDefault)  {
+    : OpImpl(def), stream_(cudaStreamDefault),
+      idx_buf_(NULL), idx_buf_size_(0), push_index_(-1),
+      partial_buf_(NULL), partial_buf_size_(0),
+      arrived_buf_(NULL), arrived_buf_size_(0) {
     const string& kernel_name = GetSingleArg<string>(def, "KernelName"); 
     const string& kernel_src  = GetSingleArg<string>(def, "KernelSource"); 
     wrapper_.Compile(kernel_name, kernel_src);
+
+    //the gather/pull and scatter/push fused into the kernel
+    load_child_   = GetListArg<int>(def, "IndexedLoadChild");
+    load_stride_  = GetListArg<int>(def, "IndexedLoadStride");
+    store_child_  = GetListArg<int>(def, "IndexedStoreChild");
+    CHECK(load_child_.size() == load_stride_.size());
+    const vector<string>& stores = GetListArg<string>(def, "IndexedStores");
+    const string& pushed = GetSingleArg<string>(def, "PushedOutput", "");
+    store_index_.resize(stores.size(), -1);
+    for (int i = 0; i < def.output_size(); i++) {
+      for (int j = 0; j < stores.size(); j++) {
+        if (def.output(i) == stores[j]) store_index_[j] = i;
+      }
+      if (def.output(i) == pushed) push_index_ = i;
+    }
+    for (int i : store_index_) CHECK(i >= 0);
+    CHECK(pushed.empty() || push_index_ >= 0);
+  }
+  ~FusedKernelOpImpl() {
+    if (idx_buf_) checkCudaError(cudaFree(idx_buf_));
+    if (partial_buf_) checkCudaError(cudaFree(partial_buf_));
+    if (arrived_buf_) checkCudaError(cudaFree(arrived_buf_));
   }
 
   void Compute(OpContext* context) override;
 
  private:
+  bool HasGraphOps() const {
+    return !load_child_.empty() || !store_child_.empty() || push_index_ >= 0;
+  }
   RTC::CudaRTCWrapper wrapper_;
   cudaStream_t stream_;
+  vector<int> load_child_;
+  vector<int> load_stride_;
+  vector<int> store_child_;
+  vector<int> store_index_;
+  int push_index_;
+  //the ids of all the loads and stores, copied at once
+  vector<int> ids_;
+  int* idx_buf_;
+  int idx_buf_size_;
+  //the partial sums of the blocks of the reduced outputs, and the blocks
+  //arrived of each column, zero between the launches
+  float* partial_buf_;
+  int partial_buf_size_;
+  unsigned int* arrived_buf_;
+  int arrived_buf_size_;
 };
 
 template <typename T>
@@ -38,6 +84,13 @@ void FusedKernelOpImpl<T>::Compute(OpContext* context) {
   vector<int> outputs_size;
   vector<int> inputs_size;
   set<int> size_conf;
+  GraphSchedulerBase* gs = NULL;
+  int rows = 0;
+  if (HasGraphOps()) {
+    gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    rows = gs->GetJobId().size();
+  }
   /*const int num_elements = context->Input(0).count();*/
   for (int i = 0; i < context->OutputSize(); i++) {
     outputs.push_back((void*)(context->Output(i)->mutable_data<T>())); 
@@ -53,15 +106,101 @@ void FusedKernelOpImpl<T>::Compute(OpContext* context) {
     size_conf.insert(count);
     /*CHECK(context->Input(i).count() == num_elements);*/
   }
+
+  //the arguments of the graph ops follow the ones of the kernel,
+  //loads(inputs) first and then stores(outputs)
+  vector<int*> ids;
+  vector<int> ids_size;
+  vector<int> strides;
+  if (HasGraphOps()) {
+    ids_.clear();
+    vector<int> offsets;
+    for (int i = 0; i < load_child_.size(); i++) {
+      //the message passer for gather and the function argument for pull
+      const Tensor& src = (load_child_[i] >= 0) ? gs->GetMessagePasser(0)
+                                                : gs->GetFuncArg();
+      const vector<int>& tids = (load_child_[i] >= 0) ?
+          gs->CurrentRoundTensorIdsForGather(load_child_[i]) : gs->GetJobId();
+      inputs.push_back((void*)src.data<T>());
+      inputs_size.push_back(rows*load_stride_[i]);
+      size_conf.insert(rows*load_stride_[i]);
+      offsets.push_back(ids_.size());
+      ids_.insert(ids_.end(), tids.begin(), tids.end());
+      ids_size.push_back(tids.size());
+      strides.push_back(load_stride_[i]);
+    }
+    for (int i = 0; i < store_child_.size(); i++) {
+      //the scattered rows are placed by the ids, not by the round
+      Tensor* out = context->Output(store_index_[i]);
+      CHECK(out->IsDynamicShape());
+      CHECK(out->dims(0) == rows);
+      out->SetOffsetWithId(0);
+      outputs[store_index_[i]] = (void*)out->mutable_data<T>();
+      const vector<int>& tids = gs->CurrentRoundTensorIdsForScatter(store_child_[i]);
+      offsets.push_back(ids_.size());
+      ids_.insert(ids_.end(), tids.begin(), tids.end());
+      ids_size.push_back(tids.size());
+      strides.push_back(out->count()/out->dims(0));
+    }
+    if (ids_.size() > idx_buf_size_) {
+      if (idx_buf_) checkCudaError(cudaFree(idx_buf_));
+      checkCudaError(cudaMalloc((void**)&idx_buf_, ids_.size()*sizeof(int)));
+      idx_buf_size_ = ids_.size();
+    }
+    for (int offset : offsets)
+      ids.push_back(idx_buf_ + offset);
+  }
+
   CHECK(size_conf.size() <= 2);
   const int num_elements = *(size_conf.rbegin());
   if (!stream_ && context->GetStreamID() != -1) {
     stream_ = StreamEventHandlePool::GetCudaStream(context->GetStreamID());
     VLOG(V_DEBUG) << "[Unary] Assign new stream with ID " << context->GetStreamID();
   }
-  wrapper_.Launch(outputs, inputs, outputs_size, inputs_size, num_elements, 
-      BLOCKS_PER_GRID(num_elements), 1, 1,
-      THREADS_PER_BLOCK, 1, 1, stream_);
+  if (!ids_.empty()) {
+    checkCudaError(cudaMemcpyAsync(idx_buf_, ids_.data(), ids_.size()*sizeof(int),
+                   cudaMemcpyHostToDevice, stream_));
+  }
+  //A block of up to 32 columns and the rest of its threads as the rows,
+  //so that the short rows(of the lstm and the tree cells) fill the blocks.
+  //The reduced outputs are summed by the blocks, then over a few blocks
+  //per column. Otherwise a loop of few rows gives its threads back to
+  //the columns.
+  bool reduced = false;
+  for (int count : outputs_size)
+    reduced |= (count < num_elements);
+  const int cols = RTC::FusedKernelColumns(outputs_size, inputs_size, num_elements, 32);
+  const int loop_rows = num_elements / cols;
+  int block_x = 1;
+  while (block_x < std::min(cols, 32))
+    block_x <<= 1;
+  int block_y = THREADS_PER_BLOCK / block_x;
+  while (!reduced && block_y > 1 && block_y/2 >= loop_rows) {
+    block_y >>= 1;
+    block_x <<= 1;
+  }
+  const int grid_x = (cols + block_x - 1) / block_x;
+  const int kMaxRowBlocks = reduced ? 64 : 65535;
+  const int grid_y = std::min((loop_rows + block_y - 1) / block_y, kMaxRowBlocks);
+  if (reduced) {
+    const int partials = context->OutputSize() * grid_y * cols;
+    if (partials > partial_buf_size_) {
+      if (partial_buf_) checkCudaError(cudaFree(partial_buf_));
+      checkCudaError(cudaMalloc((void**)&partial_buf_, partials*sizeof(float)));
+      partial_buf_size_ = partials;
+    }
+    if (grid_x > arrived_buf_size_) {
+      if (arrived_buf_) checkCudaError(cudaFree(arrived_buf_));
+      checkCudaError(cudaMalloc((void**)&arrived_buf_, grid_x*sizeof(unsigned int)));
+      checkCudaError(cudaMemsetAsync(arrived_buf_, 0, grid_x*sizeof(unsigned int), stream_));
+      arrived_buf_size_ = grid_x;
+    }
+  }
+  wrapper_.Launch(outputs, inputs, outputs_size, inputs_size, num_elements, cols,
+      partial_buf_, arrived_buf_, grid_x, grid_y, 1,
+      block_x, block_y, 1, stream_, ids, ids_size, strides);
+  if (push_index_ >= 0)
+    gs->SetFuncRet(*context->Output(push_index_));
   for (int i = 0; i < context->InputSize(); i++) {
     context->Input(i).DebugNumerical<T>();
   }
@@ -295,7 +295,8 @@ class GraphPullOp : public OpImpl {
     //out tensor must be local
     //if in tensor is a global tensor(in the backward of pull)
     //CHECK(inp.IsFullShape());
-    const vector<int>& gids = gs->GetJobId();
+    //hoisted out of the rounds, it pulls the vertices of all the rounds
+    const vector<int>& gids = gs->Terminate() ? gs->GetAllJobIds() : gs->GetJobId();
 
     // {
     //   std::cout << "[PULL_OP] Pulling for gids " << std::endl;
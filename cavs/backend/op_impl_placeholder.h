@@ -2,10 +2,12 @@
 #define CAVS_BACKEND_OP_IMPL_PLACEHOLDER_H_
 
 #include "cavs/backend/op_impl.h"
+#include "cavs/backend/paged_file.h"
 #include "cavs/midend/tensor.h"
 #include "cavs/proto/tensor_shape.pb.h"
 
 #include <string>
+#include <memory>
 #include <mpi.h>
 
 namespace backend {
@@ -22,11 +24,13 @@ class PlaceholderOpImpl : public OpImpl {
   }
 };
 
+//READFUNCTOR gives the byte offset of this worker's part in the file,
+//the file is mapped and only the current batch is copied to the device
 template <typename READFUNCTOR, typename COPYFUNCTOR, typename T, bool MPIEnable>//read, copy
 class DataOpImpl : public OpImpl {
  public:
   explicit DataOpImpl(const OpDef& def) :
-    OpImpl(def), buf_(NULL), curr_idx_(-1) {
+    OpImpl(def), curr_idx_(-1) {
     batch_ = GetSingleArg<int>(def, "Batch");
     const std::vector<int>& shape = GetListArg<int>(def, "Shape");
     CHECK(!shape.empty());
@@ -45,22 +49,21 @@ class DataOpImpl : public OpImpl {
       num_ /= size;
     }
   }
-  ~DataOpImpl() {
-    if (buf_)  free(buf_); 
-  }
 
   void Compute(OpContext* context) override {
-    if (!buf_) {
-      buf_ = (T*)malloc(num_*item_size_*sizeof(T));
-      READFUNCTOR::Compute(buf_, filename_.c_str(), num_*item_size_*sizeof(T));
+    if (!file_) {
+      size_t bytes = (size_t)num_*item_size_*sizeof(T);
+      file_.reset(new PagedFile(filename_, READFUNCTOR::Offset(bytes),
+            num_/batch_, (size_t)batch_*item_size_*sizeof(T), false));
     }
     int next_idx = context->round() % (num_/batch_);
     if (next_idx != curr_idx_) {
       Tensor* out = context->Output(0);
       CHECK(out->count() == batch_*item_size_);
       CHECK(next_idx >= 0 && next_idx < num_/batch_);
-      COPYFUNCTOR::Compute(out->mutable_data<T>(), buf_+next_idx*batch_*item_size_, batch_*item_size_*sizeof(T));
+      COPYFUNCTOR::Compute(out->mutable_data<T>(), file_->Batch(next_idx), batch_*item_size_*sizeof(T));
       curr_idx_ = next_idx;
+      file_->Prefetch((next_idx+1) % (num_/batch_));
     }
   }
 
@@ -70,7 +73,7 @@ class DataOpImpl : public OpImpl {
   int num_;
   int item_size_;
   std::string filename_;
-  T* buf_;
+  std::unique_ptr<PagedFile> file_;
 };
 
 } //namespace cavs
@@ -346,7 +346,7 @@ void RNNOpCudnn<T>::Compute(OpContext* context) {
       if (this->rnn_trainningreserve_)
         this->alloc_->template Deallocate<char>((char*)(this->rnn_trainningreserve_));
       this->rnn_trainningreserve_ = (this->alloc_)->template Allocate<char>(this->rnn_trainingreserve_sizeInBytes_);
-      context->repo_[Y->name()] = this->rnn_trainningreserve_;
+      context->repo()[Y->name()] = this->rnn_trainningreserve_;
     }
   }
 
@@ -432,8 +432,8 @@ void RNNOpCudnnGrad<T>::Compute(OpContext* context) {
           &workspace_size));
     if (workspace_size != this->rnn_trainingreserve_sizeInBytes_) {
       this->rnn_trainingreserve_sizeInBytes_ = workspace_size;
-      CHECK(context->repo_.find(Y.name()) != context->repo_.end());
-      this->rnn_trainningreserve_ = context->repo_[Y.name()];
+      CHECK(context->repo().find(Y.name()) != context->repo().end());
+      this->rnn_trainningreserve_ = context->repo()[Y.name()];
       CHECK(this->rnn_trainningreserve_);
     }
   }
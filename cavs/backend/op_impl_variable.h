@@ -4,11 +4,14 @@
 #include "cavs/backend/op_impl.h"
 #include "cavs/backend/op_impl_mpi_functor.h"
 #include "cavs/backend/cuda_common.h"
+#include "cavs/backend/paged_file.h"
 #include "cavs/midend/op_context.h"
 #include "cavs/midend/tensor.h"
 
 #include <vector>
 #include <random>
+#include <memory>
+#include <string>
 
 using std::vector;
 
@@ -21,13 +24,20 @@ template <typename FILLFUNCTOR, typename T, typename BCASTFUNCTOR=bool>//fillop,
 class VariableOpImpl : public OpImpl {
  public:
   explicit VariableOpImpl(const OpDef& def)
-    : OpImpl(def), initialized_(false) {}
+    : OpImpl(def), initialized_(GetSingleArg<bool>(def, "Shared", false)) {}
   void Compute(OpContext* context) override;
 
  private:
+  //a replica of a shared variable is filled by the source session
   bool initialized_;
 };
 
+//The DDV lives in a mapped file(the "filename" attribute, or an unnamed
+//temporary one), only the rows of the current batch are on the device.
+//The batches are filled when they are visited the first time, unless
+//they have been written back to the file(by this or a former session).
+//The current batch is written back when the next one is swapped in,
+//and when the op is destroyed with its session.
 template <typename FILLFUNCTOR, typename T, bool MPIEnable>//fillop, dtype
 class DDVOpImpl : public OpImpl {
  public:
@@ -36,11 +46,17 @@ class DDVOpImpl : public OpImpl {
   void Compute(OpContext* context) override;
 
  private:
+  void WriteBack();
+
   int curr_idx_;
-  T* buf_;
+  //the device rows of the current batch
+  Tensor rows_;
   int batch_;
   int num_;
   int item_size_;
+  std::string filename_;
+  std::unique_ptr<PagedFile> file_;
+  std::vector<bool> filled_;
 };
 
 template <typename T>
@@ -163,7 +179,7 @@ inline void VariableOpImpl<FILLFUNCTOR, T, BCASTFUNCTOR>::Compute(OpContext* con
 
 template <typename FILLFUNCTOR, typename T, bool MPIEnable>//fillop, dtype
 inline DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::DDVOpImpl(const OpDef& def)
-    : OpImpl(def), buf_(NULL), curr_idx_(-1) {
+    : OpImpl(def), curr_idx_(-1) {
   batch_ = GetSingleArg<int>(def, "Batch");
   const std::vector<int>& shape = GetListArg<int>(def, "Shape");
   CHECK(!shape.empty());
@@ -173,46 +189,73 @@ inline DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::DDVOpImpl(const OpDef& def)
   for (int i = 1; i < shape.size(); i++)
     item_size_ *= shape[i];
   CHECK(item_size_ > 0);
+  filename_ = GetSingleArg<std::string>(def, "filename", "");
   if (MPIEnable) {
-    int size;
+    int size, rank;
     MPI_Comm_size(MPI_COMM_WORLD, &size); 
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank); 
     num_ /= size;
+    //each worker writes its own part
+    if (!filename_.empty())
+      filename_ += "." + std::to_string(rank);
   }
 }
 
 template <typename FILLFUNCTOR, typename T, bool MPIEnable>//fillop, dtype
 inline DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::~DDVOpImpl() {
-  if (buf_) free(buf_);
+  //the file is synced when it is closed
+  if (curr_idx_ >= 0)
+    WriteBack();
+}
+
+//the updated rows leave the device now,
+//and reach the file in the background
+template <typename FILLFUNCTOR, typename T, bool MPIEnable>//fillop, dtype
+void DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::WriteBack() {
+  CHECK(file_ && curr_idx_ >= 0);
+  checkCudaError(cudaMemcpy(file_->StagingBuffer(),
+        rows_.data<T>(),
+        rows_.count()*sizeof(T),
+        cudaMemcpyDeviceToHost));
+  file_->WriteBackAsync(curr_idx_);
 }
 
 template <typename FILLFUNCTOR, typename T, bool MPIEnable>//fillop, dtype
 void DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::Compute(OpContext* context) {
-  if (!buf_) {
-    buf_ = (T*)malloc(num_*item_size_*sizeof(T));
-    FILLFUNCTOR(op_def_).Compute(buf_, num_*item_size_);
+  const int batches = num_/batch_;
+  if (!file_) {
+    size_t batch_bytes = (size_t)batch_*item_size_*sizeof(T);
+    if (filename_.empty())
+      file_.reset(new PagedFile(batches, batch_bytes));
+    else
+      file_.reset(new PagedFile(filename_, 0, batches, batch_bytes, true, true));
+    filled_.resize(batches);
+    for (int i = 0; i < batches; i++)
+      filled_[i] = file_->filled(i);
   }
-  int next_idx = (context->round() % (num_/batch_));
+  int next_idx = (context->round() % batches);
   if (next_idx != curr_idx_) {
     //LOG(INFO) << "Next idx: " << next_idx << "\tCurr idx: " << curr_idx_;
     //LOG(INFO) << "batch: " << batch_ << "\titem_size: " << item_size_;
-    //LOG(INFO) << "Next idx: " << next_idx
-              //<< "\tCurr idx: " << curr_idx_
-              //<< "\tRound: " << context->GetRound();
     Tensor* out = context->Output(0);
-    if (curr_idx_ >= 0) {
-      checkCudaError(cudaMemcpy(buf_+curr_idx_*batch_*item_size_,
-            out->mutable_data<T>(),
-            out->count()*sizeof(T), 
-            cudaMemcpyDeviceToHost));
-    }
-    CHECK(next_idx >= 0 && next_idx < num_/batch_)
+    CHECK(next_idx >= 0 && next_idx < batches)
       << next_idx << "\t" << num_ << "\t" << batch_;
     CHECK(out->count() == batch_*item_size_);
+    if (curr_idx_ >= 0)
+      WriteBack();
+    rows_ = *out;
+    T* rows = (T*)file_->Batch(next_idx);
+    if (!filled_[next_idx]) {
+      FILLFUNCTOR(op_def_).Compute(rows, batch_*item_size_);
+      filled_[next_idx] = true;
+    }
     checkCudaError(cudaMemcpy(out->mutable_data<T>(), 
-          buf_+next_idx*batch_*item_size_,
+          rows,
           out->count()*sizeof(T), 
           cudaMemcpyHostToDevice));
     curr_idx_ = next_idx;
+    if (filled_[(next_idx+1) % batches])
+      file_->Prefetch((next_idx+1) % batches);
     out->DebugNumerical<T>();
   }
 }
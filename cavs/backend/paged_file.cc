@@ -0,0 +1,223 @@
+#include "cavs/backend/paged_file.h"
+#include "cavs/util/logging.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+using std::string;
+
+namespace backend {
+
+static size_t PageSize() {
+  static size_t page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+}
+
+static const char kPagedFileMagic[8] = {'C', 'A', 'V', 'S', 'P', 'G', 'F', '1'};
+
+PagedFile::PagedFile(const string& filename, size_t offset,
+    int num_batches, size_t batch_bytes, bool writable, bool tracked)
+    : num_batches_(num_batches), batch_bytes_(batch_bytes),
+      preexisting_(false), header_(NULL), map_(NULL), map_len_(0), base_(NULL),
+      busy_(false), stop_(false) {
+  CHECK(num_batches_ > 0 && batch_bytes_ > 0);
+  CHECK(!tracked || writable) << "only the writable files are tracked";
+  int fd = open(filename.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+  if (fd < 0)
+    LOG(FATAL) << "file[" << filename << "] can not be opened: " << strerror(errno);
+  struct stat st;
+  CHECK(fstat(fd, &st) == 0);
+  size_t header_bytes = tracked ? HeaderBytes() : 0;
+  size_t required = offset + header_bytes + num_batches_*batch_bytes_;
+  preexisting_ = ((size_t)st.st_size >= required);
+  if (!preexisting_) {
+    CHECK(writable) << "file[" << filename << "] has " << st.st_size
+                    << " bytes, while " << required << " bytes are required";
+    CHECK(ftruncate(fd, required) == 0) << strerror(errno);
+  }
+  Map(fd, offset, header_bytes, writable);
+  close(fd);
+  if (tracked) {
+    header_ = reinterpret_cast<Header*>(base_ - header_bytes);
+    //a file of another layout(or none) has no batch written back
+    if (!preexisting_ ||
+        memcmp(header_->magic, kPagedFileMagic, sizeof(kPagedFileMagic)) != 0 ||
+        header_->num_batches != num_batches_ ||
+        header_->batch_bytes != (int64_t)batch_bytes_) {
+      if (st.st_size > 0)
+        LOG(WARNING) << "file[" << filename << "] is not a complete paged file"
+                     << " of " << num_batches_ << " x " << batch_bytes_
+                     << " bytes, its batches are filled again";
+      memset(header_, 0, header_bytes);
+      memcpy(header_->magic, kPagedFileMagic, sizeof(kPagedFileMagic));
+      header_->num_batches = num_batches_;
+      header_->batch_bytes = batch_bytes_;
+      msync(map_, base_ - map_, MS_SYNC);
+      preexisting_ = false;
+    }
+  }
+  worker_ = std::thread(&PagedFile::Worker, this);
+}
+
+PagedFile::PagedFile(int num_batches, size_t batch_bytes)
+    : num_batches_(num_batches), batch_bytes_(batch_bytes),
+      preexisting_(false), header_(NULL), map_(NULL), map_len_(0), base_(NULL),
+      busy_(false), stop_(false) {
+  CHECK(num_batches_ > 0 && batch_bytes_ > 0);
+  const char* dir = getenv("TMPDIR");
+  string pattern = string(dir ? dir : "/tmp") + "/cavs_paged_XXXXXX";
+  std::vector<char> name(pattern.begin(), pattern.end());
+  name.push_back('\0');
+  int fd = mkstemp(name.data());
+  CHECK(fd >= 0) << pattern << ": " << strerror(errno);
+  //the pages are still reachable through the mapping
+  unlink(name.data());
+  CHECK(ftruncate(fd, num_batches_*batch_bytes_) == 0) << strerror(errno);
+  Map(fd, 0, 0, true);
+  close(fd);
+  worker_ = std::thread(&PagedFile::Worker, this);
+}
+
+PagedFile::~PagedFile() {
+  Sync();
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  worker_.join();
+  if (map_) {
+    msync(map_, map_len_, MS_SYNC);
+    munmap(map_, map_len_);
+  }
+}
+
+//the header and the flags, the batches start on a page
+size_t PagedFile::HeaderBytes() const {
+  size_t bytes = sizeof(Header) + num_batches_;
+  return (bytes + PageSize() - 1) / PageSize() * PageSize();
+}
+
+bool PagedFile::filled(int idx) {
+  CHECK(idx >= 0 && idx < num_batches_) << idx << "\t" << num_batches_;
+  if (!header_)
+    return preexisting_;
+  std::lock_guard<std::mutex> lock(mu_);
+  return reinterpret_cast<const char*>(header_ + 1)[idx] != 0;
+}
+
+void PagedFile::Map(int fd, size_t offset, size_t header_bytes, bool writable) {
+  //mmap requires a page aligned offset
+  size_t aligned = offset / PageSize() * PageSize();
+  map_len_ = offset - aligned + header_bytes + num_batches_*batch_bytes_;
+  map_ = (char*)mmap(NULL, map_len_,
+                     writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                     MAP_SHARED, fd, aligned);
+  CHECK(map_ != MAP_FAILED) << "mmap " << map_len_ << " bytes: " << strerror(errno);
+  //the batches are visited one after another, but the kernel readahead
+  //would only be useful inside a batch, we prefetch the batch ourselves
+  madvise(map_, map_len_, MADV_RANDOM);
+  base_ = map_ + (offset - aligned) + header_bytes;
+}
+
+char* PagedFile::Batch(int idx) {
+  CHECK(idx >= 0 && idx < num_batches_) << idx << "\t" << num_batches_;
+  WaitFor(idx);
+  return base_ + idx*batch_bytes_;
+}
+
+void PagedFile::Prefetch(int idx) {
+  CHECK(idx >= 0 && idx < num_batches_) << idx << "\t" << num_batches_;
+  char* begin = base_ + idx*batch_bytes_;
+  size_t len = batch_bytes_;
+  Schedule([begin, len]() {
+    char* aligned = (char*)((size_t)begin / PageSize() * PageSize());
+    madvise(aligned, begin + len - aligned, MADV_WILLNEED);
+    //WILLNEED only starts the reads, touching the pages waits for them
+    volatile char sink = 0;
+    for (size_t i = 0; i < len; i += PageSize())
+      sink += begin[i];
+    (void)sink;
+  });
+}
+
+char* PagedFile::StagingBuffer() {
+  {
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return pending_writes_.empty(); });
+  }
+  if (staging_.empty())
+    staging_.resize(batch_bytes_);
+  return staging_.data();
+}
+
+void PagedFile::WriteBackAsync(int idx) {
+  CHECK(idx >= 0 && idx < num_batches_) << idx << "\t" << num_batches_;
+  CHECK(!staging_.empty());
+  char* dst = base_ + idx*batch_bytes_;
+  const char* src = staging_.data();
+  size_t len = batch_bytes_;
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    pending_writes_.insert(idx);
+  }
+  Schedule([this, idx, dst, src, len]() {
+    memcpy(dst, src, len);
+    char* aligned = (char*)((size_t)dst / PageSize() * PageSize());
+    //the batch is on the disk before it is marked as written
+    msync(aligned, dst + len - aligned, header_ ? MS_SYNC : MS_ASYNC);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      if (header_)
+        reinterpret_cast<char*>(header_ + 1)[idx] = 1;
+      pending_writes_.erase(idx);
+    }
+    if (header_)
+      msync(map_, base_ - map_, MS_ASYNC);
+  });
+}
+
+void PagedFile::Sync() {
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this] { return tasks_.empty() && !busy_; });
+}
+
+void PagedFile::Schedule(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    tasks_.push_back(std::move(task));
+  }
+  cv_.notify_all();
+}
+
+void PagedFile::WaitFor(int idx) {
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this, idx] { return pending_writes_.count(idx) == 0; });
+}
+
+void PagedFile::Worker() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+      busy_ = true;
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      busy_ = false;
+    }
+    cv_.notify_all();
+  }
+}
+
+} //namespace backend
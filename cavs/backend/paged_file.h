@@ -0,0 +1,93 @@
+#ifndef CAVS_BACKEND_PAGED_FILE_H_
+#define CAVS_BACKEND_PAGED_FILE_H_
+
+#include "cavs/util/macros.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace backend {
+
+//A file of [num_batches x batch_bytes] records mapped into the address
+//space, so that only the batches being visited are resident.
+//Reading ahead the next batch and writing back the dirty one are done
+//by a background thread, which overlaps the disk traffic with the
+//computation of the current batch.
+//A tracked file starts with a header recording which batches have been
+//written back, so that a file cut short(or never fully written) is not
+//taken as the contents of its batches.
+class PagedFile {
+ public:
+  //offset and the total size are in bytes,
+  //the file is created(or extended) if it is writable
+  PagedFile(const std::string& filename, size_t offset,
+            int num_batches, size_t batch_bytes, bool writable,
+            bool tracked = false);
+  //an unnamed temporary file, the contents are discarded when it is closed
+  PagedFile(int num_batches, size_t batch_bytes);
+  ~PagedFile();
+
+  //the pointer to the batch in the mapping,
+  //it waits for the pending write-back of the same batch
+  char* Batch(int idx);
+  //fault in the pages of the batch in the background
+  void Prefetch(int idx);
+  //the host buffer the dirty batch is copied into before it is written back,
+  //it waits for the previous write-back to complete
+  char* StagingBuffer();
+  //copy the staging buffer into the batch in the background
+  void WriteBackAsync(int idx);
+  //wait for all the background work
+  void Sync();
+
+  FORCE_INLINE int num_batches() const { return num_batches_; }
+  FORCE_INLINE size_t batch_bytes() const { return batch_bytes_; }
+  //whether the file existed with the contents before being mapped
+  FORCE_INLINE bool preexisting() const { return preexisting_; }
+  //whether the batch holds its contents, only the batches written back
+  //are for a tracked file
+  bool filled(int idx);
+
+ private:
+  struct Header {
+    char magic[8];
+    int64_t num_batches;
+    int64_t batch_bytes;
+    //followed by a flag of each batch
+  };
+  size_t HeaderBytes() const;
+  void Map(int fd, size_t offset, size_t header_bytes, bool writable);
+  void Schedule(std::function<void()> task);
+  void WaitFor(int idx);
+  void Worker();
+
+  const int num_batches_;
+  const size_t batch_bytes_;
+  bool preexisting_;
+  Header* header_;
+  char* map_;
+  size_t map_len_;
+  char* base_;
+  std::vector<char> staging_;
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  std::set<int> pending_writes_;
+  bool busy_;
+  bool stop_;
+  std::thread worker_;
+
+  DISALLOW_COPY_AND_ASSIGN(PagedFile);
+};
+
+} //namespace backend
+
+#endif
@@ -11,6 +11,10 @@
 #include "cavs/backend/op_decl.h"
 #include "cavs/backend/op_impl.h"
 #include "cavs/util/logging.h"
+#include "cavs/util/thread_pool.h"
+
+#include <future>
+#include <unordered_map>
 
 using midend::SessionBase;
 using midend::GetSession;
@@ -31,12 +35,12 @@ namespace midend {
 class TensorCApi {
  public:
   static void* raw_data(const Tensor& tensor) {
-    CHECK(tensor.buf_) << tensor.debug_info();
-    return tensor.buf_->data();
+    CHECK(tensor.buffer()) << tensor.debug_info();
+    return tensor.buffer()->data();
   }
   static size_t size(const Tensor& tensor) {
-    CHECK(tensor.buf_) << tensor.debug_info();
-    return tensor.buf_->size();
+    CHECK(tensor.buffer()) << tensor.debug_info();
+    return tensor.buffer()->size();
   }
   static bool IsVirtual(const Tensor& tensor) {
     return tensor.empty();  
@@ -47,6 +51,9 @@ class TensorCApi {
 
 struct C_Session {
   SessionBase* session;
+  //the asynchronous runs not waited yet
+  std::unordered_map<int, std::future<void>> pending;
+  int next_ticket;
 };
 
 struct C_Scope {
@@ -62,7 +69,7 @@ C_Session* C_NewSession(const char* name, size_t name_len, int opt) {
   string name_str(name, name_len);
   //SessionBase* sess = GetSession(name_str, C_graph->graph);
   SessionBase* sess = GetSession(name_str, opt);
-  return new C_Session{sess};
+  return new C_Session{sess, {}, 0};
 }
 
 C_Tensor* C_NewTensor(const char* name, size_t name_len, 
@@ -171,6 +178,76 @@ void C_Run(C_Session* s,
   }
 }
 
+int C_Prepare(C_Session* s,
+    const char** c_output_names, int noutputs,
+    const char** c_input_names, int ninputs) {
+  vector<string> output_names(c_output_names, c_output_names + noutputs);
+  vector<string> input_names(c_input_names, c_input_names + ninputs);
+  return s->session->Prepare(output_names, input_names);
+}
+
+void C_RunPrepared(C_Session* s, int handle,
+    void* const* inputs, int ninputs,
+    const void** outputs, int noutputs) {
+  vector<void*> input_data(inputs, inputs + ninputs);
+  vector<const void*> output_data;
+  s->session->RunPrepared(handle, input_data, &output_data);
+  CHECK(output_data.size() == noutputs);
+  for (int i = 0; i < noutputs; i++)
+    outputs[i] = output_data[i];
+}
+
+int C_RunPreparedAsync(C_Session* s, int handle,
+    void* const* inputs, int ninputs,
+    void* const* outputs, int noutputs) {
+  vector<void*> input_data(inputs, inputs + ninputs);
+  vector<void*> output_data(outputs, outputs + noutputs);
+  int ticket = s->next_ticket++;
+  s->pending.emplace(ticket,
+      s->session->RunAsync(handle, input_data, output_data));
+  return ticket;
+}
+
+void C_Wait(C_Session* s, int ticket) {
+  auto iter = s->pending.find(ticket);
+  CHECK(iter != s->pending.end()) << "Unknown ticket: " << ticket;
+  iter->second.get();
+  s->pending.erase(iter);
+}
+
+void C_SetMaxInFlight(C_Session* s, int n) {
+  s->session->SetMaxInFlight(n);
+}
+
+void C_ConfigureThreads(int num_threads, int pin) {
+  ThreadPool::Configure(num_threads, pin != 0);
+}
+
+const char* C_UtilizationInfo() {
+  //valid until the next call of the thread
+  static thread_local string info;
+  info = ThreadPool::UtilizationInfo();
+  return info.c_str();
+}
+
+void C_SavePlan(C_Session* s,
+    const char** c_output_names, int noutputs, const char* filename) {
+  vector<string> output_names(c_output_names, c_output_names + noutputs);
+  s->session->SavePlan(output_names, filename);
+}
+
+void C_LoadPlan(C_Session* s, const char* filename) {
+  s->session->LoadPlan(filename);
+}
+
+void C_SaveCheckpoint(C_Session* s, const char* filename, int async) {
+  s->session->SaveCheckpoint(filename, async != 0);
+}
+
+void C_RestoreCheckpoint(C_Session* s, const char* filename) {
+  s->session->RestoreCheckpoint(filename);
+}
+
 void* C_TensorData(const C_Tensor* t) { 
   CHECK(t);
   if (midend::TensorCApi::IsVirtual(t->tensor))
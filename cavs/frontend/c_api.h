@@ -32,6 +32,34 @@ extern void C_AddControlDependency(const void* def, size_t def_length);
 extern void C_Run(C_Session* s, 
     const char** c_output_names, C_Tensor** c_output_tensors, int noutputs,
     const char** c_input_names, C_Tensor* const* c_input_tensors, int ninputs);
+//zero-copy path: the inputs are read from the user memory in place,
+//the outputs point to the memory of the session until the next run
+extern int C_Prepare(C_Session* s,
+    const char** c_output_names, int noutputs,
+    const char** c_input_names, int ninputs);
+extern void C_RunPrepared(C_Session* s, int handle,
+    void* const* inputs, int ninputs,
+    const void** outputs, int noutputs);
+//queues the run and returns a ticket to wait on,
+//the outputs are copied to the given memory
+extern int C_RunPreparedAsync(C_Session* s, int handle,
+    void* const* inputs, int ninputs,
+    void* const* outputs, int noutputs);
+extern void C_Wait(C_Session* s, int ticket);
+extern void C_SetMaxInFlight(C_Session* s, int n);
+//the threads shared by the sessions and the cpu kernels of the process,
+//set before the first session runs(pin binds them to the cores)
+extern void C_ConfigureThreads(int num_threads, int pin);
+//the calls, shards and utilization of the kernels and the executors so far
+extern const char* C_UtilizationInfo();
+//the compiled plan of the outputs, loaded by a session of another process
+//without building the graph(C_Prepare and C_Run then find them by names)
+extern void C_SavePlan(C_Session* s,
+    const char** c_output_names, int noutputs, const char* filename);
+extern void C_LoadPlan(C_Session* s, const char* filename);
+//the variables, async returns once they are copied to the host
+extern void C_SaveCheckpoint(C_Session* s, const char* filename, int async);
+extern void C_RestoreCheckpoint(C_Session* s, const char* filename);
 extern void* C_TensorData(const C_Tensor* t);
 extern size_t C_TensorSize(const C_Tensor* t);
 
@@ -0,0 +1,183 @@
+#include "cavs/frontend/cxx/graph_server.h"
+
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+using std::string;
+using std::vector;
+
+void GraphServer::Histogram::Add(int64_t value) {
+  int b = 0;
+  while (b < kBuckets-1 && (int64_t(1) << b) <= value)
+    b++;
+  buckets_[b]++;
+  count_++;
+  sum_ += value;
+}
+
+string GraphServer::Histogram::debug_info(const string& name) const {
+  std::ostringstream os;
+  os << name << ":\tcount " << count_
+     << "\tmean " << (count_ > 0 ? (double)sum_ / count_ : 0) << "\n";
+  for (int b = 0; b < kBuckets; b++) {
+    if (buckets_[b] == 0) continue;
+    os << "\t< " << (int64_t(1) << b) << "\t" << buckets_[b] << "\n";
+  }
+  return os.str();
+}
+
+GraphServer::GraphServer(Session* sess, const Sym& output,
+    const Sym& graph_ph, const Sym& vertex_ph, int max_latency_us)
+    : sess_(sess), output_(output),
+      max_latency_(std::chrono::microseconds(max_latency_us)), stop_(false) {
+  CHECK_NOTNULL(sess_);
+  CHECK(max_latency_us >= 0);
+  vector<int> graph_shape = graph_ph.shape(0);
+  CHECK(graph_shape.size() == 2);
+  batch_ = graph_shape[0];
+  max_len_ = graph_shape[1];
+  CHECK(max_len_ >= 2) << "a graph has at least two nodes";
+  int vertex_count = 1;
+  for (int d : vertex_ph.shape(0)) vertex_count *= d;
+  CHECK(vertex_count % (batch_*max_len_) == 0);
+  vertex_width_ = vertex_count / (batch_*max_len_);
+  vector<int> output_shape = output.shape(0);
+  CHECK(output_shape.size() == 2);
+  output_width_ = output_shape[1];
+
+  handle_ = sess_->Prepare({output_}, {graph_ph, vertex_ph});
+  graph_data_.resize(batch_*max_len_);
+  vertex_data_.resize(vertex_count);
+  worker_ = std::thread(&GraphServer::Loop, this);
+}
+
+GraphServer::~GraphServer() {
+  Stop();
+}
+
+string GraphServer::Validate(const vector<int>& parents,
+    const vector<float>& vertex) const {
+  std::ostringstream os;
+  int n = parents.size();
+  if (n < 2 || n > max_len_) {
+    os << "the graph has " << n << " nodes, not in [2, " << max_len_ << "]";
+  }else if (vertex.size() != n*vertex_width_) {
+    os << "the vertex data has " << vertex.size() << " elements, not "
+       << n*vertex_width_;
+  }else if (parents.back() != -1) {
+    os << "the root must be the last node";
+  }else {
+    //the scheduler takes the first -1 as the root,
+    //and a cycle is never activated
+    for (int j = 0; j < n-1 && os.tellp() == 0; j++) {
+      int curr = j;
+      for (int steps = 0; curr != n-1 && os.tellp() == 0; steps++) {
+        int p = parents[curr];
+        if (p < 0 || p >= n || p == curr)
+          os << "the parent of node " << curr << " is " << p;
+        else if (steps >= n)
+          os << "node " << j << " does not reach the root";
+        curr = p;
+      }
+    }
+  }
+  return os.str();
+}
+
+std::future<vector<float>> GraphServer::Submit(const vector<int>& parents,
+    const vector<float>& vertex) {
+  Request* req = new Request();
+  std::future<vector<float>> ret = req->result.get_future();
+  string error = Validate(parents, vertex);
+  if (!error.empty()) {
+    LOG(WARNING) << "Rejecting the graph: " << error;
+    req->result.set_exception(std::make_exception_ptr(std::invalid_argument(error)));
+    delete req;
+    return ret;
+  }
+  req->parents = parents;
+  req->vertex = vertex;
+  req->arrival = Clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    CHECK(!stop_);
+    queue_.push_back(req);
+  }
+  cv_.notify_one();
+  return ret;
+}
+
+void GraphServer::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  if (worker_.joinable())
+    worker_.join();
+}
+
+void GraphServer::Loop() {
+  while (true) {
+    vector<Request*> batch;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      //a full batch goes at once, otherwise it waits for the deadline
+      //of the oldest request
+      Clock::time_point deadline = queue_.front()->arrival + max_latency_;
+      cv_.wait_until(lock, deadline, [this] {
+        return stop_ || queue_.size() >= batch_;
+      });
+      queue_depth_.Add(queue_.size());
+      while (!queue_.empty() && batch.size() < batch_) {
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+      }
+    }
+    RunBatch(&batch);
+  }
+}
+
+void GraphServer::RunBatch(vector<Request*>* batch) {
+  batch_size_.Add(batch->size());
+  //the unused rows are two-node graphs of zero vertices, so that they are
+  //scheduled like the others and their output rows follow the requests'
+  std::fill(graph_data_.begin(), graph_data_.end(), -1);
+  std::fill(vertex_data_.begin(), vertex_data_.end(), 0);
+  for (int i = batch->size(); i < batch_; i++)
+    graph_data_[i*max_len_] = 1;
+  for (int i = 0; i < batch->size(); i++) {
+    const Request* req = batch->at(i);
+    std::copy(req->parents.begin(), req->parents.end(),
+              graph_data_.begin() + i*max_len_);
+    std::copy(req->vertex.begin(), req->vertex.end(),
+              vertex_data_.begin() + i*max_len_*vertex_width_);
+  }
+  sess_->Run(handle_, {graph_data_.data(), vertex_data_.data()});
+
+  //the output rows of a graph follow the ones of the graphs before it
+  const float* out = reinterpret_cast<const float*>(output_.data());
+  CHECK_NOTNULL(out);
+  int row = 0;
+  Clock::time_point now = Clock::now();
+  for (auto* req : *batch) {
+    int rows = req->parents.size();
+    req->result.set_value(vector<float>(out + row*output_width_,
+                                        out + (row+rows)*output_width_));
+    row += rows;
+    latency_us_.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+          now - req->arrival).count());
+    delete req;
+  }
+}
+
+string GraphServer::debug_info() const {
+  return queue_depth_.debug_info("queue depth")
+       + batch_size_.debug_info("batch size")
+       + latency_us_.debug_info("latency(us)");
+}
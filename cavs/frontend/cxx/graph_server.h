@@ -0,0 +1,93 @@
+#ifndef CAVS_FRONTEND_CXX_GRAPH_SERVER_H_
+#define CAVS_FRONTEND_CXX_GRAPH_SERVER_H_
+
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/frontend/cxx/sym.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Serves the graphs(trees, sequences) one at a time on a GraphSupport model.
+//The requests are queued and run together in one forward pass of the
+//GraphOutput when the batch is full or the oldest request has waited
+//max_latency_us, so that the graph scheduler still batches across them.
+//The graph placeholder is [batch x max_len] and the vertex placeholder holds
+//the same number of nodes. The rows of the batch not filled are two-node
+//graphs, since the scheduler only starts from the leaves with a parent.
+class GraphServer {
+ public:
+  GraphServer(Session* sess, const Sym& output,
+              const Sym& graph_ph, const Sym& vertex_ph,
+              int max_latency_us);
+  ~GraphServer();
+
+  //the parent of each node(-1 for the root, which is the last one) and the
+  //vertex data of each node. The result is the output rows of the nodes.
+  //A graph of less than two nodes, or whose nodes do not all reach the root,
+  //is rejected with std::invalid_argument in the future.
+  std::future<std::vector<float>> Submit(const std::vector<int>& parents,
+                                         const std::vector<float>& vertex);
+  //stops after the queued requests are served
+  void Stop();
+  //queue depth, batch size and latency(in microseconds) histograms
+  std::string debug_info() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  struct Request {
+    std::vector<int> parents;
+    std::vector<float> vertex;
+    std::promise<std::vector<float>> result;
+    Clock::time_point arrival;
+  };
+  //counts in power-of-two buckets
+  class Histogram {
+   public:
+    Histogram() : count_(0), sum_(0) {
+      for (auto& b : buckets_) b = 0;
+    }
+    void Add(int64_t value);
+    std::string debug_info(const std::string& name) const;
+   private:
+    static const int kBuckets = 32;
+    std::atomic<int64_t> buckets_[kBuckets];
+    std::atomic<int64_t> count_;
+    std::atomic<int64_t> sum_;
+  };
+
+  //empty if the graph is well formed
+  std::string Validate(const std::vector<int>& parents,
+                       const std::vector<float>& vertex) const;
+  void Loop();
+  void RunBatch(std::vector<Request*>* batch);
+
+  Session* sess_;
+  Sym output_;
+  int handle_;
+  int batch_;
+  int max_len_;
+  int vertex_width_;
+  int output_width_;
+  Clock::duration max_latency_;
+  std::vector<int> graph_data_;
+  std::vector<float> vertex_data_;
+
+  std::deque<Request*> queue_;
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_;
+  std::thread worker_;
+
+  Histogram queue_depth_;
+  Histogram batch_size_;
+  Histogram latency_us_;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "cavs/frontend/cxx/graph_server.h"
+#include "cavs/frontend/cxx/graphsupport.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/util/logging.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+//each vertex outputs its data plus the outputs of its children,
+//so the root outputs the sum of its tree
+class TreeSumModel : public GraphSupport {
+ public:
+  TreeSumModel(const Sym& graph_ph, const Sym& vertex_ph) :
+    GraphSupport(graph_ph, vertex_ph) {}
+
+  void Node() override {
+    Sym left = Gather(0, {1});
+    Sym right = Gather(1, {1});
+    Sym x = Pull(0, {1});
+    Sym res = x + left + right;
+    Scatter(res);
+    Push(res);
+  }
+};
+
+vector<float> TreeSum(const vector<int>& parents, const vector<float>& vertex) {
+  vector<float> sum(vertex);
+  for (int j = 0; j < parents.size()-1; j++)
+    sum[parents[j]] += sum[j];
+  return sum;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const int batch = 4, max_len = 8;
+  Sym graph = Sym::Placeholder(DT_FLOAT, {batch, max_len}, "CPU");
+  Sym vertex = Sym::Placeholder(DT_FLOAT, {batch, max_len});
+  TreeSumModel model(graph, vertex);
+  Sym output = model.Output();
+
+  Session sess(OPT_BATCHING);
+  //the batch is only filled by three requests, it is run at the deadline
+  GraphServer server(&sess, output, graph, vertex, 1000);
+
+  //the parents of the nodes are after them
+  vector<vector<int>> parents = {{2, 2, -1},
+                                 {1, 2, 3, -1},
+                                 {4, 4, 5, 5, 6, 6, -1}};
+  vector<vector<float>> vertices = {{1, 2, 3},
+                                    {1, 10, 100, 1000},
+                                    {1, 2, 3, 4, 5, 6, 7}};
+  vector<future<vector<float>>> results;
+  for (int i = 0; i < parents.size(); i++)
+    results.push_back(server.Submit(parents[i], vertices[i]));
+  for (int i = 0; i < parents.size(); i++) {
+    vector<float> result = results[i].get();
+    vector<float> expected = TreeSum(parents[i], vertices[i]);
+    CHECK(result.size() == expected.size());
+    for (int j = 0; j < expected.size(); j++)
+      CHECK(fabs(result[j] - expected[j]) < 1e-4)
+        << "graph " << i << " node " << j << ": " << result[j] << " vs " << expected[j];
+  }
+
+  //the graphs the scheduler cannot run are rejected
+  vector<vector<int>> malformed = {{-1},            //one node
+                                   {-1, 2, -1},     //an interior root
+                                   {5, -1},         //out of range
+                                   {1, 0, -1}};     //a cycle
+  for (auto& p : malformed) {
+    bool rejected = false;
+    try {
+      server.Submit(p, vector<float>(p.size(), 0)).get();
+    }catch (const std::invalid_argument& e) {
+      rejected = true;
+    }
+    CHECK(rejected);
+  }
+
+  server.Stop();
+  LOG(INFO) << server.debug_info();
+  return 0;
+}
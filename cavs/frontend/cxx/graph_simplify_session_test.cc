@@ -0,0 +1,74 @@
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/midend/graph_simplifier.h"
+#include "cavs/midend/scope.h"
+#include "cavs/midend/session_simple.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/util/logging.h"
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <set>
+
+using namespace std;
+
+//the nodes computing the output, the inputs before the readers
+static list<midend::Node*> NodesOf(const Sym& output) {
+  list<midend::Node*> nodes;
+  set<midend::Node*> visited;
+  std::function<void(midend::Node*)> visit = [&](midend::Node* node) {
+    if (!visited.insert(node).second)
+      return;
+    for (auto* e : node->input()) {
+      for (auto* src : e->src(true))
+        visit(src);
+    }
+    nodes.push_back(node);
+  };
+  visit(const_cast<midend::Node*>(midend::main_scope()->FindNode(output.output(0))));
+  return nodes;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  Sym A = Sym::Placeholder(DT_FLOAT, {2, 3});
+  Sym B = Sym::Placeholder(DT_FLOAT, {2, 3});
+  //computed once
+  Sym D = Sym::Tanh(A + B);
+  Sym E = Sym::Tanh(A + B);
+  //folded into one constant of -6
+  Sym C = Sym::Constant(DT_FLOAT, 0, {2, 3}) -
+          Sym::Constant(DT_FLOAT, 2, {2, 3}) * Sym::Constant(DT_FLOAT, 3, {2, 3});
+  Sym F = D * C - E;
+
+  {
+    //2 placeholders, 2 adds, 2 tanhs, 3 constants, 2 muls and 2 subs
+    list<midend::Node*> nodes = NodesOf(F);
+    CHECK(nodes.size() == 13) << nodes.size();
+    midend::SimpleSession sess((int)OPT_GRAPH_SIMPLIFY);
+    midend::GraphSimplifier simplifier(&nodes,
+        {midend::main_scope()->FindNode(F.output(0))}, &sess);
+    //2*3 and 0-6 are replaced by the constants
+    CHECK(simplifier.folded() == 2) << simplifier.folded();
+    //the second add and tanh
+    CHECK(simplifier.common_removed() == 2) << simplifier.common_removed();
+    //the 3 constants and the one of 2*3, no longer read
+    CHECK(simplifier.dead_removed() == 4) << simplifier.dead_removed();
+    CHECK(nodes.size() == 7) << nodes.size();
+  }
+
+  Session sess((int)OPT_GRAPH_SIMPLIFY);
+  vector<float> A_data = {1, 2, 3, 4, 5, 6};
+  vector<float> B_data = {-1, -1.5, -2.5, -4, -5.5, -6};
+
+  sess.Run({F}, {{A, A_data.data()}, {B, B_data.data()}});
+  const float* f = (const float*)F.data();
+  for (int i = 0; i < 6; i++) {
+    float f_ref = -7.f * tanh(A_data[i] + B_data[i]);
+    CHECK(fabs(f[i] - f_ref) < 1e-5) << i << ": " << f[i] << " vs " << f_ref;
+  }
+  F.print();
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+//the elementwise ops have no cpu kernel of their own,
+//so the cpu nodes below only run as the host fused kernels
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const int M = 4, K = 5, N = 6;
+  Sym A = Sym::Placeholder(DT_FLOAT, {M, N}, "CPU");
+  Sym B = Sym::Placeholder(DT_FLOAT, {M, N}, "CPU");
+  //S is read by the group and fetched as well
+  Sym S = Sym::Add(A, B, "CPU");
+  Sym T = Sym::Mul(Sym::Sigmoid(S, "CPU"), A, "CPU");
+  //the gemm runs the group as its epilogue, P is fetched and H is not
+  Sym X = Sym::Placeholder(DT_FLOAT, {M, K}, "CPU");
+  Sym W = Sym::Placeholder(DT_FLOAT, {K, N}, "CPU");
+  Sym P = Sym::MatMul(X, W, "CPU");
+  Sym Q = Sym::Tanh(Sym::Add(P, B, "CPU"), "CPU");
+  Sym H = Sym::Relu(Sym::Add(Sym::MatMul(X, W, "CPU"), A, "CPU"), "CPU");
+
+  Session sess((int)OPT_FUSION);
+  vector<float> A_data(M*N), B_data(M*N), X_data(M*K), W_data(K*N);
+  for (int i = 0; i < M*N; i++) {
+    A_data[i] = 0.1f * i - 1.f;
+    B_data[i] = 0.5f - 0.05f * i;
+  }
+  for (int i = 0; i < M*K; i++) X_data[i] = 0.2f * (i % 7) - 0.5f;
+  for (int i = 0; i < K*N; i++) W_data[i] = 0.3f - 0.04f * i;
+  sess.Run({S, T, P, Q, H}, {{A, A_data.data()}, {B, B_data.data()},
+                             {X, X_data.data()}, {W, W_data.data()}});
+
+  const float* s = (const float*)S.data();
+  const float* t = (const float*)T.data();
+  for (int i = 0; i < M*N; i++) {
+    float s_ref = A_data[i] + B_data[i];
+    float t_ref = A_data[i] / (1.f + exp(-s_ref));
+    CHECK(fabs(s[i] - s_ref) < 1e-5) << i << ": " << s[i] << " vs " << s_ref;
+    CHECK(fabs(t[i] - t_ref) < 1e-5) << i << ": " << t[i] << " vs " << t_ref;
+  }
+  const float* p = (const float*)P.data();
+  const float* q = (const float*)Q.data();
+  const float* h = (const float*)H.data();
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      float p_ref = 0;
+      for (int k = 0; k < K; k++)
+        p_ref += X_data[i*K+k] * W_data[k*N+j];
+      float q_ref = tanh(p_ref + B_data[i*N+j]);
+      float h_ref = max(p_ref + A_data[i*N+j], 0.f);
+      CHECK(fabs(p[i*N+j] - p_ref) < 1e-5) << i << "," << j;
+      CHECK(fabs(q[i*N+j] - q_ref) < 1e-5) << i << "," << j;
+      CHECK(fabs(h[i*N+j] - h_ref) < 1e-5) << i << "," << j;
+    }
+  }
+  T.print();
+  H.print();
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/util/logging.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+//k micro-batches update the variable as one batch of k times the size,
+//whose rate is divided by k so that the update is of the mean gradient
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const int k = 4, m = 2, n_in = 3, n_out = 2;
+  const float lr = 0.1f;
+  Sym W_micro = Sym::Variable(DT_FLOAT, {n_in, n_out}, Sym::Ones());
+  Sym W_batch = Sym::Variable(DT_FLOAT, {n_in, n_out}, Sym::Ones());
+  Sym X  = Sym::Placeholder(DT_FLOAT, {m, n_in});
+  Sym Y  = Sym::Placeholder(DT_FLOAT, {m, n_out});
+  Sym XB = Sym::Placeholder(DT_FLOAT, {k*m, n_in});
+  Sym YB = Sym::Placeholder(DT_FLOAT, {k*m, n_out});
+  Sym L_micro = Sym::Square(Sym::MatMul(X, W_micro) - Y);
+  Sym L_batch = Sym::Square(Sym::MatMul(XB, W_batch) - YB);
+  Sym O_micro = L_micro.Optimizer({W_micro}, lr, 0.f, 1, "", k);
+  Sym O_batch = L_batch.Optimizer({W_batch}, lr/k);
+
+  vector<float> X_data(k*m*n_in), Y_data(k*m*n_out);
+  for (int i = 0; i < k*m*n_in; i++)  X_data[i] = 0.1f * (i % 5) - 0.2f;
+  for (int i = 0; i < k*m*n_out; i++) Y_data[i] = 0.05f * i - 0.3f;
+
+  Session sess;
+  const int n = n_in * n_out;
+  vector<float> W_micro_data(n);
+  for (int b = 0; b < k; b++) {
+    sess.Run({W_micro, O_micro}, {{X, X_data.data() + b*m*n_in},
+                                  {Y, Y_data.data() + b*m*n_out}});
+    const float* w = (const float*)W_micro.data();
+    //only updated after the last micro-batch
+    if (b < k-1) {
+      for (int i = 0; i < n; i++)
+        CHECK(w[i] == 1.f) << b << "," << i << ": " << w[i];
+    }
+    for (int i = 0; i < n; i++)
+      W_micro_data[i] = w[i];
+  }
+  sess.Run({W_batch, O_batch}, {{XB, X_data.data()}, {YB, Y_data.data()}});
+  const float* w_batch = (const float*)W_batch.data();
+  bool updated = false;
+  for (int i = 0; i < n; i++) {
+    CHECK(fabs(W_micro_data[i] - w_batch[i]) < 1e-5)
+      << i << ": " << W_micro_data[i] << " vs " << w_batch[i];
+    updated |= (w_batch[i] != 1.f);
+  }
+  CHECK(updated);
+
+  //at the boundary of the micro-batches
+  const string filename = "micro_batch_test.ckpt";
+  sess.SaveCheckpoint(filename);
+  remove(filename.c_str());
+  W_micro.print();
+  return 0;
+}
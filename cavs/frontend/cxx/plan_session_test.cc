@@ -0,0 +1,60 @@
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/util/logging.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+//the plan saved by one session is loaded into a fresh one,
+//which gives the same outputs without compiling the graph
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const int M = 4, K = 5, N = 6;
+  Sym B = Sym::Placeholder(DT_FLOAT, {M, N}, "CPU");
+  Sym X = Sym::Placeholder(DT_FLOAT, {M, K}, "CPU");
+  Sym W = Sym::Placeholder(DT_FLOAT, {K, N}, "CPU");
+  Sym P = Sym::MatMul(X, W, "CPU");
+  //R shares the buffer of P
+  Sym R = Sym::Reshape(P, {M*N});
+  Sym Q = Sym::Tanh(Sym::Add(P, B, "CPU"), "CPU");
+
+  vector<float> B_data(M*N), X_data(M*K), W_data(K*N);
+  for (int i = 0; i < M*N; i++) B_data[i] = 0.5f - 0.05f * i;
+  for (int i = 0; i < M*K; i++) X_data[i] = 0.2f * (i % 7) - 0.5f;
+  for (int i = 0; i < K*N; i++) W_data[i] = 0.3f - 0.04f * i;
+
+  const string filename = "plan_session_test.plan";
+  vector<float> r_ref(M*N), q_ref(M*N);
+  {
+    Session sess((int)OPT_FUSION);
+    sess.Run({R, Q}, {{B, B_data.data()}, {X, X_data.data()}, {W, W_data.data()}});
+    const float* r = (const float*)R.data();
+    const float* q = (const float*)Q.data();
+    for (int i = 0; i < M*N; i++) {
+      r_ref[i] = r[i];
+      q_ref[i] = q[i];
+    }
+    sess.SavePlan({R, Q}, filename);
+  }
+
+  //other inputs, so the outputs are not the ones left by the first run
+  for (int i = 0; i < M*N; i++) B_data[i] = -B_data[i];
+  Session sess((int)OPT_FUSION);
+  sess.LoadPlan(filename);
+  sess.Run({R, Q}, {{B, B_data.data()}, {X, X_data.data()}, {W, W_data.data()}});
+  const float* r = (const float*)R.data();
+  const float* q = (const float*)Q.data();
+  for (int i = 0; i < M*N; i++) {
+    float q_new = tanh(r_ref[i] + B_data[i]);
+    CHECK(fabs(r[i] - r_ref[i]) < 1e-5) << i << ": " << r[i] << " vs " << r_ref[i];
+    CHECK(fabs(q[i] - q_new) < 1e-5) << i << ": " << q[i] << " vs " << q_new;
+    CHECK(fabs(tanh(r_ref[i] - B_data[i]) - q_ref[i]) < 1e-5) << i;
+  }
+  remove(filename.c_str());
+  Q.print();
+  return 0;
+}
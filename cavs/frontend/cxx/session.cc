@@ -2,48 +2,72 @@
 
 #include <vector>
 
+using std::string;
 using std::vector;
 using std::initializer_list;
 using std::pair;
 
-void Session::Run(vector<Sym> outputs,
-    const initializer_list<pair<Sym&, void*>>& feed) {
-  vector<C_Tensor*> input_tensor;
+int Session::Prepare(const vector<Sym>& outputs, const vector<Sym>& inputs) {
+  //for input and output, we assumpt they are all one-output operator
+  vector<const char*> output_name;
+  for (auto& out : outputs)
+    output_name.push_back(out.output(0).c_str());
   vector<const char*> input_name;
-  for (auto& input : feed) {
-    const Sym& sym = input.first;
-    void* data = input.second;
-    //for input, we assumpt they are all one-output operator
-    if (feed_map_.count(sym.output(0)) == 0) {
-      feed_map_[sym.output(0)] = 
-        C_NewTensor(sym.output(0).c_str(), sym.output(0).length(), 
-                    sym.shape(0).data(), sym.shape(0).size(),
-                    (C_Dtype)sym.type());
-    }
-    C_Tensor* ft = feed_map_[sym.output(0)];
-    memcpy(C_TensorData(ft), data, C_TensorSize(ft));
-    input_tensor.push_back(ft);
-    input_name.push_back(sym.output(0).data());
-  }
+  for (auto& in : inputs)
+    input_name.push_back(in.output(0).c_str());
+  int handle = C_Prepare(s_,
+                         output_name.data(), output_name.size(),
+                         input_name.data(), input_name.size());
+  if (handle >= prepared_outputs_.size())
+    prepared_outputs_.resize(handle+1);
+  prepared_outputs_[handle] = outputs;
+  return handle;
+}
+
+void Session::Run(int handle, const vector<void*>& feed) {
+  CHECK(handle >= 0 && handle < prepared_outputs_.size());
+  vector<Sym>& outputs = prepared_outputs_[handle];
+  output_buf_.resize(outputs.size());
+  C_RunPrepared(s_, handle,
+                feed.data(), feed.size(),
+                output_buf_.data(), output_buf_.size());
+  for (int i = 0; i < outputs.size(); i++)
+    *(outputs[i].mutable_data()) = const_cast<void*>(output_buf_[i]);
+}
 
-  vector<C_Tensor*> output_tensor;
+int Session::RunAsync(int handle, const vector<void*>& feed,
+    const vector<void*>& fetch) {
+  CHECK(handle >= 0 && handle < prepared_outputs_.size());
+  CHECK(fetch.size() == prepared_outputs_[handle].size());
+  return C_RunPreparedAsync(s_, handle,
+                            feed.data(), feed.size(),
+                            fetch.data(), fetch.size());
+}
+
+void Session::SavePlan(const vector<Sym>& outputs, const string& filename) {
   vector<const char*> output_name;
-  for (auto& out: outputs) {
+  for (auto& out : outputs)
     output_name.push_back(out.output(0).c_str());
+  C_SavePlan(s_, output_name.data(), output_name.size(), filename.c_str());
+}
+
+void Session::Run(vector<Sym> outputs,
+    const initializer_list<pair<Sym&, void*>>& feed) {
+  string key;
+  for (auto& out : outputs)
+    key += out.output(0) + '\0';
+  key += '\0';
+  for (auto& input : feed)
+    key += input.first.output(0) + '\0';
+  auto iter = handles_.find(key);
+  if (iter == handles_.end()) {
+    vector<Sym> inputs;
+    for (auto& input : feed)
+      inputs.push_back(input.first);
+    iter = handles_.emplace(key, Prepare(outputs, inputs)).first;
   }
-  output_tensor.resize(output_name.size(), NULL);
-  C_Run(s_,
-        output_name.data(),
-        output_tensor.data(),
-        output_name.size(),
-        input_name.data(),
-        input_tensor.data(),
-        input_name.size());
-  int i = 0;
-  for (auto& out : outputs) {
-    void **data_ptr = out.mutable_data();
-    *data_ptr = C_TensorData(output_tensor[i++]);
-  }
-  for (auto* t : output_tensor)
-    free(t);
+  vector<void*> feed_data;
+  for (auto& input : feed)
+    feed_data.push_back(input.second);
+  Run(iter->second, feed_data);
 }
@@ -23,10 +23,38 @@ class Session {
     std::vector<Sym> out = {output};
     Run(out, feed);
   }
+  //the inputs are then fed with the pointers in the same order,
+  //the outputs get the data of the session without any copy on the host
+  int Prepare(const std::vector<Sym>& outputs, const std::vector<Sym>& inputs);
+  void Run(int handle, const std::vector<void*>& feed);
+  //returns a ticket for Wait, the outputs are copied to fetch(NULL to skip).
+  //At most SetMaxInFlight runs are queued, the fetch memory of a run must
+  //not be touched before it is waited, the feed may be reused at once.
+  int RunAsync(int handle, const std::vector<void*>& feed,
+               const std::vector<void*>& fetch);
+  void Wait(int ticket) { C_Wait(s_, ticket); }
+  void SetMaxInFlight(int n) { C_SetMaxInFlight(s_, n); }
+  //the threads of all the sessions, before any of them runs
+  static void ConfigureThreads(int num_threads, bool pin = false) {
+    C_ConfigureThreads(num_threads, pin);
+  }
+  static std::string UtilizationInfo() { return C_UtilizationInfo(); }
+  //a session loading the plan runs the same outputs without the graph passes
+  void SavePlan(const std::vector<Sym>& outputs, const std::string& filename);
+  void LoadPlan(const std::string& filename) { C_LoadPlan(s_, filename.c_str()); }
+  //the variables of the outputs run so far
+  void SaveCheckpoint(const std::string& filename, bool async = false) {
+    C_SaveCheckpoint(s_, filename.c_str(), async);
+  }
+  void RestoreCheckpoint(const std::string& filename) {
+    C_RestoreCheckpoint(s_, filename.c_str());
+  }
 
  private:
   C_Session* s_;
-  std::unordered_map<string, C_Tensor*> feed_map_;
+  std::unordered_map<std::string, int> handles_;
+  std::vector<std::vector<Sym>> prepared_outputs_;
+  std::vector<const void*> output_buf_;
 };
 
 class MPISession : public Session {
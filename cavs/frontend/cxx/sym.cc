@@ -149,7 +149,7 @@ Sym Sym::Data(DataType type, const vector<int>& shape,
 }
 
 Sym Sym::DDV(DataType type, const vector<int>& shape, int batch,
-    const ATTRIBUTE& filler, string device) {
+    const ATTRIBUTE& filler, string device, string filename) {
   //OpDef::AttrDef batch_attr;
   //batch_attr.set_name("Batch");
   //batch_attr.mutable_value()->set_i(batch);
@@ -163,14 +163,16 @@ Sym Sym::DDV(DataType type, const vector<int>& shape, int batch,
   //for (auto& attr : filler.second)
     //attrs.push_back(attr);
   //return Sym("DDV", {}, type, filler.first, device, {}, attrs); 
-  OpDef def = OpDefBuilder("DDV")
-                .Dtype(type)
-                .Label(filler.first)
-                .Device(device)
-                .AttrSingle("Batch", batch)
-                .AttrList("Shape", shape)
-                .Attr(filler.second)
-                .Finalize();
+  OpDefBuilder builder("DDV");
+  builder.Dtype(type)
+         .Label(filler.first)
+         .Device(device)
+         .AttrSingle("Batch", batch)
+         .AttrList("Shape", shape)
+         .Attr(filler.second);
+  if (!filename.empty())
+    builder.AttrSingle("filename", filename);
+  OpDef def = builder.Finalize();
   return Sym(def);
 }
 
@@ -659,8 +661,10 @@ Sym::ATTRIBUTE Sym::BinaryReader(const string& filename) {
 }
 
 Sym Sym::Optimizer(const Sym& a, vector<Sym> variables,
-    float lr, float clip, int iters, const string& projection) {
+    float lr, float clip, int iters, const string& projection,
+    int micro_batches) {
   CHECK(iters > 0);
+  CHECK(micro_batches > 0);
   CHECK(a.output_size() == 1);
   //Sym s("Optimizer", a.node_->output_[0],
       //variables, lr, clip, iters, projection);
@@ -677,6 +681,7 @@ Sym Sym::Optimizer(const Sym& a, vector<Sym> variables,
                 .AttrSingle("Iters", iters)
                 .AttrSingle("Projection", projection)
                 .AttrSingle("Solver", string("SGD"))
+                .AttrSingle("MicroBatches", micro_batches)
                 .Finalize();
   return Sym(def);
 }
@@ -47,8 +47,10 @@ class Sym {
   static Sym MnistInput(int batch, string source, string file, string device = "GPU");
   static Sym Data(DataType type, const std::vector<int>& shape, int batch,
       const ATTRIBUTE& reader, string device = "GPU");
+  //the DDV is kept in the file(or a temporary one) and paged per batch
   static Sym DDV(DataType type, const std::vector<int>& shape, int batch,
-      const ATTRIBUTE& filler = Ones(), string device = "GPU");
+      const ATTRIBUTE& filler = Ones(), string device = "GPU",
+      string filename = "");
   //unary operation
   static Sym Abs(const Sym& a, string device = "GPU");
   static Sym Argmax(const Sym& a, int axis, string device = "GPU");
@@ -56,8 +58,11 @@ class Sym {
   static Sym Reduce_mean(const Sym& a, string device = "GPU");
   static Sym Reduce_sum(const Sym& a, string device = "GPU");
   static Sym Optimizer(const Sym& a);
+  //with micro_batches k, each run of the optimizer is one micro-batch, the
+  //variables are updated with the mean gradient once every k runs
   static Sym Optimizer(const Sym& a, std::vector<Sym> variables,
-      float lr, float clip = 0.f, int iters = 1, const string& projections = "");
+      float lr, float clip = 0.f, int iters = 1, const string& projections = "",
+      int micro_batches = 1);
   static Sym Maxpooling(const Sym& a, int HightWindow, int WidthWindow, string device = "GPU");
   static Sym Relu(const Sym& a, string device = "GPU");
   static Sym Sigmoid(const Sym& a, string device = "GPU");
@@ -111,8 +116,9 @@ class Sym {
   Sym Reduce_sum()     { return Reduce_sum(*this);   }
   Sym Optimizer()      { return Optimizer(*this);    }
   Sym Optimizer(std::vector<Sym> variables,
-      float lr, float clip = 0.f, int iters = 1, const string& projection = "") {
-    return Optimizer(*this, variables, lr, clip, iters, projection); 
+      float lr, float clip = 0.f, int iters = 1, const string& projection = "",
+      int micro_batches = 1) {
+    return Optimizer(*this, variables, lr, clip, iters, projection, micro_batches); 
   }
   Sym Maxpooling(int HightWindow, int WidthWindow) {
     return Maxpooling(*this, HightWindow, WidthWindow);
@@ -0,0 +1,118 @@
+#include "cavs/midend/activation_stash.h"
+#include "cavs/backend/cuda_common.h"
+#include "cavs/util/macros_gpu.h"
+
+#include <cuda_fp16.h>
+
+using ::backend::THREADS_PER_BLOCK;
+using ::backend::BLOCKS_PER_GRID;
+
+namespace midend {
+
+struct FP16Codec {
+  typedef __half Storage;
+  __device__ static Storage Encode(float v) { return __float2half_rn(v); }
+  __device__ static float Decode(Storage v) { return __half2float(v); }
+};
+
+//bfloat16 is the upper half of a float,
+//so it is converted with bit operations and needs no hardware support
+struct BF16Codec {
+  typedef unsigned short Storage;
+  __device__ static Storage Encode(float v) {
+    unsigned int bits = __float_as_uint(v);
+    //keep NaN a (quiet) NaN
+    if ((bits & 0x7fffffff) > 0x7f800000)
+      return (bits >> 16) | 0x40;
+    //round to nearest even
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return bits >> 16;
+  }
+  __device__ static float Decode(Storage v) {
+    return __uint_as_float(((unsigned int)v) << 16);
+  }
+};
+
+template <typename CODEC>
+__global__ void CompressKernel(typename CODEC::Storage* out,
+    const float* inp, int n) {
+  CUDA_1D_KERNEL_LOOP(i, n) {
+    out[i] = CODEC::Encode(inp[i]);
+  }
+}
+
+template <typename CODEC>
+__global__ void DecompressKernel(float* out,
+    const typename CODEC::Storage* inp, int n) {
+  CUDA_1D_KERNEL_LOOP(i, n) {
+    out[i] = CODEC::Decode(inp[i]);
+  }
+}
+
+ActivationStash::ActivationStash(Tensor* working, Allocator* alloc,
+    Format format, int max_rows)
+    : working_(working), alloc_(alloc), format_(format), buf_(NULL),
+      max_rows_(max_rows), decompressed_offset_(-1), decompressed_rows_(-1) {
+  CHECK_NOTNULL(working_);
+  CHECK_NOTNULL(alloc_);
+  CHECK(alloc_->type() == GPU);
+  CHECK(working_->data_type() == DT_FLOAT);
+  CHECK(working_->IsDynamicShape());
+  CHECK(working_->dims() > 1);
+  CHECK(max_rows_ > 0);
+  unit_ = working_->count()/working_->dims(0);
+  //fp16 and bf16 are both 2 bytes
+  buf_ = alloc_->AllocateRaw((size_t)max_rows_*unit_*2);
+  VLOG(V_DEBUG) << "Stashing " << working_->name() << " in "
+                << (format_ == FP16 ? "fp16" : "bf16") << " with "
+                << max_rows_ << "x" << unit_ << " elements";
+}
+
+ActivationStash::~ActivationStash() {
+  if (buf_) alloc_->DeallocateRaw(buf_);
+}
+
+//The conversion kernels are launched on the legacy default stream,
+//which waits for and blocks all the other (blocking) streams.
+//The working tensor is reused by each round, so this is the cheapest way
+//to stay correct when the ops of one round are spread on several streams.
+void ActivationStash::Compress(int row_offset) {
+  int rows = working_->dims(0);
+  CHECK(row_offset >= 0 && row_offset + rows <= max_rows_)
+    << row_offset << "\t" << rows << "\t" << max_rows_;
+  int n = rows*unit_;
+  size_t offset = (size_t)row_offset*unit_;
+  if (format_ == FP16) {
+    CompressKernel<FP16Codec><<<BLOCKS_PER_GRID(n), THREADS_PER_BLOCK, 0, 0>>>(
+        (FP16Codec::Storage*)buf_ + offset, working_->data<float>(), n);
+  }else {
+    CompressKernel<BF16Codec><<<BLOCKS_PER_GRID(n), THREADS_PER_BLOCK, 0, 0>>>(
+        (BF16Codec::Storage*)buf_ + offset, working_->data<float>(), n);
+  }
+  checkCudaError(cudaGetLastError());
+  //the working tensor holds the new round now
+  decompressed_offset_ = row_offset;
+  decompressed_rows_ = rows;
+}
+
+void ActivationStash::Decompress(int row_offset) {
+  int rows = working_->dims(0);
+  if (row_offset == decompressed_offset_ && rows == decompressed_rows_)
+    return;
+  CHECK(row_offset >= 0 && row_offset + rows <= max_rows_)
+    << row_offset << "\t" << rows << "\t" << max_rows_;
+  int n = rows*unit_;
+  size_t offset = (size_t)row_offset*unit_;
+  if (format_ == FP16) {
+    DecompressKernel<FP16Codec><<<BLOCKS_PER_GRID(n), THREADS_PER_BLOCK, 0, 0>>>(
+        working_->mutable_data<float>(), (FP16Codec::Storage*)buf_ + offset, n);
+  }else {
+    DecompressKernel<BF16Codec><<<BLOCKS_PER_GRID(n), THREADS_PER_BLOCK, 0, 0>>>(
+        working_->mutable_data<float>(), (BF16Codec::Storage*)buf_ + offset, n);
+  }
+  checkCudaError(cudaGetLastError());
+  decompressed_offset_ = row_offset;
+  decompressed_rows_ = rows;
+}
+
+} //namespace midend
@@ -0,0 +1,43 @@
+#ifndef CAVS_MIDEND_ACTIVATION_STASH_H_
+#define CAVS_MIDEND_ACTIVATION_STASH_H_
+
+#include "cavs/midend/tensor.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/util/macros.h"
+
+namespace midend {
+
+//The forward activations of a graph session are kept for all the rounds
+//only because the backward ops read them again.
+//With the stash, the fp32 tensor only holds the rows of the current round
+//(its offset is always 0), and every round is compressed into a 16-bit
+//buffer after it is produced, and decompressed before a backward op reads it.
+//Compute always stays in fp32.
+class ActivationStash {
+ public:
+  enum Format { FP16 = 0, BF16 = 1 };
+  ActivationStash(Tensor* working, Allocator* alloc, Format format, int max_rows);
+  ~ActivationStash();
+  //working tensor -> stash[row_offset, row_offset+rows)
+  void Compress(int row_offset);
+  //stash[row_offset, row_offset+rows) -> working tensor
+  void Decompress(int row_offset);
+  FORCE_INLINE const Tensor* working() const { return working_; }
+
+ private:
+  Tensor* working_;
+  Allocator* alloc_;
+  Format format_;
+  void* buf_;
+  int unit_;
+  int max_rows_;
+  //several backward ops of one round may read the same activation
+  int decompressed_offset_;
+  int decompressed_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(ActivationStash);
+};
+
+} //namespace midend
+
+#endif
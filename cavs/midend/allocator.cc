@@ -86,6 +86,14 @@ void AllocatorRegister::InitInternal(const string& name, Allocator* alloc) {
 } //namespace allocator_factory
 
 Allocator* GetAllocator(const OpDef& def) {
+  //the placement of the op can be refined by an allocator(such as "CPU_NUMA0")
+  const string& alloc_name = GetSingleArg<string>(def, "Allocator", "");
+  if (!alloc_name.empty()) {
+    Allocator* alloc = GetAllocator(alloc_name);
+    CHECK(alloc) << "Unknown allocator: " << alloc_name;
+    CHECK(alloc->type() == def.device()) << alloc_name << "\n" << def.DebugString();
+    return alloc;
+  }
   DeviceType dev = def.device();
   string dev_name;
   if (dev == GPU)
@@ -0,0 +1,162 @@
+#include "cavs/midend/allocator.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+#include "cavs/util/thread_pool.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace midend {
+
+static const size_t kHugePageSize = 2 << 20;
+//below this, a single thread is faster than waking up the others
+static const size_t kParallelTouchSize = 16 << 20;
+//the smallest buffer zeroed by the pool, with two shards at least
+static const size_t kParallelMemsetSize = 2*kParallelTouchSize;
+
+//CPU allocator for the multi-socket machines.
+//"CPU_NUMA" leaves the pages on the nodes of the threads touching them first,
+//which spreads a large buffer(the embedding table) over all the sockets,
+//"CPU_NUMA<k>" binds all the pages of the buffer to node k.
+//The buffers larger than a huge page are aligned to 2MB and backed by
+//explicit huge pages if they are reserved(vm.nr_hugepages),
+//otherwise by transparent huge pages.
+//The large buffers are first touched(and zeroed) by the threads of the shared
+//pool in parallel, so that the page faults are not serialized on one core.
+//The small ones are zeroed on the calling thread.
+class NumaCPUAllocator : public Allocator {
+ public:
+  explicit NumaCPUAllocator(const string& name, int node)
+      : Allocator(name, CPU), node_(node) {
+    CHECK(node_ < (int)sizeof(unsigned long)*8 - 1);
+  }
+
+  void* AllocateRaw(size_t nbytes) override {
+    CHECK(nbytes > 0);
+    bool huge = (nbytes >= kHugePageSize);
+    size_t len = RoundUp(nbytes, huge ? kHugePageSize : PageSize());
+    void* ptr = MAP_FAILED;
+    if (huge) {
+      ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (ptr == MAP_FAILED) {
+      ptr = MapAligned(len, huge ? kHugePageSize : PageSize());
+      if (huge) madvise(ptr, len, MADV_HUGEPAGE);
+    }
+    if (node_ >= 0) {
+      //the policy must be set before the first touch
+      unsigned long mask = 1UL << node_;
+      if (syscall(SYS_mbind, ptr, len, MPOL_BIND, &mask,
+                  sizeof(mask)*8, 0) != 0) {
+        LOG(WARNING) << "Binding " << len << " bytes to numa node "
+                     << node_ << " failed: " << strerror(errno);
+      }
+    }
+    //the fresh pages are zero, the small ones are left to their first user
+    if (len >= kParallelMemsetSize)
+      ParallelMemset(ptr, len);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      sizes_[ptr] = len;
+    }
+    VLOG(V_DEBUG) << "allocating " << nbytes << " bytes on " << name()
+                  << (huge ? " with huge pages" : "");
+    return ptr;
+  }
+
+  void DeallocateRaw(void* buf) override {
+    size_t len = 0;
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      CHECK(sizes_.find(buf) != sizes_.end());
+      len = sizes_.at(buf);
+      sizes_.erase(buf);
+    }
+    CHECK(munmap(buf, len) == 0);
+  }
+
+  void InitWithZero(void* buf, size_t nbytes) override {
+    if (nbytes < kParallelMemsetSize)
+      memset(buf, 0, nbytes);
+    else
+      ParallelMemset(buf, nbytes);
+  }
+
+ private:
+  static size_t PageSize() {
+    static size_t page_size = sysconf(_SC_PAGESIZE);
+    return page_size;
+  }
+  static size_t RoundUp(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+  }
+  //mmap only guarantees the alignment of normal pages,
+  //so we map one more unit and trim the head and the tail
+  static void* MapAligned(size_t len, size_t align) {
+    size_t map_len = len + align;
+    char* raw = (char*)mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    CHECK(raw != MAP_FAILED) << "mmap " << map_len << " bytes: " << strerror(errno);
+    char* aligned = (char*)RoundUp((size_t)raw, align);
+    if (aligned > raw)
+      munmap(raw, aligned - raw);
+    if (raw + map_len > aligned + len)
+      munmap(aligned + len, raw + map_len - (aligned + len));
+    return aligned;
+  }
+  static void ParallelMemset(void* buf, size_t nbytes) {
+    CHECK(nbytes >= kParallelMemsetSize) << nbytes;
+    //in huge pages, so that no page is touched by two threads
+    ThreadPool* pool = ThreadPool::Get();
+    int64_t pages = (nbytes + kHugePageSize - 1) / kHugePageSize;
+    int64_t grain = std::max<int64_t>(kParallelTouchSize / kHugePageSize,
+                                      (pages + pool->NumThreads() - 1) / pool->NumThreads());
+    pool->ParallelFor(0, pages, grain, [buf, nbytes](int64_t begin, int64_t end) {
+      size_t first = begin*kHugePageSize;
+      size_t last = std::min<size_t>(end*kHugePageSize, nbytes);
+      memset((char*)buf + first, 0, last - first);
+    }, ThreadPool::Counters("CPU_NUMA:InitWithZero"));
+  }
+
+  const int node_;
+  std::mutex mu_;
+  std::unordered_map<void*, size_t> sizes_;
+};
+
+static int NumaNodeCount() {
+  int count = 0;
+  struct stat st;
+  while (stat(("/sys/devices/system/node/node" + std::to_string(count)).c_str(), &st) == 0)
+    count++;
+  return std::max(count, 1);
+}
+
+//the number of nodes is only known at runtime,
+//so the allocators are registered in a loop instead of by the macro
+static bool RegisterNumaAllocators() {
+  string prefix = string(DeviceTypeToString(CPU)) + "_NUMA";
+  static NumaCPUAllocator local_alloc(prefix, -1);
+  allocator_factory::AllocatorRegister local_reg(prefix, &local_alloc);
+  int count = NumaNodeCount();
+  for (int node = 0; node < count; node++) {
+    const string& name = prefix + std::to_string(node);
+    allocator_factory::AllocatorRegister reg(name, new NumaCPUAllocator(name, node));
+  }
+  return true;
+}
+
+static bool numa_allocators_registered = RegisterNumaAllocators();
+
+} //namespace midend
@@ -0,0 +1,35 @@
+#include "cavs/midend/arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace midend {
+
+Arena::~Arena() {
+  for (auto iter = dtors_.rbegin(); iter != dtors_.rend(); iter++)
+    iter->second(iter->first);
+  for (char* block : blocks_)
+    free(block);
+}
+
+void* Arena::Allocate(size_t nbytes, size_t align) {
+  CHECK(align > 0 && (align & (align-1)) == 0) << align;
+  size_t padding = (align - (size_t)curr_ % align) % align;
+  if (!curr_ || padding + nbytes > left_) {
+    //the oversized ones get a block of their own
+    size_t size = std::max(block_size_, nbytes + align);
+    char* block = (char*)malloc(size);
+    CHECK_NOTNULL(block);
+    blocks_.push_back(block);
+    capacity_ += size;
+    curr_ = block;
+    left_ = size;
+    padding = (align - (size_t)curr_ % align) % align;
+  }
+  void* ptr = curr_ + padding;
+  curr_ += padding + nbytes;
+  left_ -= padding + nbytes;
+  return ptr;
+}
+
+} //namespace midend
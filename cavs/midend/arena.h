@@ -0,0 +1,88 @@
+#ifndef CAVS_MIDEND_ARENA_H_
+#define CAVS_MIDEND_ARENA_H_
+
+#include "cavs/util/macros.h"
+#include "cavs/util/logging.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace midend {
+
+//Bump allocator for the objects created when a session compiles
+//(statements, op contexts, op implementations and their tensor arrays).
+//They are laid out in the order of compilation, which is the order
+//they are visited every round, and they are all destroyed with the arena.
+class Arena {
+ public:
+  explicit Arena(size_t block_size = 64 << 10)
+    : block_size_(block_size), curr_(NULL), left_(0), capacity_(0) {}
+  ~Arena();
+
+  void* Allocate(size_t nbytes, size_t align = alignof(std::max_align_t));
+
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    void* mem = Allocate(sizeof(T), alignof(T));
+    T* obj = new (mem) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      dtors_.emplace_back(obj, [](void* p) { static_cast<T*>(p)->~T(); });
+    return obj;
+  }
+
+  //the bytes of all the blocks, the oversized ones included
+  FORCE_INLINE size_t capacity() const { return capacity_; }
+
+ private:
+  const size_t block_size_;
+  char* curr_;
+  size_t left_;
+  size_t capacity_;
+  std::vector<char*> blocks_;
+  std::vector<std::pair<void*, void(*)(void*)>> dtors_;
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+//for the containers owned by the objects in the arena,
+//the memory is returned only when the arena is destroyed.
+//Without an arena, it works as std::allocator.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  ArenaAllocator(Arena* arena = NULL) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+  T* allocate(size_t n) {
+    if (arena_)
+      return static_cast<T*>(arena_->Allocate(n*sizeof(T), alignof(T)));
+    else
+      return static_cast<T*>(::operator new(n*sizeof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    if (!arena_)
+      ::operator delete(p);
+  }
+  FORCE_INLINE Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+inline bool operator ==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator !=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+} //namespace midend
+
+#endif
@@ -0,0 +1,198 @@
+#include "cavs/midend/checkpoint.h"
+#include "cavs/util/logging.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+using std::string;
+using std::vector;
+
+namespace midend {
+
+namespace {
+
+const char kMagic[8] = {'C', 'A', 'V', 'S', 'C', 'K', 'P', 'T'};
+const uint32_t kVersion = 1;
+const size_t kAlignment = 4096;
+
+size_t Align(size_t n) {
+  return (n + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+//the whole file in memory, the data is copied from the devices
+void BuildImage(const vector<const Tensor*>& tensors, vector<char>* image) {
+  size_t names_offset = sizeof(CheckpointHeader)
+                      + tensors.size() * sizeof(CheckpointEntry);
+  size_t names_length = 0;
+  for (auto* t : tensors)
+    names_length += t->name().length();
+  size_t offset = Align(names_offset + names_length);
+  const size_t data_offset = offset;
+  vector<CheckpointEntry> entries(tensors.size());
+  size_t name_offset = names_offset;
+  for (int i = 0; i < tensors.size(); i++) {
+    const Tensor* t = tensors[i];
+    CHECK(!t->empty()) << t->name();
+    CHECK(t->dims() <= CheckpointEntry::kMaxDims) << t->name();
+    CheckpointEntry& e = entries[i];
+    memset(&e, 0, sizeof(e));
+    e.name_offset = name_offset;
+    e.name_length = t->name().length();
+    name_offset += e.name_length;
+    e.dtype = t->data_type();
+    e.num_dims = t->dims();
+    for (int d = 0; d < t->dims(); d++)
+      e.dims[d] = t->dims(d);
+    e.offset = offset;
+    e.bytes = t->bytes();
+    offset = Align(offset + e.bytes);
+  }
+
+  image->assign(offset, 0);
+  CheckpointHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_tensors = tensors.size();
+  header.data_offset = data_offset;
+  memcpy(image->data(), &header, sizeof(header));
+  if (!entries.empty())
+    memcpy(image->data() + sizeof(header), entries.data(),
+           entries.size() * sizeof(CheckpointEntry));
+  for (int i = 0; i < tensors.size(); i++) {
+    memcpy(image->data() + entries[i].name_offset,
+           tensors[i]->name().data(), entries[i].name_length);
+    tensors[i]->CopyToHost(image->data() + entries[i].offset);
+  }
+}
+
+//into a temporary file first, the old checkpoint stays valid until the rename
+void WriteImage(const vector<char>& image, const string& filename) {
+  string tmp = filename + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK(fd >= 0) << "Opening " << tmp << ": " << strerror(errno);
+  size_t written = 0;
+  while (written < image.size()) {
+    ssize_t n = write(fd, image.data() + written, image.size() - written);
+    CHECK(n > 0) << "Writing " << tmp << ": " << strerror(errno);
+    written += n;
+  }
+  CHECK(fsync(fd) == 0) << tmp;
+  CHECK(close(fd) == 0) << tmp;
+  CHECK(rename(tmp.c_str(), filename.c_str()) == 0)
+    << "Renaming " << tmp << ": " << strerror(errno);
+}
+
+} //namespace
+
+void SaveCheckpoint(const vector<const Tensor*>& tensors,
+                    const string& filename) {
+  vector<char> image;
+  BuildImage(tensors, &image);
+  WriteImage(image, filename);
+  VLOG(V_DEBUG) << "Saved " << tensors.size() << " tensors("
+                << image.size() << " bytes) to " << filename;
+}
+
+CheckpointReader::CheckpointReader(const string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK(fd >= 0) << "Opening " << filename << ": " << strerror(errno);
+  struct stat st;
+  CHECK(fstat(fd, &st) == 0) << filename;
+  length_ = st.st_size;
+  CHECK(length_ >= sizeof(CheckpointHeader)) << filename;
+  void* addr = mmap(NULL, length_, PROT_READ, MAP_SHARED, fd, 0);
+  CHECK(addr != MAP_FAILED) << "Mapping " << filename << ": " << strerror(errno);
+  close(fd);
+  base_ = reinterpret_cast<const char*>(addr);
+  header_ = reinterpret_cast<const CheckpointHeader*>(base_);
+  CHECK(memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0)
+    << filename << " is not a checkpoint";
+  CHECK(header_->version == kVersion) << filename;
+  entries_ = reinterpret_cast<const CheckpointEntry*>(base_ + sizeof(CheckpointHeader));
+  CHECK(sizeof(CheckpointHeader) + size()*sizeof(CheckpointEntry) <= length_);
+  for (int i = 0; i < size(); i++)
+    CHECK(entries_[i].offset + entries_[i].bytes <= length_) << filename;
+}
+
+CheckpointReader::~CheckpointReader() {
+  munmap(const_cast<char*>(base_), length_);
+}
+
+string CheckpointReader::name(int i) const {
+  return string(base_ + entries_[i].name_offset, entries_[i].name_length);
+}
+
+int CheckpointReader::Find(const string& name) const {
+  for (int i = 0; i < size(); i++) {
+    if (entries_[i].name_length == name.length() &&
+        memcmp(base_ + entries_[i].name_offset, name.data(), name.length()) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void CheckpointReader::Restore(Tensor* t) const {
+  int i = Find(t->name());
+  CHECK(i >= 0) << t->name() << " is not in the checkpoint";
+  const CheckpointEntry& e = entries_[i];
+  CHECK(e.dtype == t->data_type()) << t->name();
+  CHECK(e.num_dims == t->dims()) << t->name();
+  for (int d = 0; d < e.num_dims; d++)
+    CHECK(e.dims[d] == t->dims(d)) << t->name();
+  CHECK(e.bytes == t->bytes()) << t->name();
+  t->SyncWithHost(data(i));
+}
+
+CheckpointSnapshotter::CheckpointSnapshotter()
+    : pending_(false), stop_(false) {
+  writer_ = std::thread(&CheckpointSnapshotter::Loop, this);
+}
+
+CheckpointSnapshotter::~CheckpointSnapshotter() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  writer_.join();
+}
+
+void CheckpointSnapshotter::Snapshot(const vector<const Tensor*>& tensors,
+                                     const string& filename) {
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this] { return !pending_; });
+  //the staging buffer is reused by the snapshots
+  BuildImage(tensors, &staging_);
+  filename_ = filename;
+  pending_ = true;
+  cv_.notify_all();
+}
+
+void CheckpointSnapshotter::Wait() {
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this] { return !pending_; });
+}
+
+void CheckpointSnapshotter::Loop() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || pending_; });
+    if (!pending_)
+      return;
+    //the staging buffer is not touched until pending_ is cleared
+    lock.unlock();
+    WriteImage(staging_, filename_);
+    VLOG(V_DEBUG) << "Snapshot written to " << filename_;
+    lock.lock();
+    pending_ = false;
+    cv_.notify_all();
+  }
+}
+
+} //namespace midend
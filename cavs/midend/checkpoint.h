@@ -0,0 +1,90 @@
+#ifndef CAVS_MIDEND_CHECKPOINT_H_
+#define CAVS_MIDEND_CHECKPOINT_H_
+
+#include "cavs/midend/tensor.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace midend {
+
+//The checkpoint file is a fixed header, one fixed entry per tensor,
+//the names, and then the data of the tensors, each aligned to the page,
+//so the mapped file is used as it is.
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_tensors;
+  uint64_t data_offset;
+};
+
+struct CheckpointEntry {
+  static const int kMaxDims = 8;
+  uint64_t name_offset;
+  uint32_t name_length;
+  int32_t dtype;
+  int32_t num_dims;
+  int32_t dims[kMaxDims];
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+//writes the tensors(on any device) into the file at once
+void SaveCheckpoint(const std::vector<const Tensor*>& tensors,
+                    const std::string& filename);
+
+//maps the checkpoint read-only
+class CheckpointReader {
+ public:
+  explicit CheckpointReader(const std::string& filename);
+  ~CheckpointReader();
+  int size() const { return header_->num_tensors; }
+  const CheckpointEntry& entry(int i) const { return entries_[i]; }
+  std::string name(int i) const;
+  const void* data(int i) const { return base_ + entries_[i].offset; }
+  //-1 if the tensor is not in the checkpoint
+  int Find(const std::string& name) const;
+  //the shape and the type must be the same
+  void Restore(Tensor* t) const;
+
+ private:
+  const char* base_;
+  size_t length_;
+  const CheckpointHeader* header_;
+  const CheckpointEntry* entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(CheckpointReader);
+};
+
+//Copies the tensors into a host buffer between the iterations(the only
+//part blocking the training) and writes the buffer to the file in the
+//background. The file is replaced only when it is completely written.
+class CheckpointSnapshotter {
+ public:
+  CheckpointSnapshotter();
+  ~CheckpointSnapshotter();
+  //waits for the previous snapshot to be written
+  void Snapshot(const std::vector<const Tensor*>& tensors,
+                const std::string& filename);
+  void Wait();
+
+ private:
+  void Loop();
+  std::vector<char> staging_;
+  std::string filename_;
+  bool pending_;
+  bool stop_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::thread writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(CheckpointSnapshotter);
+};
+
+} //namespace midend
+
+#endif
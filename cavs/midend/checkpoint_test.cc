@@ -0,0 +1,57 @@
+#include "cavs/midend/checkpoint.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace midend;
+
+int main() {
+  Allocator* alloc = GetAllocator(DeviceTypeToString(CPU));
+  CHECK_NOTNULL(alloc);
+  Tensor a("global:Variable0", alloc, DT_FLOAT, TensorShape(vector<int>{3, 5}));
+  Tensor b("global:Variable1", alloc, DT_INT32, TensorShape(vector<int>{7}));
+  for (int i = 0; i < a.count(); i++) a.mutable_data<float>()[i] = 0.5f * i;
+  for (int i = 0; i < b.count(); i++) b.mutable_data<int>()[i] = -i;
+  const string filename = "/tmp/cavs_checkpoint_test.ckpt";
+
+  SaveCheckpoint({&a, &b}, filename);
+  {
+    CheckpointReader reader(filename);
+    CHECK(reader.size() == 2);
+    CHECK(reader.name(1) == b.name());
+    CHECK(reader.Find("global:Variable2") == -1);
+    int i = reader.Find(a.name());
+    CHECK(i == 0);
+    CHECK(reader.entry(i).num_dims == 2 && reader.entry(i).dims[1] == 5);
+    //the data is used in place
+    CHECK(reinterpret_cast<uintptr_t>(reader.data(i)) % 4096 == 0);
+    CHECK(static_cast<const float*>(reader.data(i))[4] == 2.f);
+
+    Tensor c("global:Variable0", alloc, DT_FLOAT, TensorShape(vector<int>{3, 5}));
+    reader.Restore(&c);
+    for (int j = 0; j < c.count(); j++)
+      CHECK(c.data<float>()[j] == a.data<float>()[j]);
+  }
+
+  //the snapshot is taken when it is called,
+  //the later updates do not go into the file
+  {
+    CheckpointSnapshotter snapshotter;
+    snapshotter.Snapshot({&a, &b}, filename);
+    a.mutable_data<float>()[0] = 100.f;
+    snapshotter.Wait();
+    CheckpointReader reader(filename);
+    CHECK(static_cast<const float*>(reader.data(0))[0] == 0.f);
+    Tensor d("global:Variable1", alloc, DT_INT32, TensorShape(vector<int>{7}));
+    reader.Restore(&d);
+    CHECK(d.data<int>()[6] == -6);
+  }
+  remove(filename.c_str());
+  LOG(INFO) << "checkpoint test passed";
+  return 0;
+}
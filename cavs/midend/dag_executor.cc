@@ -0,0 +1,112 @@
+#include "cavs/midend/dag_executor.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::vector;
+
+namespace midend {
+
+static inline int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int DagExecutor::AddStatement(Statement* stmt, float cost) {
+  CHECK(!finalized_);
+  CHECK_NOTNULL(stmt);
+  tasks_.emplace_back();
+  Task& t = tasks_.back();
+  t.stmt = stmt;
+  t.cost = std::max(cost, 0.f);
+  t.priority = 0;
+  t.num_deps = 0;
+  return tasks_.size()-1;
+}
+
+void DagExecutor::AddDependency(int from, int to) {
+  CHECK(!finalized_);
+  CHECK(from < to && to < tasks_.size()) << from << "\t" << to;
+  vector<int>& succs = tasks_[from].succs;
+  if (std::find(succs.begin(), succs.end(), to) == succs.end()) {
+    succs.push_back(to);
+    tasks_[to].num_deps++;
+  }
+}
+
+void DagExecutor::Finalize() {
+  CHECK(!finalized_);
+  //the statements are in a topological order,
+  //so the successors are all visited before
+  for (int i = tasks_.size()-1; i >= 0; i--) {
+    Task& t = tasks_[i];
+    float longest = 0;
+    for (int s : t.succs)
+      longest = std::max(longest, tasks_[s].priority);
+    t.priority = t.cost + longest;
+  }
+  auto more_critical = [this](int a, int b) {
+    return tasks_[a].priority > tasks_[b].priority;
+  };
+  for (int i = 0; i < tasks_.size(); i++) {
+    std::stable_sort(tasks_[i].succs.begin(), tasks_[i].succs.end(), more_critical);
+    if (tasks_[i].num_deps == 0)
+      roots_.push_back(i);
+    serial_order_.push_back(i);
+  }
+  std::stable_sort(roots_.begin(), roots_.end(), more_critical);
+  finalized_ = true;
+  VLOG(V_DEBUG) << "DAG of " << tasks_.size() << " statements, "
+                << roots_.size() << " of them ready at the beginning, "
+                << "critical path cost: "
+                << (roots_.empty() ? 0 : tasks_[roots_[0]].priority);
+}
+
+void DagExecutor::Execute(int id) {
+  while (id >= 0) {
+    Task& t = tasks_[id];
+    const int64_t start = NowNs();
+    t.stmt->Run();
+    counters_->busy_ns += NowNs() - start;
+    int next = -1;
+    for (int s : t.succs) {
+      if (--tasks_[s].pending == 0) {
+        if (next < 0)
+          next = s;
+        else
+          pool_->Schedule([this, s]() { Execute(s); });
+      }
+    }
+    if (--remaining_ == 0) {
+      std::lock_guard<std::mutex> lock(mu_);
+      done_.notify_all();
+    }
+    id = next;
+  }
+}
+
+void DagExecutor::Run() {
+  CHECK(finalized_);
+  const int64_t start = NowNs();
+  counters_->calls++;
+  counters_->shards += tasks_.size();
+  //waiting inside the pool could take the thread needed by the others
+  if (pool_->NumThreads() <= 1 || pool_->CurrentThreadId() >= 0) {
+    for (int i : serial_order_)
+      tasks_[i].stmt->Run();
+    counters_->busy_ns += NowNs() - start;
+    counters_->wall_ns += NowNs() - start;
+    return;
+  }
+  for (auto& t : tasks_)
+    t.pending = t.num_deps;
+  remaining_ = tasks_.size();
+  for (int r : roots_)
+    pool_->Schedule([this, r]() { Execute(r); });
+  std::unique_lock<std::mutex> lock(mu_);
+  done_.wait(lock, [this] { return remaining_ == 0; });
+  counters_->wall_ns += NowNs() - start;
+}
+
+} //namespace midend
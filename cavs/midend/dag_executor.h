@@ -0,0 +1,58 @@
+#ifndef CAVS_MIDEND_DAG_EXECUTOR_H_
+#define CAVS_MIDEND_DAG_EXECUTOR_H_
+
+#include "cavs/midend/statement.h"
+#include "cavs/util/thread_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace midend {
+
+//Runs the statements of a session on the CPU threads as soon as
+//the statements they depend on are done.
+//The statements are added in a topological order(the critical path).
+//Each one is given the cost of the longest chain starting from it,
+//the ready statement with the larger one is run first, and the thread
+//finishing a statement continues with its most critical successor.
+//The statements are counted in the "DagExecutor" counters of the pool.
+class DagExecutor {
+ public:
+  explicit DagExecutor(ThreadPool* pool)
+    : pool_(pool), finalized_(false),
+      counters_(ThreadPool::Counters("DagExecutor")) {}
+  int AddStatement(Statement* stmt, float cost);
+  void AddDependency(int from, int to);
+  void Finalize();
+  void Run();
+  FORCE_INLINE int size() const { return tasks_.size(); }
+
+ private:
+  struct Task {
+    Statement* stmt;
+    float cost;
+    float priority;
+    int num_deps;
+    std::vector<int> succs;
+    std::atomic<int> pending;
+  };
+  void Execute(int id);
+
+  ThreadPool* pool_;
+  std::deque<Task> tasks_;
+  std::vector<int> roots_;
+  //for running on a single thread, or from a thread of the pool
+  std::vector<int> serial_order_;
+  bool finalized_;
+  std::atomic<int> remaining_;
+  std::mutex mu_;
+  std::condition_variable done_;
+  ThreadPool::KernelCounters* counters_;
+};
+
+} //namespace midend
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef CAVS_MIDEND_GEMM_BATCHER_H_
+#define CAVS_MIDEND_GEMM_BATCHER_H_
+
+#include "cavs/midend/node.h"
+#include "cavs/midend/edge.h"
+#include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace midend {
+
+//The MatMuls of a vertex function reading the same weight(like the forget
+//gate of the tree-lstm for each child) are merged into one BatchedMatMul,
+//which reads the weight once for all of them and writes each output in
+//place. The weight is the same when the mirrors of one edge are read.
+class GemmBatcher {
+ public:
+  GemmBatcher(std::list<Node*>* nodes) {
+    std::vector<Node*> order(nodes->begin(), nodes->end());
+    std::unordered_map<Node*, int> node2idx;
+    for (int id = 0; id < order.size(); id++)
+      node2idx[order[id]] = id;
+
+    //a batch is placed after the last producer of its inputs(lo)
+    //and before the first reader of its outputs(hi)
+    std::vector<std::vector<Node*>> batches;
+    std::vector<int> lo, hi;
+    std::unordered_map<std::string, std::vector<int>> key2batches;
+    for (int id = 0; id < order.size(); id++) {
+      if (!isBatchable(order[id], node2idx))
+        continue;
+      SingleNode* mm = dynamic_cast<SingleNode*>(order[id]);
+      //the batch reads the weight of its first MatMul
+      int ready = Ready(mm->input(0), node2idx);
+      int weight_ready = Ready(mm->input(1), node2idx);
+      int used = order.size();
+      for (Node* dst : mm->output(0)->dst(true)) {
+        if (node2idx.find(dst) != node2idx.end())
+          used = std::min(used, node2idx.at(dst));
+      }
+      const std::string key = BatchKey(mm);
+      bool joined = false;
+      for (int b : key2batches[key]) {
+        if (std::max(lo[b], ready) < std::min(hi[b], used)) {
+          batches[b].push_back(mm);
+          lo[b] = std::max(lo[b], ready);
+          hi[b] = std::min(hi[b], used);
+          joined = true;
+          break;
+        }
+      }
+      if (!joined) {
+        key2batches[key].push_back(batches.size());
+        batches.push_back({mm});
+        lo.push_back(std::max(ready, weight_ready));
+        hi.push_back(used);
+      }
+    }
+
+    std::unordered_map<int, std::vector<Node*>> placed;
+    std::unordered_map<Node*, bool> removed;
+    for (int b = 0; b < batches.size(); b++) {
+      if (batches[b].size() < 2)
+        continue;
+      placed[lo[b]].push_back(Merge(batches[b]));
+      for (Node* mm : batches[b])
+        removed[mm] = true;
+    }
+    if (placed.empty())
+      return;
+    nodes->clear();
+    for (int id = -1; id < (int)order.size(); id++) {
+      if (id >= 0 && !removed[order[id]])
+        nodes->push_back(order[id]);
+      if (placed.find(id) != placed.end())
+        nodes->insert(nodes->end(), placed[id].begin(), placed[id].end());
+    }
+  }
+
+ private:
+  //the MatMuls reading the output of another MatMul are left in place,
+  //so that the batches never read each other
+  static bool isBatchable(Node* n, const std::unordered_map<Node*, int>& node2idx) {
+    if (!n->IsSingleNode() || n->name() != "MatMul")
+      return false;
+    CHECK(n->input_size() == 2 && n->output_size() == 1);
+    for (Node* src : n->input(0)->src(true)) {
+      if (node2idx.find(src) != node2idx.end() && src->name() == "MatMul")
+        return false;
+    }
+    return true;
+  }
+
+  static int Ready(const Edge* e, const std::unordered_map<Node*, int>& node2idx) {
+    int ready = -1;
+    for (Node* src : e->src(true)) {
+      if (node2idx.find(src) != node2idx.end())
+        ready = std::max(ready, node2idx.at(src));
+    }
+    return ready;
+  }
+
+  static Node* Merge(const std::vector<Node*>& batch) {
+    const OpDef& front_def = dynamic_cast<SingleNode*>(batch.front())->op_def();
+    std::vector<std::string> input_names;
+    std::vector<std::string> output_names;
+    std::vector<TensorShapeDef> output_shapes;
+    for (Node* mm : batch) {
+      input_names.push_back(mm->input(0)->name());
+      output_names.push_back(mm->output(0)->name());
+      output_shapes.push_back(mm->output(0)->shape());
+    }
+    //the weight of the first one, the others read the mirrors of the same edge
+    input_names.push_back(batch.front()->input(1)->name());
+    OpDef op_def;
+    OpDefBuilder("BatchedMatMul")
+      .Input(input_names)
+      .Output(output_names)
+      .Shape(output_shapes)
+      .AttrList<int>("Transpose", GetListArg<int>(front_def, "Transpose"))
+      .Device(front_def)
+      .Finalize(&op_def);
+    SingleNode* batched = new SingleNode(op_def, batch.front()->scope());
+    for (Node* mm : batch)
+      batched->AddInput(mm->input(0));
+    batched->AddInput(batch.front()->input(1));
+    for (Node* mm : batch)
+      batched->AddOutput(mm->output(0));
+    VLOG(V_DEBUG) << "Batching " << batch.size() << " MatMuls reading "
+                  << batch.front()->input(1)->name();
+    return batched;
+  }
+
+  //the edge whose memory the weight is
+  static const Edge* Weight(const Edge* e) {
+    while (e->src_size(true) == 1 && e->src(0, true)->name() == "Mirror" &&
+           e->src(0, true)->input_size() == 1)
+      e = e->src(0, true)->input(0);
+    return e;
+  }
+
+  static std::string BatchKey(SingleNode* mm) {
+    std::string key = Weight(mm->input(1))->scoped_name() + "|";
+    for (int t : GetListArg<int>(mm->op_def(), "Transpose"))
+      key += std::to_string(t) + ",";
+    key += "|";
+    for (int d : mm->input(0)->shape().dim())
+      key += std::to_string(d) + ",";
+    key += "|" + std::to_string(mm->op_def().device());
+    return key;
+  }
+};
+
+} //namespace midend
+
+#endif
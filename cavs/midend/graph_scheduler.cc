@@ -189,6 +189,14 @@ void SerialGraphScheduler::ActivateNext() {
 #endif
 }
 
+//each job is kept in the tensor row of its id
+const vector<int>& SerialGraphScheduler::GetAllJobIds() {
+  all_job_ids_.resize(total_length());
+  for (int gid = 0; gid < total_length(); gid++)
+    all_job_ids_[gid] = gid;
+  return all_job_ids_;
+}
+
 void BatchGraphScheduler::Initialize() {
 #ifdef CORTEX_TIME_PROFILE
   Timing::TimingBegin("DynamicBatchingTime");
@@ -230,6 +238,25 @@ void BatchGraphScheduler::Initialize() {
 #endif
 }
 
+//the rounds activate the jobs in the same order as the queue,
+//each round is appended after the previous one
+const vector<int>& BatchGraphScheduler::GetAllJobIds() {
+  CHECK(rc_.IsForward());
+  all_job_ids_.clear();
+  vector<int> activated(total_length(), 0);
+  for (int gid = 0; gid < total_length(); gid++) {
+    if ((*children_)[gid].empty() && !(*parents_)[gid].empty())
+      all_job_ids_.push_back(gid);
+  }
+  for (int i = 0; i < all_job_ids_.size(); i++) {
+    for (int pid : (*parents_)[all_job_ids_[i]]) {
+      if (++activated[pid] == (*children_)[pid].size())
+        all_job_ids_.push_back(pid);
+    }
+  }
+  return all_job_ids_;
+}
+
 void BatchGraphScheduler::ActivateNext() {
 #ifdef CORTEX_TIME_PROFILE
   Timing::TimingBegin("DynamicBatchingTime");
@@ -21,6 +21,9 @@ class GraphSchedulerBase {
   virtual bool Terminate() const = 0;
   virtual void ActivateNext() = 0;
   virtual int GetCurrentRoundOffset() const = 0;
+  //the jobs of all the rounds in the order of their tensor ids,
+  //for the ops hoisted out of the rounds(run before Initialize)
+  virtual const std::vector<int>& GetAllJobIds() = 0;
 
   int LoadGraph(const Tensor& parent_ids);
   int ReverseGraph();
@@ -89,6 +92,7 @@ class GraphSchedulerBase {
   std::vector<int> jobids_to_tids_;
   std::vector<int> tids_to_jobids_;
   std::vector<int> round2offset_;
+  std::vector<int> all_job_ids_;
 
   Tensor message_passer_;
   Tensor func_arg_;
@@ -132,6 +136,7 @@ class SerialGraphScheduler : public GraphSchedulerBase {
   void ActivateNext() override;
   inline bool Terminate() const override { return pending_list_.empty(); }
   inline int GetCurrentRoundOffset() const override { return GetJobId()[0]; }
+  const std::vector<int>& GetAllJobIds() override;
 
  private:
   int sample_id_;
@@ -147,6 +152,7 @@ class BatchGraphScheduler : public GraphSchedulerBase {
   void ActivateNext() override;
   inline bool Terminate() const override { return ready_to_execute_ids_.empty(); }
   inline int GetCurrentRoundOffset() const override { return round2offset_[rc_()]; }
+  const std::vector<int>& GetAllJobIds() override;
 
  private:
   std::vector<std::vector<int>> execution_tracer_;
@@ -1,4 +1,5 @@
 #include "cavs/midend/graph_session.h"
+#include <algorithm>
 #include <iostream>
 
 using std::string;
@@ -47,7 +48,8 @@ OpContext* GraphSession::GetContext(const Node* node) {
   //This context assign the full tensor for each operator
   //But for each function call, it may work on a specific range
   //of the whole tensor, which we will support through tensor class.
-  OpContext* ctxt  = new OpContext();
+  OpContext* ctxt  = arena()->New<OpContext>(arena(), execution_state());
+  ctxt->Reserve(node->input_size(), node->output_size());
   CHECK(gscheduler_);
   ctxt->SetGraphScheduler(gscheduler_);
   CHECK(node->IsSingleNode());
@@ -62,6 +64,12 @@ OpContext* GraphSession::GetContext(const Node* node) {
     VLOG(V_DEBUG) << "[In Graph Session]: the addr of " << TensorNameInFunctionContext(input)
                   << " is " << t;
     ctxt->AppendInput(t);
+    //the forward ops of the same round read the fp32 tensor directly,
+    //only the backward ops have to restore it from the stash
+    if (stashes_.find(TensorNameInFunctionContext(input)) != stashes_.end() &&
+        input->scope() != node->scope()) {
+      ctxt->AppendStashOnRead(stashes_.at(TensorNameInFunctionContext(input)).get());
+    }
   }
 
   for (auto* output : node->output()) {
@@ -144,8 +152,14 @@ OpContext* GraphSession::GetContext(const Node* node) {
         }
         InsertTensor(out);
       }else {
-        if (node->name() == "Push"   || node->name() == "Pull" ||
-            node->name() == "Gather" || node->name() == "Scatter") {
+        //the scatter/push fused into a kernel write the same tensors
+        const vector<string>& stores = GetListArg<string>(op_def, "IndexedStores");
+        const bool scattered = (node->name() == "Scatter") ||
+          std::find(stores.begin(), stores.end(), output->name()) != stores.end();
+        const bool pushed = (node->name() == "Push") ||
+          GetSingleArg<string>(op_def, "PushedOutput", "") == output->name();
+        if (pushed || scattered ||
+            node->name() == "Pull" || node->name() == "Gather") {
           dynamic_shape = true;
         }else if (!output->isGradient()) {
           dynamic_shape = output->IsDynamicEnabled();
@@ -171,7 +185,7 @@ OpContext* GraphSession::GetContext(const Node* node) {
                       << TensorNameInFunctionContext(output)
                       << " with shape info: " << full_shape.debug_info();
 
-        if (node->name() == "Scatter") {
+        if (scattered) {
           if (!internal_message_pool_) {
             const string& tname = scope_->scoped_name() + ":__interal_message_pool";
             Tensor out(tname, alloc, op_def.dtype(), std::move(full_shape));
@@ -184,6 +198,21 @@ OpContext* GraphSession::GetContext(const Node* node) {
           Tensor out(TensorNameInFunctionContext(output), *internal_message_pool_);
           out.Resize(partial_shape);
           InsertTensor(out);
+        }else if (dynamic_shape && CanStash(node, output)) {
+          //only the current round is allocated in fp32,
+          //all the rounds are kept in the stash with 16 bits
+          const string& tname = TensorNameInFunctionContext(output);
+          Tensor out(tname, alloc, op_def.dtype(), partial_shape);
+          out.SetAsDynamic();
+          out.SetAsStashed();
+          InsertTensor(out);
+          ActivationStash::Format format = (opt_type() & OPT_ACTIVATION_BF16) ?
+                                           ActivationStash::BF16 : ActivationStash::FP16;
+          ActivationStash* stash = new ActivationStash(
+              const_cast<Tensor*>(GetTensor(tname)), alloc, format, MAX_NODE_);
+          CHECK(stashes_.find(tname) == stashes_.end()) << tname;
+          stashes_[tname].reset(stash);
+          ctxt->AppendStashOnWrite(stash);
         }else {
           Tensor out(TensorNameInFunctionContext(output), alloc, op_def.dtype(), std::move(full_shape));
           out.Resize(partial_shape);
@@ -206,22 +235,46 @@ OpContext* GraphSession::GetContext(const Node* node) {
   return ctxt;
 }
 
-namespace __internal {
-  static unordered_map<string, GraphSession*> graph_sess_pool;
-}
-
-GraphSession* GetGraphSession(const string& name) {
-  return (__internal::graph_sess_pool.find(name) == __internal::graph_sess_pool.end()) ?
-          NULL : __internal::graph_sess_pool.at(name);
-}
-
-bool InsertGraphSession(const std::string& name, GraphSession* sess) {
-  if (__internal::graph_sess_pool.find(name) != __internal::graph_sess_pool.end()) {
+//A forward activation can be stashed in 16 bits when
+//1) it is a per-round float tensor that only lives in this round for the forward ops,
+//2) the other readers are the backward ops, which run in the same rounds reversely.
+//The readers which alias its buffer or read all the rounds at once
+//(the weight gradients batched out of the loop) need the fp32 tensor of all rounds,
+//so do the writers hoisted out of the loop.
+bool GraphSession::CanStash(const Node* node, const Edge* output) const {
+  if (!(opt_type() & (OPT_ACTIVATION_FP16 | OPT_ACTIVATION_BF16)) ||
+      hoisted_.count(node))
     return false;
-  }else {
-    __internal::graph_sess_pool.emplace(name, sess);
-    return true;
+  CHECK(node->IsSingleNode());
+  const OpDef& op_def = dynamic_cast<const SingleNode*>(node)->op_def();
+  if (output->isGradient() || op_def.dtype() != DT_FLOAT)
+    return false;
+
+  const string& grad_scope = GetGradientName(output->scope()->name());
+  bool read_by_backward = false;
+  for (Node* n : output->dst()) {
+    if (n->IsSingleNode() &&
+        GetSingleArg<bool>(dynamic_cast<SingleNode*>(n)->op_def(), "ShareMemory", false) &&
+        n->input(0) == output) {
+      return false;
+    }
+    if (n->scope() == output->scope())
+      continue;
+    if (n->scope()->name() != grad_scope)
+      return false;
+    if (opt_type() & OPT_BATCHING) {
+      for (Edge* e : n->output()) {
+        if (e->isGradient()) {
+          const Edge* forward_e = n->scope()->FindEdge(GetOriginName(e->name()));
+          if (forward_e && !forward_e->IsDynamicEnabled())
+            return false;
+        }
+      }
+    }
+    read_by_backward = true;
   }
+  VLOG_IF(V_DEBUG, read_by_backward) << output->scoped_name() << " can be stashed";
+  return read_by_backward;
 }
 
 } //namespace midend
@@ -4,8 +4,13 @@
 #include "cavs/midend/session_base.h"
 #include "cavs/midend/tensor.h"
 #include "cavs/midend/graph_scheduler.h"
+#include "cavs/midend/activation_stash.h"
 #include "cavs/proto/opt.pb.h"
 
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
 namespace midend {
 
 class SessionBase;
@@ -25,6 +30,17 @@ class GraphSession : public SessionBase {
   }
   const Tensor* GetTensor(const std::string& name, bool recursive = false) const override;
   OpContext* GetContext(const Node* node) override;
+  //the node function is compiled into the arena of the outer session
+  Arena* arena() override { return global_sess_->arena(); }
+  ExecutionState* execution_state() override {
+    return global_sess_->execution_state();
+  }
+  GraphSession* FindGraphSession(const std::string& name) const override {
+    return global_sess_->FindGraphSession(name);
+  }
+  void InsertGraphSession(const std::string& name, GraphSession* sess) override {
+    global_sess_->InsertGraphSession(name, sess);
+  }
   inline void SetInternalMessagePool(const Tensor* t) {
     CHECK_NOTNULL(t);
     internal_message_pool_ = t;
@@ -32,20 +48,22 @@ class GraphSession : public SessionBase {
   }
   std::string TensorNameInFunctionContext(const Edge* e) const;
   GraphSchedulerBase* graph_scheduler() { return gscheduler_; }
+  //the outputs of the ops hoisted out of the rounds hold all the rounds
+  inline void SetHoisted(const Node* node) { hoisted_.insert(node); }
   int session_type() const { return SessionBase::GRAPH; }
 
  private:
+  bool CanStash(const Node* node, const Edge* output) const;
   SessionBase* global_sess_;
   const Scope* scope_;
   GraphSchedulerBase* gscheduler_;
   const Tensor *internal_message_pool_;
   const int MAX_NODE_;
   std::string name_;
+  std::unordered_map<std::string, std::unique_ptr<ActivationStash>> stashes_;
+  std::unordered_set<const Node*> hoisted_;
 };
 
-GraphSession* GetGraphSession(const std::string& name);
-bool InsertGraphSession(const std::string& name, GraphSession* sess);
-
 } //namespace midend
 
 #endif
@@ -0,0 +1,243 @@
+#ifndef CAVS_MIDEND_GRAPH_SIMPLIFIER_H_
+#define CAVS_MIDEND_GRAPH_SIMPLIFIER_H_
+
+#include "cavs/midend/node.h"
+#include "cavs/midend/edge.h"
+#include "cavs/midend/session_base.h"
+#include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace midend {
+
+//The nodes of a simple session to be compiled, rewritten before compiling:
+//the subgraphs of the constants are folded into one ConstOp,
+//the nodes computing the same thing as an earlier one are removed
+//(their outputs are the tensors of the earlier one in the session),
+//and the nodes no longer read for the outputs are removed.
+//The edges of the graph are not changed, only the list of the nodes.
+class GraphSimplifier {
+ public:
+  GraphSimplifier(std::list<Node*>* nodes, const std::vector<const Node*>& outputs,
+                  SessionBase* sess) {
+    int before = nodes->size();
+    FoldConstants(nodes, sess);
+    VLOG(V_TIMING) << "Constant folding: " << before << " -> " << nodes->size()
+                   << " nodes, " << folded_ << " folded";
+    before = nodes->size();
+    EliminateCommonSubexpressions(nodes, sess);
+    common_removed_ = before - nodes->size();
+    VLOG(V_TIMING) << "Common subexpression elimination: " << before
+                   << " -> " << nodes->size() << " nodes";
+    before = nodes->size();
+    EliminateDeadNodes(nodes, outputs);
+    dead_removed_ = before - nodes->size();
+    VLOG(V_TIMING) << "Dead node elimination: " << before
+                   << " -> " << nodes->size() << " nodes";
+  }
+
+  //the nodes replaced by the constants, and the ones removed by each pass
+  int folded() const { return folded_; }
+  int common_removed() const { return common_removed_; }
+  int dead_removed() const { return dead_removed_; }
+
+  //the outputs of the removed nodes, read from the outputs of the node kept
+  const std::vector<const Edge*>& aliases(const Edge* kept) const {
+    static const std::vector<const Edge*> none;
+    auto iter = aliases_.find(kept);
+    return (iter == aliases_.end()) ? none : iter->second;
+  }
+
+ private:
+  //the ops reading nothing but their inputs and writing nothing but their
+  //outputs, so that they are computed once and removed when not read
+  static bool isPure(const Node* node) {
+    static std::vector<std::string> pure_ops =
+      {"ConstOp", "Fill", "Add", "Sub", "Mul", "Neg", "Abs", "Square", "Scal", "Equal",
+       "Relu", "Sigmoid", "Tanh", "MatMul", "Reshape", "ReshapeLike", "Flatten",
+       "Expand_dims", "Slice", "Concat", "Mirror", "Reduce_sum", "Reduce_mean",
+       "Argmax", "EmbeddingLookup"};
+    static std::vector<std::string> pure_grads =
+      {"Square", "Relu", "Sigmoid", "Tanh", "Slice", "Concat", "Reshape", "Flatten"};
+    if (!node->IsSingleNode() || node->IsStatefulOp() ||
+        !node->control_dependency().empty())
+      return false;
+    const std::string& name = node->name();
+    if (std::find(pure_ops.begin(), pure_ops.end(), name) != pure_ops.end())
+      return true;
+    for (auto& op : pure_grads) {
+      if (name == GetGradientName(op))
+        return true;
+    }
+    return false;
+  }
+
+  //the output is written by the node alone
+  static bool isPlainOutput(const Node* node) {
+    if (node->output_size() != 1)
+      return false;
+    const Edge* e = node->output(0);
+    return !e->isVirtual() && !e->isVariable() && e->src_size() == 1;
+  }
+
+  //the value of the elements of a uniform(constant) tensor
+  bool Fold(const SingleNode* node, float* value) const {
+    static std::vector<std::string> unary_ops =
+      {"Neg", "Abs", "Square", "Relu", "Sigmoid", "Tanh", "Assign", "Fill"};
+    static std::vector<std::string> binary_ops = {"Add", "Sub", "Mul"};
+    const std::string& name = node->name();
+    auto constant = [this](const Edge* e, float* v) {
+      auto iter = constants_.find(e);
+      if (iter == constants_.end())
+        return false;
+      *v = iter->second;
+      return true;
+    };
+    float a, b;
+    if (std::find(unary_ops.begin(), unary_ops.end(), name) != unary_ops.end()) {
+      //the second input of the fill is only its shape
+      if (node->input_size() < 1 || !constant(node->input(0), &a))
+        return false;
+      if (name == "Neg")          *value = -a;
+      else if (name == "Abs")     *value = std::fabs(a);
+      else if (name == "Square")  *value = a*a;
+      else if (name == "Relu")    *value = std::max(a, 0.f);
+      else if (name == "Sigmoid") *value = 1.f / (1.f + std::exp(-a));
+      else if (name == "Tanh")    *value = std::tanh(a);
+      else                        *value = a;
+      return true;
+    }
+    if (std::find(binary_ops.begin(), binary_ops.end(), name) != binary_ops.end()) {
+      if (node->input_size() != 2 || !constant(node->input(0), &a) ||
+          !constant(node->input(1), &b))
+        return false;
+      if (name == "Add")      *value = a + b;
+      else if (name == "Sub") *value = a - b;
+      else                    *value = a * b;
+      return true;
+    }
+    return false;
+  }
+
+  //ConstOp is only implemented on the gpu
+  void FoldConstants(std::list<Node*>* nodes, SessionBase* sess) {
+    folded_ = 0;
+    for (auto iter = nodes->begin(); iter != nodes->end(); iter++) {
+      if (!(*iter)->IsSingleNode() || !isPlainOutput(*iter) ||
+          !(*iter)->control_dependency().empty())
+        continue;
+      const SingleNode* node = dynamic_cast<SingleNode*>(*iter);
+      const Edge* out = node->output(0);
+      if (node->op_def().device() != GPU || node->dtype() != DT_FLOAT ||
+          out->IsDynamicEnabled())
+        continue;
+      if (node->name() == "ConstOp") {
+        constants_[out] = GetSingleArg<float>(node->op_def(), "init");
+        continue;
+      }
+      float value;
+      if (!Fold(node, &value))
+        continue;
+      OpDef const_def;
+      OpDefBuilder("ConstOp")
+        .Output(out->name())
+        .Shape(out->shape())
+        .Dtype(DT_FLOAT)
+        .AttrSingle("init", value)
+        .Device(node->op_def())
+        .Finalize(&const_def);
+      //neither an op of the scope nor a source of the edge, the gradients
+      //and the other compilings still see the folded node
+      SingleNode* const_node = new SingleNode(const_def, node->scope(), false);
+      sess->AddOwnedNode(const_node);
+      const_node->AddOutput(out);
+      VLOG(V_DEBUG) << "Folding " << node->name() << "(" << out->name()
+                    << ") into " << value;
+      constants_[out] = value;
+      *iter = const_node;
+      folded_++;
+    }
+  }
+
+  //the edge whose tensor is read for the output of a removed node
+  const Edge* Kept(const Edge* e) const {
+    auto iter = kept_.find(e);
+    return (iter == kept_.end()) ? e : iter->second;
+  }
+
+  void EliminateCommonSubexpressions(std::list<Node*>* nodes, const SessionBase* sess) {
+    std::unordered_map<std::string, const Node*> computed;
+    for (auto iter = nodes->begin(); iter != nodes->end(); ) {
+      Node* node = *iter;
+      if (!isPure(node) || !isPlainOutput(node)) {
+        iter++;
+        continue;
+      }
+      //the same op of the same attributes and shapes reading the same tensors
+      OpDef def = dynamic_cast<SingleNode*>(node)->op_def();
+      def.clear_input();
+      def.clear_output();
+      std::string key;
+      def.SerializeToString(&key);
+      for (const Edge* e : node->input())
+        key += "|" + std::to_string(reinterpret_cast<uintptr_t>(Kept(e)));
+      auto found = computed.find(key);
+      //the tensor of the output may already be made by another compiling
+      if (found == computed.end() ||
+          sess->GetTensor(node->output(0)->scoped_name())) {
+        computed.emplace(key, node);
+        iter++;
+        continue;
+      }
+      const Edge* kept = found->second->output(0);
+      VLOG(V_DEBUG) << "Removing " << node->name() << "(" << node->output(0)->name()
+                    << "), the same as " << kept->name();
+      kept_[node->output(0)] = kept;
+      aliases_[kept].push_back(node->output(0));
+      iter = nodes->erase(iter);
+    }
+  }
+
+  void EliminateDeadNodes(std::list<Node*>* nodes, const std::vector<const Node*>& outputs) {
+    std::unordered_set<const Edge*> read;
+    for (auto* n : outputs) {
+      for (auto* e : n->output())
+        read.insert(Kept(e));
+    }
+    for (auto iter = nodes->rbegin(); iter != nodes->rend(); ) {
+      Node* node = *iter;
+      bool live = !isPure(node);
+      for (auto* e : node->output())
+        live |= (read.count(e) > 0);
+      if (!live) {
+        VLOG(V_DEBUG) << "Removing " << node->name() << ", which is not read";
+        iter = std::list<Node*>::reverse_iterator(nodes->erase(std::next(iter).base()));
+        continue;
+      }
+      for (auto* e : node->input())
+        read.insert(Kept(e));
+      for (auto* e : node->control_dependency())
+        read.insert(e);
+      iter++;
+    }
+  }
+
+  std::unordered_map<const Edge*, float> constants_;
+  std::unordered_map<const Edge*, const Edge*> kept_;
+  std::unordered_map<const Edge*, std::vector<const Edge*>> aliases_;
+  int folded_;
+  int common_removed_;
+  int dead_removed_;
+};
+
+} //namespace midend
+
+#endif
@@ -203,14 +203,48 @@ void GraphUtil::ComputeGradient(
   GenGradient(loss_scope, critical_path, grads, loss_edge);
 }
 
+//The gradient of each micro-batch is copied(the first one) or added(the
+//others) into an accumulator, which the clipper and the solver use instead
+void GraphUtil::AccumulateGradient(
+    Scope* loss_scope,
+    const vector<string>& vars,
+    vector<string>* grads,
+    vector<Node*>* first,
+    vector<Node*>* rest) {
+  for (auto& var_name : vars) {
+    const Edge* var = loss_scope->FindEdge(var_name);
+    const string grad = GetGradientName(var_name);
+    const string accum = grad + "_accum";
+    OpDef copy;
+    OpDefBuilder("Assign")
+      .Input(grad)
+      .Output(accum)
+      .Shape(var->shape())
+      .Device("GPU")
+      .Finalize(&copy);
+    first->push_back(loss_scope->AddOp(copy));
+    OpDef add;
+    OpDefBuilder("Add")
+      .Input(accum)
+      .Input(grad)
+      .Output(accum)
+      .Shape(var->shape())
+      .Device("GPU")
+      .Finalize(&add);
+    rest->push_back(loss_scope->AddOp(add));
+    grads->push_back(accum);
+  }
+}
+
 void GraphUtil::GradientProcess(
     Scope* loss_scope,
     const vector<string>& vars,
-    float clip) {
-  vector<string> outputs;
+    const vector<string>& grads,
+    float clip,
+    vector<Node*>* nodes) {
+  vector<string> outputs(grads);
   vector<TensorShapeDef> outputs_shape;
   for (auto& var_name : vars) {
-    outputs.emplace_back(GetGradientName(var_name));
     const Edge* var = loss_scope->FindEdge(var_name);
     outputs_shape.emplace_back(var->shape());
   }
@@ -222,27 +256,30 @@ void GraphUtil::GradientProcess(
     .Device("GPU")
     .AttrSingle<float>("clip", clip)
     .Finalize(&clipper);
-  loss_scope->AddOp(clipper);
+  nodes->push_back(loss_scope->AddOp(clipper));
 }
 
 void GraphUtil::ApplyGradient(
     Scope* loss_scope,
     const vector<string>& vars,
+    const vector<string>& grads,
     const string& solver,
     const string& proj,
-    float lr) {
-  for (auto& var_name : vars) {
+    float lr,
+    vector<Node*>* nodes) {
+  for (int i = 0; i < vars.size(); i++) {
+    const string& var_name = vars[i];
     const Edge* var = loss_scope->FindEdge(var_name);
     OpDef update;  
     OpDefBuilder(solver)
       .Input(var_name)
-      .Input(GetGradientName(var_name))
+      .Input(grads[i])
       .Output(var_name)
       .Shape(var->shape())
       .AttrSingle<float>("Learning_rate", lr)
       .Device("GPU")
       .Finalize(&update);
-    loss_scope->AddOp(update);
+    nodes->push_back(loss_scope->AddOp(update));
 
     if (proj.length() > 0) {
       OpDef projection;  
@@ -252,7 +289,7 @@ void GraphUtil::ApplyGradient(
         .Shape(var->shape())
         .Device("GPU")
         .Finalize(&projection);
-      loss_scope->AddOp(projection);
+      nodes->push_back(loss_scope->AddOp(projection));
     }
   }
 }
@@ -268,12 +305,14 @@ ScopedNode* GraphUtil::AddOptimizerOp(const OpDef& def) {
   float  clip   = GetSingleArg(def, "Clip"         , 0.f       );
   string proj   = GetSingleArg(def, "Projection"   , string(""));
   string solver = GetSingleArg(def, "Solver"       , string(""));
+  int    micro  = GetSingleArg(def, "MicroBatches" , 1         );
 
   CHECK(!var_names.empty());
   CHECK(iters > 0);
   CHECK(lr > 0);
   CHECK(clip >= 0);
   CHECK(!solver.empty());
+  CHECK(micro > 0);
 
   Scope* loss_scope = new Scope(s_, def.output(0));
 
@@ -284,10 +323,23 @@ ScopedNode* GraphUtil::AddOptimizerOp(const OpDef& def) {
   VLOG(V_DEBUG) << "Compute Gradients...";
   ComputeGradient(loss_scope, sn, var_names, loss_edge, s_);
   VLOG(V_DEBUG) << "Gradient process...";
-  if (clip > 0) GradientProcess(loss_scope, var_names, clip);
-  ApplyGradient(loss_scope, var_names, solver, proj, lr);
+  vector<string> grads;
+  vector<Node*> first, rest, apply;
+  if (micro > 1) {
+    VLOG(V_DEBUG) << "Accumulating gradients of " << micro << " micro-batches...";
+    AccumulateGradient(loss_scope, var_names, &grads, &first, &rest);
+  }else {
+    for (auto& var_name : var_names)
+      grads.push_back(GetGradientName(var_name));
+  }
+  //the sum of the micro-batches is applied, the learning rate is scaled
+  //so that it is their mean, and so is the clip, so that it bounds the mean
+  //as it does without the micro-batches
+  if (clip > 0) GradientProcess(loss_scope, var_names, grads, clip*micro, &apply);
+  ApplyGradient(loss_scope, var_names, grads, solver, proj, lr/micro, &apply);
 
   sn->SetContainedScope(loss_scope);
+  if (micro > 1) sn->SetMicroBatches(micro, first, rest, apply);
   VLOG(V_DEBUG) << "Optimizer generated...";
 
   return sn;
@@ -37,14 +37,23 @@ class GraphUtil {
       const std::vector<std::string>& vars,
       const Edge* loss,
       const Scope* main_scope);
+  void AccumulateGradient(Scope* loss_scope,
+      const std::vector<std::string>& vars,
+      std::vector<std::string>* grads,
+      std::vector<Node*>* first,
+      std::vector<Node*>* rest);
   void GradientProcess(Scope* loss_scope,
       const std::vector<std::string>& vars,
-      float clip);
+      const std::vector<std::string>& grads,
+      float clip,
+      std::vector<Node*>* nodes);
   void ApplyGradient(Scope* loss_scope,
       const std::vector<std::string>& vars,
+      const std::vector<std::string>& grads,
       const std::string& solver,
       const std::string& proj,
-      float lr);
+      float lr,
+      std::vector<Node*>* nodes);
   void ComputeGradientForFunction(
       Scope* func_grad_scope,
       const Scope* func_scope);
@@ -3,6 +3,8 @@
 #include "cavs/midend/runtime_compiler/code_generator.h"
 #include "cavs/midend/stream_scheduler.h"
 #include "cavs/midend/batch_weight_updater.h"
+#include "cavs/midend/gemm_batcher.h"
+#include "cavs/midend/pull_hoister.h"
 #include "cavs/util/op_def_builder.h"
 
 using std::string;
@@ -10,9 +12,10 @@ using std::vector;
 
 namespace midend {
 
-Node::Node(Scope* located) :
-  located_(located), inputs_(0), outputs_(0), stmt_(NULL) {
-  located->AddNode(this);
+Node::Node(Scope* located, bool in_scope) :
+  located_(located), inputs_(0), outputs_(0) {
+  if (in_scope)
+    located->AddNode(this);
 }
 
 string Node::scoped_name() const {
@@ -55,8 +58,8 @@ string SingleNode::debug_info() const {
          op_def_.DebugString();
 }
 
-SingleNode::SingleNode(const OpDef& op_def, Scope* s)
-  : Node(s), op_def_(op_def), isDynamicEnabled_(false), sess_debug_(NULL) {}
+SingleNode::SingleNode(const OpDef& op_def, Scope* s, bool in_scope)
+  : Node(s, in_scope), op_def_(op_def), isDynamicEnabled_(false) {}
 
 void SingleNode::SetShape(
     const vector<TensorShapeDef>& def) {
@@ -80,14 +83,24 @@ void SingleNode::SetDynamicEnabled() {
 
 Statement* SingleNode::Compile(
     SessionBase* sess) {
-  if (!stmt_) {
-    {
-      CHECK(sess && (!sess_debug_ || sess_debug_ == sess))
-          << "currently, we only support one node is compiled by one session";
-      sess_debug_ = sess;
-    }
+  CHECK_NOTNULL(sess);
+  Statement*& stmt = sess->CompiledStatement(this);
+  //the variable is initialized by the source session here, the replica
+  //compiles its own statement on the shared tensor, which never fills it
+  const bool shared = !stmt && op_def().name() == "Variable" && sess->variable_source();
+  if (shared) {
+    Compile(sess->variable_source())->Run();
+    CHECK_NOTNULL(sess->SharedVariable(output(0)));
+  }
+  if (!stmt) {
     OpImpl* op = NULL;
-    if ((sess->session_type() & SessionBase::MPI) &&
+    if (shared) {
+      OpDef shared_def = op_def();
+      OpDef::AttrDef* attr = shared_def.add_attr();
+      attr->set_name("Shared");
+      attr->mutable_value()->set_b(true);
+      op = CreateOp(shared_def, sess->arena());
+    }else if ((sess->session_type() & SessionBase::MPI) &&
         (op_def().name() == "Variable" ||
          op_def().name() == "DDV" ||
          op_def().name() == "Data")) {
@@ -95,29 +108,31 @@ Statement* SingleNode::Compile(
       mpi_def.set_name(op_def().name()+"MPI");
       // LOG(INFO) << "Compiling SingleNode:\t" << mpi_def.name();
       VLOG(V_DEBUG) << mpi_def.DebugString();
-      op = CreateOp(mpi_def);
+      op = CreateOp(mpi_def, sess->arena());
     }else {
       // LOG(INFO) << "Compiling SingleNode:\t" << op_def().DebugString();
       VLOG(V_DEBUG) << op_def().DebugString();
-      op = CreateOp(op_def());
+      op = CreateOp(op_def(), sess->arena());
     }
     OpContext* ctxt = sess->GetContext(this);
     CHECK(ctxt) << op_def().DebugString();
     CHECK(op) << op_def().DebugString();
     CHECK(ctxt) << op_def().DebugString();
-    ExprStatement* expr_stmt = new ExprStatement(op, ctxt);
+    ctxt->SetKernelName(op_def().name());
+    ExprStatement* expr_stmt = sess->arena()->New<ExprStatement>(op, ctxt);
     CHECK(expr_stmt);
-    stmt_ = expr_stmt;
+    stmt = expr_stmt;
   }
-  return stmt_;
+  return stmt;
 }
 
 GraphNode::GraphNode(const OpDef& op_def, Scope* s)
-  : SingleNode(op_def, s), gsess_(NULL) {}
+  : SingleNode(op_def, s) {}
 
 Statement* GraphNode::Compile(
     SessionBase* sess) {
-  if (!stmt_) {
+  Statement*& stmt = sess->CompiledStatement(this);
+  if (!stmt) {
     OpContext* ctxt = sess->GetContext(this);
     ExprStatement* push_arg_stmt = NULL;
     ExprStatement* pop_ret_stmt = NULL;
@@ -126,24 +141,25 @@ Statement* GraphNode::Compile(
       .Input(this->input(1)->name())
       .Device("GPU")
       .Finalize(&push_arg_def);
-    OpImpl *push_arg_op = CreateOp(push_arg_def);
+    OpImpl *push_arg_op = CreateOp(push_arg_def, sess->arena());
     OpDef pop_ret_def;
     OpDefBuilder("FunctionPopRet")
       .Output(this->output(0)->name())
       .Device("GPU")
       .Finalize(&pop_ret_def);
-    OpImpl *pop_ret_op = CreateOp(pop_ret_def);
+    OpImpl *pop_ret_op = CreateOp(pop_ret_def, sess->arena());
     OpContext* push_ctxt = ctxt->ExtractContext({1}, {});
     OpContext* pop_ctxt  = ctxt->ExtractContext({}, {0});
 
 
     VLOG(V_DEBUG) << "Compiling GraphNode:\t" << op_def().name();
-    if (!(gsess_ = GetGraphSession(op_def_.output(0)))) {
+    GraphSession* gsess = sess->FindGraphSession(op_def_.output(0));
+    if (!gsess) {
       int max_graph_node_count = GetSingleArg<int>(op_def_, "MaxGraphNodeCount");
       CHECK(max_graph_node_count > 0);
       //GraphScheduler* gs = new GraphScheduler();
-      gsess_ = new GraphSession(sess, op_def_.output(0), max_graph_node_count);
-      InsertGraphSession(op_def_.output(0), gsess_);
+      gsess = new GraphSession(sess, op_def_.output(0), max_graph_node_count);
+      sess->InsertGraphSession(op_def_.output(0), gsess);
     }
 
     ScopedNode* sn = dynamic_cast<ScopedNode*>(main_scope()->FindNode("Node"));
@@ -160,30 +176,47 @@ Statement* GraphNode::Compile(
         }
       }
     }
-    CHECK_NOTNULL(gsess_);
-    Statement* node_func_stmt = sn->Compile(gsess_);
-
-    push_ctxt->SetGraphScheduler(gsess_->graph_scheduler());
-    push_arg_stmt = new ExprStatement(push_arg_op, push_ctxt);
-    stmt_ = new GraphStatement(node_func_stmt, gsess_->graph_scheduler());
-    dynamic_cast<GraphStatement*>(stmt_)->SetGlobalContext(ctxt);
-    dynamic_cast<GraphStatement*>(stmt_)->SetPushArgStatement(push_arg_stmt);
+    CHECK_NOTNULL(gsess);
+    std::list<Node*> hoisted_node;
+    if (sess->opt_type() & OPT_BATCHING) {
+      VLOG(V_DEBUG) << "Begin hoisting the pulled subgraph out of the rounds";
+      PullHoister hoister(&(sn->nodes_), &hoisted_node);
+      VLOG(V_DEBUG) << "Hoisting done";
+    }
+    //compiled before the body, which reads their outputs
+    vector<Statement*> hoisted;
+    for (Node* hn : hoisted_node) {
+      gsess->SetHoisted(hn);
+      Statement* hoisted_stmt = hn->Compile(gsess);
+      CHECK(hoisted_stmt) << hn->debug_info();
+      hoisted.push_back(hoisted_stmt);
+    }
+    Statement* node_func_stmt = sn->Compile(gsess);
+
+    push_ctxt->SetGraphScheduler(gsess->graph_scheduler());
+    push_arg_stmt = sess->arena()->New<ExprStatement>(push_arg_op, push_ctxt);
+    stmt = sess->arena()->New<GraphStatement>(node_func_stmt, gsess->graph_scheduler());
+    dynamic_cast<GraphStatement*>(stmt)->SetGlobalContext(ctxt);
+    dynamic_cast<GraphStatement*>(stmt)->SetPushArgStatement(push_arg_stmt);
     if (pop_exist) {
-      pop_ctxt->SetGraphScheduler(gsess_->graph_scheduler());
-      pop_ret_stmt = new ExprStatement(pop_ret_op, pop_ctxt);
-      dynamic_cast<GraphStatement*>(stmt_)->SetPopRetStatement(pop_ret_stmt);
+      pop_ctxt->SetGraphScheduler(gsess->graph_scheduler());
+      pop_ret_stmt = sess->arena()->New<ExprStatement>(pop_ret_op, pop_ctxt);
+      dynamic_cast<GraphStatement*>(stmt)->SetPopRetStatement(pop_ret_stmt);
     }
+    if (!hoisted.empty())
+      dynamic_cast<GraphStatement*>(stmt)->SetHoisted(std::move(hoisted));
   }
-  return stmt_;
+  return stmt;
 }
 
 GraphGradNode::GraphGradNode(const OpDef& op_def, Scope* s)
-  : SingleNode(op_def, s), gsess_(NULL) {}
+  : SingleNode(op_def, s) {}
 
 Statement* GraphGradNode::Compile(
     SessionBase* sess) {
-  if (!stmt_) {
-    //OpImpl* op = CreateOp(op_def());
+  Statement*& stmt = sess->CompiledStatement(this);
+  if (!stmt) {
+    //OpImpl* op = CreateOp(op_def(), sess->arena());
     //OpContext* ctxt = sess->GetContext(this);
     OpContext* ctxt = sess->GetContext(this);
     ExprStatement* push_arg_stmt = NULL;
@@ -193,13 +226,13 @@ Statement* GraphGradNode::Compile(
       .Input(this->input(0)->name())
       .Device("GPU")
       .Finalize(&push_arg_def);
-    OpImpl *push_arg_op = CreateOp(push_arg_def);
+    OpImpl *push_arg_op = CreateOp(push_arg_def, sess->arena());
     OpDef pop_ret_def;
     OpDefBuilder("FunctionPopRet")
       .Output(this->output(0)->name())
       .Device("GPU")
       .Finalize(&pop_ret_def);
-    OpImpl* pop_ret_op   = CreateOp(pop_ret_def);
+    OpImpl* pop_ret_op   = CreateOp(pop_ret_def, sess->arena());
     OpContext* push_ctxt = ctxt->ExtractContext({0}, {});
     OpContext* pop_ctxt  = ctxt->ExtractContext({}, {0});
 
@@ -207,7 +240,8 @@ Statement* GraphGradNode::Compile(
     //when the graphgrad node is compiled,
     //the graph node must have been compile already
     //that means its graph session has been set
-    CHECK_NOTNULL(gsess_ = GetGraphSession(GetOriginName(op_def_.input(0))));
+    GraphSession* gsess = sess->FindGraphSession(GetOriginName(op_def_.input(0)));
+    CHECK_NOTNULL(gsess);
 
     CHECK(main_scope()->FindChildScope("Node"));
     bool pop_exist = false;
@@ -233,35 +267,36 @@ Statement* GraphGradNode::Compile(
       VLOG(V_DEBUG) << "Modifing the critical path done for Batching in ScopedNode";
     }
 
-    Statement* node_grad_stmt = sn->Compile(gsess_);
+    Statement* node_grad_stmt = sn->Compile(gsess);
 
     if (sess->opt_type() & OPT_BATCHING) {
       for (Node* fn : finalize_node) {
-        Statement* stmt = fn->Compile(gsess_);
-        CHECK(stmt) << fn->debug_info();
-        batch_weight_update.push_back(stmt);
+        Statement* update_stmt = fn->Compile(gsess);
+        CHECK(update_stmt) << fn->debug_info();
+        batch_weight_update.push_back(update_stmt);
       }
     }
 
-    push_ctxt->SetGraphScheduler(gsess_->graph_scheduler());
-    push_arg_stmt = new ExprStatement(push_arg_op, push_ctxt);
-    stmt_ = new GraphGradStatement(node_grad_stmt, gsess_->graph_scheduler());
-    dynamic_cast<GraphGradStatement*>(stmt_)->SetGlobalContext(ctxt);
-    dynamic_cast<GraphGradStatement*>(stmt_)->SetPushArgStatement(push_arg_stmt);
+    push_ctxt->SetGraphScheduler(gsess->graph_scheduler());
+    push_arg_stmt = sess->arena()->New<ExprStatement>(push_arg_op, push_ctxt);
+    stmt = sess->arena()->New<GraphGradStatement>(node_grad_stmt, gsess->graph_scheduler());
+    dynamic_cast<GraphGradStatement*>(stmt)->SetGlobalContext(ctxt);
+    dynamic_cast<GraphGradStatement*>(stmt)->SetPushArgStatement(push_arg_stmt);
     if (pop_exist) {
-      pop_ctxt->SetGraphScheduler(gsess_->graph_scheduler());
-      pop_ret_stmt = new ExprStatement(pop_ret_op, pop_ctxt);
-      dynamic_cast<GraphGradStatement*>(stmt_)->SetPopRetStatement(pop_ret_stmt);
+      pop_ctxt->SetGraphScheduler(gsess->graph_scheduler());
+      pop_ret_stmt = sess->arena()->New<ExprStatement>(pop_ret_op, pop_ctxt);
+      dynamic_cast<GraphGradStatement*>(stmt)->SetPopRetStatement(pop_ret_stmt);
     }
     if (!batch_weight_update.empty())
-      dynamic_cast<GraphGradStatement*>(stmt_)->SetBatchWeightUpdate(std::move(batch_weight_update));
+      dynamic_cast<GraphGradStatement*>(stmt)->SetBatchWeightUpdate(std::move(batch_weight_update));
   }
-  return stmt_;
+  return stmt;
 }
 
 ScopedNode::ScopedNode(Scope* located,
       const string& name, int iter)
-    : Node(located), name_(name), iter_(iter), contained_(NULL) {}
+    : Node(located), name_(name), iter_(iter), contained_(NULL),
+      micro_batches_(1) {}
 
 void ScopedNode::SetContainedScope(const Scope* contained) {
   CHECK_NOTNULL(contained);
@@ -277,22 +312,49 @@ void ScopedNode::SetContainedScope(const Scope* contained) {
                 contained_->typological_sorted_nodes_.end());
 }
 
+void ScopedNode::SetMicroBatches(int micro_batches,
+    const vector<Node*>& first,
+    const vector<Node*>& rest,
+    const vector<Node*>& apply) {
+  CHECK(micro_batches > 1);
+  CHECK(first.size() == rest.size());
+  micro_batches_ = micro_batches;
+  first_.insert(first.begin(), first.end());
+  rest_.insert(rest.begin(), rest.end());
+  apply_.insert(apply.begin(), apply.end());
+}
+
 Statement* ScopedNode::Compile(
     SessionBase* sess) {
   CHECK_NOTNULL(contained_);
-  if (!stmt_) {
+  Statement*& stmt = sess->CompiledStatement(this);
+  if (!stmt) {
     VLOG(V_DEBUG) << "Compiling ScopeNode:\t"  << scoped_name();
     VLOG(V_DEBUG) << "It is located in scope " << scope()->scoped_name();
     VLOG(V_DEBUG) << "It contains a scope "    << contained_->scoped_name();
-    BasicBlock* bb = new BasicBlock(iter_);
+    BasicBlock* bb = sess->arena()->New<BasicBlock>(iter_);
+
+    //the accumulation and the update are compiled apart from the body,
+    //so that the fusion and the streams only see the body
+    std::list<Node*>* body = &nodes_;
+    std::list<Node*> body_nodes;
+    if (micro_batches_ > 1) {
+      for (auto* node : nodes_) {
+        if (!first_.count(node) && !rest_.count(node) && !apply_.count(node))
+          body_nodes.push_back(node);
+      }
+      body = &body_nodes;
+      bb = sess->arena()->New<BasicBlock>(1);
+    }
 
     if ((sess->opt_type() & OPT_FUSION) && sess->session_type() == SessionBase::GRAPH) {
       VLOG(V_DEBUG) << "Begin modifing the critical path for fusion in ScopedNode";
-      RTC::CodeGenerator generator(&nodes_);
+      GemmBatcher batcher(body);
+      RTC::CodeGenerator generator(body);
       VLOG(V_DEBUG) << "Modifing the critical path done for fusion in ScopedNode";
     }
 
-    for (auto* node : nodes_) {
+    for (auto* node : *body) {
       VLOG(V_DEBUG) << "\tCompiling\t" << node->name()
                     << "\t in Scope: " << contained_->scoped_name();
       Statement* stmt = node->Compile(sess);
@@ -306,13 +368,30 @@ Statement* ScopedNode::Compile(
         //StreamScheduler::DependencyExtractor(&dependency, nodes_);
       //}
       //CHECK(dependency.size() == nodes_.size());
-      StreamScheduler scheduler(&(bb->stmts_), nodes_);
+      StreamScheduler scheduler(&(bb->stmts_), *body);
       VLOG(V_DEBUG) << "Modifing the critical path done for streamming in ScopedNode";
     }
 
-    stmt_ = bb;
+    if (micro_batches_ > 1) {
+      //after the body, whose gradients they read
+      BasicBlock* first = sess->arena()->New<BasicBlock>(1);
+      BasicBlock* rest  = sess->arena()->New<BasicBlock>(1);
+      BasicBlock* apply = sess->arena()->New<BasicBlock>(1);
+      for (auto* node : nodes_) {
+        BasicBlock* part = first_.count(node) ? first :
+                           rest_.count(node)  ? rest  :
+                           apply_.count(node) ? apply : NULL;
+        if (part)
+          part->AppendStmt(node->Compile(sess));
+      }
+      BasicBlock* loop = sess->arena()->New<BasicBlock>(iter_);
+      loop->AppendStmt(sess->arena()->New<MicroBatchBlock>(
+            micro_batches_, bb, first, rest, apply));
+      bb = loop;
+    }
+    stmt = bb;
   }
-  return stmt_;
+  return stmt;
 }
 
 string ScopedNode::debug_info() const {
@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <set>
 #include <algorithm>
 
 namespace midend {
@@ -23,6 +24,7 @@ class GraphSession;
 
 class Node {
  public:
+  virtual ~Node() {}
   virtual Statement* Compile(SessionBase* sess) = 0;
   virtual bool IsSingleNode()  const { return false; }
   virtual bool IsScopedNode()  const { return false; }
@@ -47,18 +49,19 @@ class Node {
   virtual std::string debug_info() const;
 
  protected:
-  explicit Node(Scope* located);
+  //a node out of the ops of its scope replaces some others in a compiled
+  //list, and is owned by whoever makes it
+  explicit Node(Scope* located, bool in_scope = true);
   OpDef op_def_;
   std::vector<Edge*> inputs_;
   std::vector<Edge*> outputs_;
   std::vector<Edge*> control_dependency_;
   Scope* located_;
-  Statement* stmt_;
 };
 
 class SingleNode : public Node {
  public:
-  SingleNode(const OpDef& op_def, Scope* s);
+  SingleNode(const OpDef& op_def, Scope* s, bool in_scope = true);
   Statement* Compile(SessionBase* sess) override;
   void SetShape(const std::vector<TensorShapeDef>& def);
   void SetDynamicEnabled();
@@ -90,7 +93,6 @@ class SingleNode : public Node {
  protected:
   OpDef op_def_;
  private:
-  SessionBase* sess_debug_;
   bool isDynamicEnabled_;
 }; 
 
@@ -99,9 +101,6 @@ class GraphNode : public SingleNode {
   GraphNode(const OpDef& op_def, Scope* s);
   Statement* Compile(SessionBase* sess) override;
   //friend class GraphGradNode;
-
- private:
-  GraphSession* gsess_;
 }; 
 
 class GraphGradNode : public SingleNode {
@@ -112,8 +111,6 @@ class GraphGradNode : public SingleNode {
   //void SetGraphForwardNode(GraphNode* n) {
     //forward_node_ = n; 
   //}
- private:
-  GraphSession* gsess_;
 }; 
 
 //The ScopedNode is defined as a group of nodes
@@ -126,6 +123,13 @@ class ScopedNode : public Node {
  public:
   ScopedNode(Scope* located, const std::string& name, int iter);
   void SetContainedScope(const Scope* contained);
+  //the nodes copying(first micro-batch) or adding(the others) the
+  //gradients into the accumulators, and the ones applying them
+  //once every micro_batches runs
+  void SetMicroBatches(int micro_batches,
+      const std::vector<Node*>& first,
+      const std::vector<Node*>& rest,
+      const std::vector<Node*>& apply);
   Statement* Compile(SessionBase* sess) override;
   inline bool IsScopedNode() const override { return true; }
   inline std::string name() const override {
@@ -138,6 +142,10 @@ class ScopedNode : public Node {
   std::string name_;
   int iter_;
   const Scope* contained_;
+  int micro_batches_;
+  std::set<Node*> first_;
+  std::set<Node*> rest_;
+  std::set<Node*> apply_;
 };
 
 inline Edge* Node::input(int idx) const {
@@ -1,5 +1,6 @@
 #include "cavs/midend/op_context.h"
 
+#include <algorithm>
 #include <string>
 
 using std::string;
@@ -7,8 +8,10 @@ using std::unordered_map;
 
 namespace midend {
 
-unordered_map<string, void*> OpContext::repo_;
-int OpContext::dyn_dim_ = -1;
+ExecutionState* DefaultExecutionState() {
+  static ExecutionState state;
+  return &state;
+}
 
 void OpContext::SetTensorOffset() {
   if (gs_ && !gs_->Terminate()) {
@@ -17,7 +20,9 @@ void OpContext::SetTensorOffset() {
     //just choose the right offset of the input tensor buffer
     for (auto* t : inputs_) {
       //if (!(t->IsFullShape())) {
-      if (t->IsDynamicShape()) {
+      if (t->IsStashed()) {
+        VLOG(V_DEBUG) << t->name() << " is stashed, its offset is always 0";
+      }else if (t->IsDynamicShape()) {
         VLOG(V_DEBUG) << "Setting offset for " << t->name() << "\t" << gs_->GetCurrentRoundOffset();
         const_cast<Tensor*>(t)->SetOffsetWithId(gs_->GetCurrentRoundOffset());
       }else {
@@ -27,7 +32,9 @@ void OpContext::SetTensorOffset() {
     }
     for (auto* t : outputs_) {
       //if (!(t->IsFullShape())) {
-      if (t->IsDynamicShape()) {
+      if (t->IsStashed()) {
+        VLOG(V_DEBUG) << t->name() << " is stashed, its offset is always 0";
+      }else if (t->IsDynamicShape()) {
         VLOG(V_DEBUG) << "Setting offset for " << t->name() << "\t" << gs_->GetCurrentRoundOffset();
         VLOG(V_DEBUG) << t->debug_info();
         t->SetOffsetWithId(gs_->GetCurrentRoundOffset());
@@ -106,6 +113,59 @@ void OpContext::RecordMyEvent() {
   }
 }
 
+void OpContext::CompressActivations() {
+  if (!stash_on_write_.empty() && gs_ && !gs_->Terminate()) {
+    for (auto* s : stash_on_write_) {
+      VLOG(V_DEBUG) << "Compressing " << s->working()->name()
+                    << " at " << gs_->GetCurrentRoundOffset();
+      s->Compress(gs_->GetCurrentRoundOffset());
+    }
+  }
+}
+
+void OpContext::DecompressActivations() {
+  if (!stash_on_read_.empty() && gs_ && !gs_->Terminate()) {
+    for (auto* s : stash_on_read_) {
+      VLOG(V_DEBUG) << "Decompressing " << s->working()->name()
+                    << " at " << gs_->GetCurrentRoundOffset();
+      s->Decompress(gs_->GetCurrentRoundOffset());
+    }
+  }
+}
+
+void OpContext::BuildPlan() {
+  //the flags of the tensors and the streams are all settled
+  //when the whole graph has been compiled
+  auto append_once = [](std::vector<Tensor*, ArenaAllocator<Tensor*>>* v, Tensor* t) {
+    if (std::find(v->begin(), v->end(), t) == v->end())
+      v->push_back(t);
+  };
+  for (auto* in : inputs_) {
+    Tensor* t = const_cast<Tensor*>(in);
+    if (!t->IsDynamicShape()) continue;
+    if (gs_ && !t->IsStashed())
+      append_once(&offset_tensors_, t);
+    append_once(&scale_tensors_, t);
+  }
+  for (auto* t : outputs_) {
+    if (t->IsDynamicShape()) {
+      if (gs_ && !t->IsStashed())
+        append_once(&offset_tensors_, t);
+      append_once(&scale_tensors_, t);
+    }
+    if (t->ZeroInitEnforced())
+      append_once(&zero_tensors_, t);
+  }
+  wait_for_event_ = (stream_id_ > -1 && wait_for_event_id_ > -1);
+  record_event_   = (stream_id_ > -1 && event_record_id_ > -1);
+  has_stash_      = (gs_ && (!stash_on_write_.empty() || !stash_on_read_.empty()));
+  planned_ = true;
+  VLOG(V_DEBUG) << "Plan: " << offset_tensors_.size() << " offset, "
+                << scale_tensors_.size() << " scale, "
+                << zero_tensors_.size() << " zero-init tensors"
+                << (wait_for_event_ || record_event_ ? ", with events" : "");
+}
+
 string OpContext::debug_info() const {
   string info;
   for (unsigned i = 0; i < inputs_.size(); i++) {
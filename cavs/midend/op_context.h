@@ -3,24 +3,49 @@
 
 #include "cavs/midend/tensor.h"
 #include "cavs/midend/graph_scheduler.h"
+#include "cavs/midend/activation_stash.h"
+#include "cavs/midend/arena.h"
 #include "cavs/proto/op_def.pb.h"
 #include "cavs/util/stream_event_handle_pool.h"
+#include "cavs/util/thread_pool.h"
 
 #include <unordered_map>
 #include <string>
 
 namespace midend {
 
+//what changes from one run to the next, one for each session
+//so that the sessions can run at the same time
+struct ExecutionState {
+  ExecutionState() : round(0), dyn_dim(-1) {}
+  int round;
+  //the first dimension of the dynamic tensors
+  int dyn_dim;
+  //for the kernels passing data from the forward to the backward
+  std::unordered_map<std::string, void*> repo;
+};
+
+//for the contexts built out of a session
+ExecutionState* DefaultExecutionState();
+
 class OpContext {
  public:
-  OpContext() : round_(0), gs_(NULL),
-    stream_id_(-1), event_record_id_(-1), wait_for_event_id_(-1) {}
+  //the tensor arrays are kept in the arena next to the context
+  explicit OpContext(Arena* arena = NULL, ExecutionState* state = NULL)
+    : arena_(arena), state_(state ? state : DefaultExecutionState()),
+    inputs_(ArenaAllocator<const Tensor*>(arena)),
+    outputs_(ArenaAllocator<Tensor*>(arena)), round_(0), gs_(NULL),
+    stream_id_(-1), event_record_id_(-1), wait_for_event_id_(-1),
+    planned_(false), offset_tensors_(ArenaAllocator<Tensor*>(arena)),
+    scale_tensors_(ArenaAllocator<Tensor*>(arena)),
+    zero_tensors_(ArenaAllocator<Tensor*>(arena)), counters_(NULL) {}
   inline const Tensor& Input(int idx) const;
   inline Tensor* Output(int idx);
   inline int InputSize() const;
   inline int OutputSize() const;
   inline void AppendInput(const Tensor* t);
   inline void AppendOutput(Tensor* t);
+  inline void Reserve(int inputs, int outputs);
   inline OpContext* ExtractContext(const std::vector<int>& inp, const std::vector<int>& out);
   inline void SetStreamId(int id) { stream_id_ = id; }
   inline int GetStreamID() const { return stream_id_; }
@@ -35,7 +60,26 @@ class OpContext {
     gs_ = gs;
   }
   inline GraphSchedulerBase* graph_scheduler() { return gs_; }
-  inline static void SetDynDim(int dyn_dim) { dyn_dim_ = dyn_dim; }
+  inline void SetDynDim(int dyn_dim) { state_->dyn_dim = dyn_dim; }
+  inline std::unordered_map<std::string, void*>& repo() { return state_->repo; }
+  inline ExecutionState* execution_state() const { return state_; }
+  inline void AppendStashOnWrite(ActivationStash* s) { stash_on_write_.push_back(s); }
+  inline void AppendStashOnRead(ActivationStash* s)  { stash_on_read_.push_back(s);  }
+  //for the cpu kernels, on the threads shared with the other statements
+  inline void SetKernelName(const std::string& name) {
+    counters_ = ThreadPool::Counters(name);
+  }
+  inline void ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                          const std::function<void(int64_t, int64_t)>& fn) const {
+    ThreadPool::Get()->ParallelFor(begin, end, grain, fn, counters_);
+  }
+  //the grain is chosen by the cost of each unit, in nanoseconds
+  inline void ParallelFor(int64_t total, double cost_per_unit,
+                          const std::function<void(int64_t, int64_t)>& fn) const {
+    ThreadPool* pool = ThreadPool::Get();
+    pool->ParallelFor(0, total,
+        ThreadPool::GrainSize(total, cost_per_unit, pool->NumThreads()), fn, counters_);
+  }
 
   void SetTensorOffset();
   void ResetTensorOffset();
@@ -44,21 +88,41 @@ class OpContext {
   void SetZero();
   void WaitForEvent();
   void RecordMyEvent();
+  void CompressActivations();
+  void DecompressActivations();
+  //the per-round work around Compute, restricted to the tensors
+  //and the events that need it when the statement runs the first time
+  inline void PrepareRun();
+  inline void FinishRun();
 
   std::string debug_info() const;
-  static std::unordered_map<std::string, void*> repo_;
 
  private:
-  inline static int dyn_dim() { return dyn_dim_; }
-  std::vector<const Tensor*> inputs_;
-  std::vector<Tensor*> outputs_;
+  inline int dyn_dim() const { return state_->dyn_dim; }
+  void BuildPlan();
+  Arena* arena_;
+  ExecutionState* state_;
+  std::vector<const Tensor*, ArenaAllocator<const Tensor*>> inputs_;
+  std::vector<Tensor*, ArenaAllocator<Tensor*>> outputs_;
   int stream_id_;
   int event_record_id_;
   int wait_for_event_id_;
   std::vector<int> inputs_event_ids_;
+  std::vector<ActivationStash*> stash_on_write_;
+  std::vector<ActivationStash*> stash_on_read_;
   int round_;
   GraphSchedulerBase* gs_;
-  static int dyn_dim_;
+
+  bool planned_;
+  //dynamic tensors whose offset is moved in each round of the graph
+  std::vector<Tensor*, ArenaAllocator<Tensor*>> offset_tensors_;
+  //dynamic tensors whose first dimension follows dyn_dim
+  std::vector<Tensor*, ArenaAllocator<Tensor*>> scale_tensors_;
+  std::vector<Tensor*, ArenaAllocator<Tensor*>> zero_tensors_;
+  bool wait_for_event_;
+  bool record_event_;
+  bool has_stash_;
+  ThreadPool::KernelCounters* counters_;
 };
 
 inline const Tensor& OpContext::Input(int idx) const {
@@ -88,8 +152,43 @@ inline void OpContext::AppendOutput(Tensor* t) {
   outputs_.push_back(t); 
 }
 
+inline void OpContext::Reserve(int inputs, int outputs) {
+  inputs_.reserve(inputs);
+  outputs_.reserve(outputs);
+}
+
+inline void OpContext::PrepareRun() {
+  if (!planned_)
+    BuildPlan();
+  round_ = state_->round;
+  if (!offset_tensors_.empty() && !gs_->Terminate()) {
+    int offset = gs_->GetCurrentRoundOffset();
+    for (auto* t : offset_tensors_)
+      t->SetOffsetWithId(offset);
+  }
+  for (auto* t : scale_tensors_) {
+    if (t->dims(0) != dyn_dim())
+      t->ScaleDynamicDimension(dyn_dim());
+  }
+  for (auto* t : zero_tensors_)
+    t->InitWithZero(round_);
+  if (wait_for_event_)
+    WaitForEvent();
+  if (has_stash_)
+    DecompressActivations();
+}
+
+inline void OpContext::FinishRun() {
+  if (has_stash_)
+    CompressActivations();
+  if (record_event_)
+    RecordMyEvent();
+}
+
 inline OpContext* OpContext::ExtractContext(const std::vector<int>& inp, const std::vector<int>& out) {
-  OpContext* ret = new OpContext();
+  OpContext* ret = arena_ ? arena_->New<OpContext>(arena_, state_)
+                          : new OpContext(NULL, state_);
+  ret->Reserve(inp.size(), out.size());
   for (int i : inp) {
     CHECK(i < InputSize());
     ret->AppendInput(inputs_[i]);
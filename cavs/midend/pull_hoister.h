@@ -0,0 +1,82 @@
+#ifndef CAVS_MIDEND_PULL_HOISTER_H_
+#define CAVS_MIDEND_PULL_HOISTER_H_
+
+#include "cavs/midend/node.h"
+#include "cavs/midend/edge.h"
+#include "cavs/util/op_util.h"
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace midend {
+
+//The forward counterpart of the BatchingWeightUpdater.
+//The ops of the vertex function depending only on the pulled vertices
+//(and the weights), like the embedding lookup of the input word and its
+//projection, are moved out of the rounds. They run once before the rounds
+//on the vertices of all the rounds, in the order of the rounds, so each
+//round reads its rows of their outputs at its own offset.
+class PullHoister {
+ public:
+  PullHoister(std::list<Node*>* nodes, std::list<Node*>* hoisted_node) {
+    CHECK(hoisted_node->empty());
+    bool has_pull = false;
+    for (auto* n : *nodes)
+      has_pull |= (n->name() == "Pull");
+    if (!has_pull)
+      return;
+
+    std::unordered_set<const Edge*> hoisted_edges;
+    for (auto iter = nodes->begin(); iter != nodes->end(); ) {
+      if (isHoistable(*iter, hoisted_edges)) {
+        for (Edge* e : (*iter)->output())
+          hoisted_edges.insert(e);
+        VLOG(V_DEBUG) << "Hoisting " << (*iter)->debug_info();
+        hoisted_node->push_back(*iter);
+        nodes->erase(iter++);
+      }else {
+        iter++;
+      }
+    }
+  }
+
+ private:
+  //the ops computing each row from the same row of their dynamic inputs
+  static bool isRowwise(Node* node) {
+    static std::vector<std::string> rowwise_ops =
+      {"Add", "Minus", "Mul", "Tanh", "Sigmoid", "Relu",
+       "EmbeddingLookup", "MatMul", "Mirror", "Reshape", "Slice"};
+    return node->IsSingleNode() &&
+           std::find(rowwise_ops.begin(), rowwise_ops.end(), node->name())
+           != rowwise_ops.end();
+  }
+
+  static bool isHoistable(Node* node, const std::unordered_set<const Edge*>& hoisted_edges) {
+    if (node->name() == "Pull")
+      return true;
+    if (!isRowwise(node))
+      return false;
+    //the weights are read as they are, the rows of the round are not ready
+    for (Edge* e : node->input()) {
+      if (!hoisted_edges.count(e) &&
+          (e->IsDynamicEnabled() || e->scope() == node->scope()))
+        return false;
+    }
+    if (node->name() == "MatMul") {
+      //the rows of the product are the rows of its first input
+      const std::vector<int>& trans =
+        GetListArg<int>(dynamic_cast<SingleNode*>(node)->op_def(), "Transpose");
+      if (std::find(trans.begin(), trans.end(), 0) != trans.end() ||
+          node->input(1)->IsDynamicEnabled())
+        return false;
+    }
+    return true;
+  }
+};
+
+} //namespace midend
+
+#endif
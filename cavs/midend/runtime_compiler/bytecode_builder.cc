@@ -0,0 +1,92 @@
+#include "cavs/midend/runtime_compiler/bytecode_builder.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+
+using std::list;
+using std::string;
+using std::unordered_map;
+using std::vector;
+using namespace ::backend::RTC;
+
+namespace midend {
+namespace RTC {
+
+BytecodeBuilder::BytecodeBuilder(const list<Edge*>& in_edges,
+    const list<Edge*>& out_edges)
+    : out_edges_(out_edges), num_registers_(0) {
+  int i = 0;
+  for (auto* e : in_edges) {
+    CHECK(e->dtype() == DT_FLOAT) << e->name();
+    Emit(BC_LOAD_INPUT, NewRegister(e->name()), i++);
+  }
+}
+
+int BytecodeBuilder::Register(const string& edge) {
+  CHECK(registers_.find(edge) != registers_.end()) << edge;
+  return registers_.at(edge);
+}
+
+int BytecodeBuilder::NewRegister(const string& edge) {
+  CHECK(registers_.find(edge) == registers_.end()) << edge;
+  return registers_[edge] = num_registers_++;
+}
+
+void BytecodeBuilder::Emit(BytecodeOp op, int dst, int a, int b) {
+  code_.insert(code_.end(), {(int)op, dst, a, b});
+}
+
+BytecodeBuilder& BytecodeBuilder::AddNode(Node* node) {
+  static unordered_map<string, BytecodeOp> bin_ops =
+    {{"Add", BC_ADD}, {"Minus", BC_SUB}, {"Mul", BC_MUL},
+     {"Tanh_grad", BC_TANH_GRAD}, {"Sigmoid_grad", BC_SIGMOID_GRAD}};
+  static unordered_map<string, BytecodeOp> u_ops =
+    {{"Tanh", BC_TANH}, {"Sigmoid", BC_SIGMOID}, {"Relu", BC_RELU},
+     {"Assign", BC_COPY}, {"Mirror", BC_COPY}, {"Accumulate", BC_ACCUMULATE}};
+  CHECK(node->IsSingleNode());
+  CHECK(node->output_size() == 1);
+  const string& out = node->output(0)->name();
+  if (node->IsStatefulOp()) {
+    //as the generated kernels, the first update starts from the output
+    //if it leaves the group, or from zero
+    if (registers_.find(out) == registers_.end()) {
+      auto iter = std::find(out_edges_.begin(), out_edges_.end(), node->output(0));
+      if (iter != out_edges_.end()) {
+        int ori = num_registers_++;
+        original_[out] = ori;
+        Emit(BC_LOAD_OUTPUT, ori, std::distance(out_edges_.begin(), iter));
+        Emit(BC_COPY, NewRegister(out), ori);
+      }else {
+        Emit(BC_ZERO, NewRegister(out));
+      }
+    }
+  }
+  if (bin_ops.find(node->name()) != bin_ops.end()) {
+    CHECK(node->input_size() >= 2);
+    int a = Register(node->input(0)->name());
+    int b = Register(node->input(1)->name());
+    Emit(bin_ops.at(node->name()), NewRegister(out), a, b);
+  }else if (u_ops.find(node->name()) != u_ops.end()) {
+    CHECK(node->input_size() == 1);
+    int a = Register(node->input(0)->name());
+    int dst = node->IsStatefulOp() ? Register(out) : NewRegister(out);
+    Emit(u_ops.at(node->name()), dst, a);
+  }else {
+    LOG(FATAL) << "Wrong node " << node->name();
+  }
+  return *this;
+}
+
+void BytecodeBuilder::Finalize(vector<int>* code, int* num_registers) {
+  int i = 0;
+  for (auto* e : out_edges_) {
+    auto iter = original_.find(e->name());
+    Emit(BC_STORE, i++, Register(e->name()),
+         iter == original_.end() ? -1 : iter->second);
+  }
+  *code = code_;
+  *num_registers = num_registers_;
+}
+
+} //namespace RTC
+} //namespace midend
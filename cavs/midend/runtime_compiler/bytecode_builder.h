@@ -0,0 +1,40 @@
+#ifndef CAVS_MIDEND_RUNTIME_COMPILER_BYTECODE_BUILDER_H_
+#define CAVS_MIDEND_RUNTIME_COMPILER_BYTECODE_BUILDER_H_
+
+#include "cavs/midend/node.h"
+#include "cavs/backend/fused_bytecode.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace midend {
+namespace RTC {
+
+//Translates a fused group into the bytecode of the host interpreter,
+//the same expressions as the statement builders, one register per edge
+class BytecodeBuilder {
+ public:
+  BytecodeBuilder(const std::list<Edge*>& in_edges,
+                  const std::list<Edge*>& out_edges);
+  BytecodeBuilder& AddNode(Node* node);
+  //stores the outputs
+  void Finalize(std::vector<int>* code, int* num_registers);
+
+ private:
+  int Register(const std::string& edge);
+  int NewRegister(const std::string& edge);
+  void Emit(::backend::RTC::BytecodeOp op, int dst, int a = -1, int b = -1);
+  std::list<Edge*> out_edges_;
+  std::unordered_map<std::string, int> registers_;
+  //the value of a stateful output before the group
+  std::unordered_map<std::string, int> original_;
+  int num_registers_;
+  std::vector<int> code_;
+};
+
+} //namespace RTC
+} //namespace midend
+
+#endif
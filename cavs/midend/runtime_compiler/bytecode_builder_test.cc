@@ -0,0 +1,77 @@
+#include "cavs/midend/runtime_compiler/bytecode_builder.h"
+#include "cavs/midend/scope.h"
+#include "cavs/backend/fused_bytecode.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_def_builder.h"
+
+#include <cmath>
+#include <list>
+#include <vector>
+
+using namespace std;
+using namespace midend;
+using ::backend::RTC::BytecodeInterpreter;
+
+//the rows are longer than a tile of the interpreter
+const int R = 7, C = 300;
+
+Node* AddNode(const string& op, const vector<string>& inputs,
+              const string& output, const vector<int>& shape) {
+  OpDefBuilder builder(op);
+  for (auto& i : inputs)
+    builder.Input(i);
+  OpDef def;
+  builder.Output(output).Shape(shape).Dtype(DT_FLOAT).Device("CPU").Finalize(&def);
+  Node* node = main_scope()->AddOp(def);
+  node->output(0)->SetShape(def.shape(0));
+  return node;
+}
+
+int main() {
+  //s = a + b(broadcast), t = tanh(s), m = t * a, g += m(reduced to a row)
+  AddNode("Placeholder", {}, "a", {R, C});
+  AddNode("Placeholder", {}, "b", {C});
+  list<Node*> group = {AddNode("Add", {"a", "b"}, "s", {R, C}),
+                       AddNode("Tanh", {"s"}, "t", {R, C}),
+                       AddNode("Mul", {"t", "a"}, "m", {R, C}),
+                       AddNode("Accumulate", {"m"}, "g", {C})};
+  list<Edge*> in_edges = {main_scope()->FindEdge("a"), main_scope()->FindEdge("b")};
+  list<Edge*> out_edges = {main_scope()->FindEdge("m"), main_scope()->FindEdge("g")};
+  RTC::BytecodeBuilder builder(in_edges, out_edges);
+  for (auto* n : group)
+    builder.AddNode(n);
+  vector<int> code;
+  int num_registers;
+  builder.Finalize(&code, &num_registers);
+
+  vector<float> a(R*C), b(C);
+  for (int i = 0; i < R*C; i++) a[i] = 0.01f * (i % 97) - 0.3f;
+  for (int i = 0; i < C; i++)   b[i] = 0.2f - 0.001f * i;
+  vector<float> m_ref(R*C), g_ref(C, 1.f);
+  for (int r = 0; r < R; r++) {
+    for (int c = 0; c < C; c++) {
+      m_ref[r*C+c] = tanh(a[r*C+c] + b[c]) * a[r*C+c];
+      g_ref[c] += m_ref[r*C+c];
+    }
+  }
+
+  BytecodeInterpreter interpreter;
+  interpreter.Load(code, num_registers);
+  //the shards of the columns, as the op runs a reduced group
+  vector<float> m(R*C, 0), g(C, 1.f);
+  vector<void*> outputs = {m.data(), g.data()};
+  vector<const void*> inputs = {a.data(), b.data()};
+  vector<int> outputs_size = {R*C, C};
+  vector<int> inputs_size = {R*C, C};
+  for (int col = 0; col < C; col += 128) {
+    interpreter.Run(outputs, inputs, outputs_size, inputs_size,
+                    R*C, C, 0, R, col, min(col+128, C));
+  }
+  for (int i = 0; i < R*C; i++)
+    CHECK(fabs(m[i] - m_ref[i]) < 1e-5) << i << ": " << m[i] << " vs " << m_ref[i];
+  for (int i = 0; i < C; i++)
+    CHECK(fabs(g[i] - g_ref[i]) < 1e-4) << i << ": " << g[i] << " vs " << g_ref[i];
+  LOG(INFO) << "Bytecode of " << code.size()/BytecodeInterpreter::kInstrLength
+            << " instructions and " << num_registers << " registers passed";
+  return 0;
+}
@@ -1,6 +1,8 @@
 #include "cavs/midend/runtime_compiler/code_generator.h"
 #include "cavs/midend/runtime_compiler/statement_builder.h"
+#include "cavs/midend/runtime_compiler/bytecode_builder.h"
 #include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
 #include "cavs/proto/types.pb.h"
 
 using std::string;
@@ -12,13 +14,15 @@ using std::set;
 namespace midend {
 namespace RTC {
 
-string GenKernelName() {
-  static int kernel_id = 0;
-  return "FusedKernel_" + std::to_string(kernel_id++);
+//the same kernels are named the same in every run,
+//so that they are found in the kernel cache
+string GenKernelName(const string& source) {
+  return "FusedKernel_" + HashToString(GetStableHash(source));
 }
 
 string GenKernelDeclaration(const string& kernel_name,
-                            const list<Edge*>& inputs, const list<Edge*>& outputs) {
+                            const list<Edge*>& inputs, const list<Edge*>& outputs,
+                            const list<Edge*>& indexed) {
   string source = "extern \"C\" __global__ void ";
 
   source += kernel_name;
@@ -43,34 +47,130 @@ string GenKernelDeclaration(const string& kernel_name,
     input_count += "const int " + CodeGenerator::arrSize(e->name()) + ", ";
   }
   string total_count;
-  total_count = "const int n_elements)\n";
+  total_count = "const int n_elements, const int n_cols";
+  //the partial sums of the blocks of the reduced outputs,
+  //and the blocks arrived of each column of the grid
+  total_count += ", float *partials, unsigned int *arrived";
+  //the rows of the graph ops, by the ids of the scheduler
+  string index_args;
+  for (auto* e : indexed) {
+    index_args += ", const int *" + CodeGenerator::arrIds(e->name());
+  }
+  for (auto* e : indexed) {
+    index_args += ", const int " + CodeGenerator::arrIdsSize(e->name());
+  }
+  for (auto* e : indexed) {
+    index_args += ", const int " + CodeGenerator::arrStride(e->name());
+  }
 
-  source += output_args + input_args + output_count + input_count + total_count;
+  source += output_args + input_args + output_count + input_count
+          + total_count + index_args + ")\n";
 
   return source;
 }
 
 namespace Ewise {
 
-string EwiseGenBodyThreadIndexing(const string& inner) {
-  string idx = "const int idx = blockIdx.x * blockDim.x + threadIdx.x;\n";
-  idx += "if (idx < n_elements) {\n";
+//The loop is a matrix of n_elements/n_cols rows and n_cols columns,
+//an input is indexed by its strides along them: the full-size ones by
+//(n_cols, 1), the row vectors of n_cols elements by (0, 1) and the scalars
+//by (0, 0). The other sizes are broadcast by the modulo of their size.
+string EwiseGenBodyStrides(const list<Edge*>& edges) {
+  string decl;
+  for (auto* e : edges) {
+    const string count = CodeGenerator::arrSize(e->name());
+    decl += "const int " + CodeGenerator::arrRowStride(e->name()) + " = ("
+          + count + " == n_elements) ? n_cols : 0;\n";
+    decl += "const int " + CodeGenerator::arrColStride(e->name()) + " = ("
+          + count + " == 1) ? 0 : 1;\n";
+    decl += "const bool " + CodeGenerator::arrMod(e->name()) + " = ("
+          + count + " != 1 && " + count + " != n_cols && " + count + " != n_elements);\n";
+  }
+  return decl;
+}
+
+string ArrayRef(const Edge* e, bool bcast) {
+  if (!bcast)
+    return e->name() + "[idx]";
+  return "(" + CodeGenerator::arrMod(e->name()) + " ? "
+         + e->name() + "[idx%" + CodeGenerator::arrSize(e->name()) + "] : "
+         + e->name() + "[row*" + CodeGenerator::arrRowStride(e->name())
+         + " + col*" + CodeGenerator::arrColStride(e->name()) + "])";
+}
+
+//The threads of a column of blocks(x) run down its rows, each block
+//holds blockDim.y rows of the column and the grid gridDim.y of them.
+//The outputs of n_cols elements(smaller than the loop) are summed
+//in a register per thread and then over the threads of the column.
+string EwiseGenBodyThreadIndexing(const string& prologue, const string& inner,
+                                  const string& epilogue) {
+  string idx = "const int col = blockIdx.x * blockDim.x + threadIdx.x;\n";
+  idx += prologue;
+  idx += "if (col < n_cols) {\n";
+  idx += "for (int row = blockIdx.y * blockDim.y + threadIdx.y; row < n_elements/n_cols;"
+         " row += gridDim.y * blockDim.y) {\n";
+  idx += "const int idx = row * n_cols + col;\n";
   //idx += "printf(\"%f, %f, %f\\n\", Placeholder_0[idx], Placeholder_1[idx], Placeholder_2[idx]);\n";
   idx += inner;
-  idx += "\n}";
+  idx += "}\n";
+  idx += "}\n";
+  idx += epilogue;
 
   return idx;
 }
 
-string EwiseGenBodyGetInput(const list<Edge*>& inputs) {
+//The sum over the rows of a block of each column, in the threads of its
+//first row: the rows in a warp are added by the shuffles, then the warps
+//by the first one through the shared memory. The block is a power of two
+//columns up to 32, all the threads call it.
+//The partial sums of a column of blocks are added by the last block
+//finishing, which resets the counter for the next launch.
+string EwiseGenReduceFunctions() {
+  return
+    "__device__ float BlockColumnSum(float v) {\n"
+    "__shared__ float warp_sums[32][32];\n"
+    "const int tid = threadIdx.y * blockDim.x + threadIdx.x;\n"
+    "const int lane = tid % 32;\n"
+    "for (int offset = 16; offset >= blockDim.x; offset >>= 1)\n"
+    "v += __shfl_down_sync(0xffffffff, v, offset);\n"
+    "if (lane < blockDim.x) warp_sums[tid/32][lane] = v;\n"
+    "__syncthreads();\n"
+    "if (tid < 32) {\n"
+    "v = 0;\n"
+    "for (int w = lane / blockDim.x; w < blockDim.x * blockDim.y / 32; w += 32 / blockDim.x)\n"
+    "v += warp_sums[w][lane % blockDim.x];\n"
+    "for (int offset = 16; offset >= blockDim.x; offset >>= 1)\n"
+    "v += __shfl_down_sync(0xffffffff, v, offset);\n"
+    "}\n"
+    "__syncthreads();\n"
+    "return v;\n"
+    "}\n"
+    "__device__ float ColumnPartialSum(const float *partials, int slot, int col, int n_cols) {\n"
+    "float v = 0;\n"
+    "for (int b = threadIdx.y; col < n_cols && b < gridDim.y; b += blockDim.y)\n"
+    "v += ((volatile const float*)partials)[(slot * gridDim.y + b) * n_cols + col];\n"
+    "return v;\n"
+    "}\n"
+    "__device__ bool LastBlockOfColumn(unsigned int *arrived) {\n"
+    "__shared__ bool last;\n"
+    "__threadfence();\n"
+    "__syncthreads();\n"
+    "if (threadIdx.x == 0 && threadIdx.y == 0) {\n"
+    "last = (atomicAdd(&arrived[blockIdx.x], 1) == gridDim.y - 1);\n"
+    "if (last) arrived[blockIdx.x] = 0;\n"
+    "}\n"
+    "__syncthreads();\n"
+    "return last;\n"
+    "}\n";
+}
+
+string EwiseGenBodyGetInput(const list<Edge*>& inputs, bool bcast = true) {
   string var_decl;
   for (auto* e : inputs) {
     string type = CodeGenerator::typeToString(e->dtype());
     string var_name = CodeGenerator::PrefixedVar(e->name());
-    string array_ref_name = e->name() + "[idx%" + CodeGenerator::arrSize(e->name()) + "]";
+    string array_ref_name = ArrayRef(e, bcast);
     var_decl += type + " " + var_name + " = " + array_ref_name + ";\n";
-    //if (bcast)
-      //var_decl += type + " " + CodeGenerator::OriVar(e->name()) + " = " + var_name + ";\n";
   }
   return var_decl;
 }
@@ -83,25 +183,191 @@ string EwiseGenBodyGetInput(const string& name, float init) {
   return var_decl;
 }
 
-string EwiseGenBodyAssignOutput(const list<Edge*>& outputs) {
+//the value a stateful op updates, for the reduced outputs on the gpu
+//the sum of the updates of the rows of the thread
+string EwiseGenBodyGetOutput(const Edge* e, bool on_host, bool bcast) {
+  const string reduced_ref = on_host ? e->name() + "[col]"
+                                     : CodeGenerator::AccVar(e->name());
+  string ref = bcast ? "(" + CodeGenerator::arrSize(e->name()) + " < n_elements) ? "
+                       + reduced_ref + " : " + e->name() + "[idx]"
+                     : e->name() + "[idx]";
+  return CodeGenerator::typeToString(e->dtype()) + " "
+         + CodeGenerator::PrefixedVar(e->name()) + " = " + ref + ";\n";
+}
+
+//the updates of the rows a thread runs, the output is added to once
+string EwiseGenBodyReduceBegin(const list<Edge*>& accumulated) {
+  string acc_decl;
+  for (auto* e : accumulated) {
+    acc_decl += CodeGenerator::typeToString(e->dtype()) + " "
+              + CodeGenerator::AccVar(e->name()) + " = 0;\n";
+  }
+  return acc_decl;
+}
+
+//Each reduced output has a slot of gridDim.y partial rows, the blocks of a
+//single row of the grid add their sums to the output directly.
+string EwiseGenBodyReduceEnd(const list<Edge*>& accumulated) {
+  if (accumulated.empty())
+    return "";
+  string any_reduced;
+  string block_sums;
+  string partial_sums;
+  int slot = 0;
+  for (auto* e : accumulated) {
+    const string reduced = CodeGenerator::arrSize(e->name()) + " < n_elements";
+    const string k = std::to_string(slot++);
+    const string partial = "partials[(" + k + " * gridDim.y + blockIdx.y) * n_cols + col]";
+    any_reduced += (any_reduced.empty() ? "" : " || ") + reduced;
+    block_sums += "if (" + reduced + ") {\n"
+                + "const float sum = BlockColumnSum(" + CodeGenerator::AccVar(e->name()) + ");\n"
+                + "if (threadIdx.y == 0 && col < n_cols) {\n"
+                + "if (gridDim.y == 1) " + e->name() + "[col] += sum;\n"
+                + "else " + partial + " = sum;\n}\n}\n";
+    partial_sums += "if (" + reduced + ") {\n"
+                  + "const float sum = BlockColumnSum(ColumnPartialSum(partials, "
+                  + k + ", col, n_cols));\n"
+                  + "if (threadIdx.y == 0 && col < n_cols) " + e->name() + "[col] += sum;\n}\n";
+  }
+  return "if (" + any_reduced + ") {\n" + block_sums
+         + "if (gridDim.y > 1 && LastBlockOfColumn(arrived)) {\n" + partial_sums + "}\n"
+         + "}\n";
+}
+
+//the outputs of n_cols elements not updated are the same in every row
+string EwiseGenBodyAssignOutput(const list<Edge*>& outputs,
+                                const list<Edge*>& accumulated) {
   string array_assign;
   for (auto* e : outputs) {
-    string array_ref_name = e->name() + "[idx%" + CodeGenerator::arrSize(e->name()) + "]";
     string var_name = CodeGenerator::PrefixedVar(e->name());
-    string ori_var_name = CodeGenerator::OriVar(e->name());
-    string assignment = array_ref_name + " = " + var_name + ";\n";
-    string keep_ori_value = CodeGenerator::typeToString(e->dtype()) + " " + ori_var_name + " = " + array_ref_name + ";\n";
-    string atomic_assignment = "atomicAdd(&" + array_ref_name + ", (" + var_name + " - " + ori_var_name + "));\n";
-    string branch = "if (" + CodeGenerator::arrSize(e->name()) + " < n_elements) {\n"
-                  + keep_ori_value + atomic_assignment + "}else {\n" + assignment + "}\n";
-    array_assign += branch;
+    const bool acc = std::find(accumulated.begin(), accumulated.end(), e) != accumulated.end();
+    array_assign += "if (" + CodeGenerator::arrSize(e->name()) + " < n_elements) {\n"
+                  + (acc ? CodeGenerator::AccVar(e->name()) + " = " + var_name + ";\n"
+                         : "if (row == 0) " + e->name() + "[col] = " + var_name + ";\n")
+                  + "}else {\n" + e->name() + "[idx] = " + var_name + ";\n}\n";
+  }
+  return array_assign;
+}
+
+//The element idx is in the row idx/stride of the round,
+//which is the row ids[idx/stride] of the whole tensor.
+//The rows without an id are zero(gather) or not stored(scatter).
+string IndexedRef(const Edge* e) {
+  const string& stride = CodeGenerator::arrStride(e->name());
+  return e->name() + "[" + CodeGenerator::arrIds(e->name()) + "[idx/" + stride + "]*"
+         + stride + " + idx%" + stride + "]";
+}
+
+string IndexedRowCond(const Edge* e) {
+  return "idx/" + CodeGenerator::arrStride(e->name()) + " < "
+         + CodeGenerator::arrIdsSize(e->name());
+}
+
+string EwiseGenBodyIndexedLoad(const list<Edge*>& loads) {
+  string var_decl;
+  for (auto* e : loads) {
+    var_decl += CodeGenerator::typeToString(e->dtype()) + " "
+              + CodeGenerator::PrefixedVar(e->name()) + " = ("
+              + IndexedRowCond(e) + ") ? " + IndexedRef(e) + " : 0;\n";
+  }
+  return var_decl;
+}
+
+string EwiseGenBodyIndexedStore(const list<Edge*>& stores) {
+  string array_assign;
+  for (auto* e : stores) {
+    array_assign += "if (" + IndexedRowCond(e) + ") {\n"
+                  + IndexedRef(e) + " = " + CodeGenerator::PrefixedVar(e->name()) + ";\n"
+                  + "}\n";
   }
   return array_assign;
 }
 
 } //namespace Ewise
 
+namespace Host {
+
+//The host kernels are looked up with dlsym, so they have one signature,
+//the arrays and their sizes are unpacked at the beginning.
+//The kernel runs the block [row_begin, row_end) x [col_begin, col_end)
+//of the loop, one shard of the thread pool.
+string HostGenKernelDeclaration(const string& kernel_name) {
+  return "extern \"C\" void " + kernel_name +
+         "(void* const* outputs, const void* const* inputs,\n"
+         " const int* outputs_count, const int* inputs_count,\n"
+         " const int n_elements, const int n_cols,\n"
+         " const int row_begin, const int row_end, const int col_begin, const int col_end)\n";
+}
+
+string HostGenBodyUnpackArgs(const list<Edge*>& inputs, const list<Edge*>& outputs) {
+  string unpack;
+  int i = 0;
+  for (auto* e : outputs) {
+    string type = CodeGenerator::typeToString(e->dtype());
+    unpack += type + " *" + e->name() + " = (" + type + "*)outputs[" + std::to_string(i) + "];\n";
+    unpack += "const int " + CodeGenerator::arrSize(e->name())
+            + " = outputs_count[" + std::to_string(i++) + "];\n";
+  }
+  i = 0;
+  for (auto* e : inputs) {
+    string type = CodeGenerator::typeToString(e->dtype());
+    unpack += "const " + type + " *" + e->name() + " = (const " + type + "*)inputs["
+            + std::to_string(i) + "];\n";
+    unpack += "const int " + CodeGenerator::arrSize(e->name())
+            + " = inputs_count[" + std::to_string(i++) + "];\n";
+  }
+  return unpack;
+}
+
+//the outputs of n_cols elements are reduced into, the shard owns
+//their columns so no other thread writes them
+string HostGenBodyAssignOutput(const list<Edge*>& outputs, bool bcast) {
+  string array_assign;
+  for (auto* e : outputs) {
+    string var_name = CodeGenerator::PrefixedVar(e->name());
+    if (!bcast) {
+      array_assign += e->name() + "[idx] = " + var_name + ";\n";
+    }else {
+      array_assign += "if (" + CodeGenerator::arrSize(e->name()) + " < n_elements) {\n"
+                    + e->name() + "[col] = " + var_name + ";\n"
+                    + "}else {\n" + e->name() + "[idx] = " + var_name + ";\n}\n";
+    }
+  }
+  return array_assign;
+}
+
+//Without broadcasting, the arrays are indexed directly and the loop is
+//left to the host compiler to vectorize, otherwise by their strides.
+string HostGenBodyLoops(const string& dense_inner, const string& bcast_inner,
+                        const list<Edge*>& inputs, const list<Edge*>& outputs) {
+  string dense = "1";
+  for (auto* e : outputs)
+    dense += " && " + CodeGenerator::arrSize(e->name()) + " == n_elements";
+  for (auto* e : inputs)
+    dense += " && " + CodeGenerator::arrSize(e->name()) + " == n_elements";
+  const string loops =
+    "for (int row = row_begin; row < row_end; row++) {\n"
+    "for (int col = col_begin; col < col_end; col++) {\n"
+    "const int idx = row * n_cols + col;\n";
+  return "if (" + dense + ") {\n" + loops + dense_inner + "}\n}\n"
+         "}else {\n" + Ewise::EwiseGenBodyStrides(inputs) + loops + bcast_inner + "}\n}\n"
+         "}\n";
+}
+
+} //namespace Host
+
 CodeGenerator::CodeGenerator(list<Node*>* n) : parser_(n) {
+  Generate(NULL);
+}
+
+CodeGenerator::CodeGenerator(list<Node*>* n, const vector<const Edge*>& fetched,
+                             SessionBase* sess)
+    : parser_(n, &fetched) {
+  CHECK_NOTNULL(sess);
+  Generate(sess);
+}
+
+void CodeGenerator::Generate(SessionBase* owner) {
   int groups = parser_.GenerateGroup();
   list<Edge*> in_edges;
   list<Edge*> out_edges;
@@ -110,65 +376,219 @@ CodeGenerator::CodeGenerator(list<Node*>* n) : parser_(n) {
   VLOG(V_DEBUG) << groups << " Groups Found";
   for (int i = 0; i < groups; i++) {
     parser_.FuseGroup(i, &nodes, &in_edges, &out_edges);
-    string name = GenKernelName();
-    string source = GenKernelDeclaration(name, in_edges, out_edges);
-    string func_body = Ewise::EwiseGenBodyGetInput(in_edges);
-    vector<string> stateful_output;
-    //bool batch_enable = false;
+    //the group is on the device of its nodes
+    const OpDef& front_def = dynamic_cast<SingleNode*>(nodes.front())->op_def();
+    const bool on_host = (front_def.device() == CPU);
+    //the gathered(pulled) rows are loaded in the kernel and never written,
+    //the scattered rows are stored into the message passer directly
+    list<Edge*> loads;
+    list<Edge*> stores;
+    vector<string> load_names;
+    vector<int> load_child;
+    vector<int> load_stride;
+    vector<string> store_names;
+    vector<int> store_child;
+    string pushed_output;
     for (auto* n : nodes) {
-      CHECK(n->IsSingleNode());
-      //if (dynamic_cast<SingleNode*>(n)->IsBatchEnabled())
-        //batch_enable = true;
-      VLOG(V_DEBUG) << dynamic_cast<SingleNode*>(n)->op_def().DebugString();
-      if (n->IsStatefulOp() &&
-          std::find(stateful_output.begin(), stateful_output.end(), n->output(0)->name())
-            == stateful_output.end()) {
-        CHECK(n->output_size() == 1);
-        stateful_output.push_back(n->output(0)->name());
-        if (std::find(out_edges.begin(), out_edges.end(), n->output(0)) !=
-            out_edges.end()) {
-          func_body += Ewise::EwiseGenBodyGetInput({n->output(0)});
-        }else {
-          func_body += Ewise::EwiseGenBodyGetInput(n->output(0)->name(), 0.f);
+      const OpDef& def = dynamic_cast<SingleNode*>(n)->op_def();
+      if (isGraphLoad(n->name())) {
+        //one row per job, of the shape defined in the op
+        CHECK(def.shape_size() == 1);
+        int stride = 1;
+        for (int d : def.shape(0).dim())
+          stride *= d;
+        loads.push_back(n->output(0));
+        load_names.push_back(n->output(0)->name());
+        load_child.push_back(n->name() == "Gather" ? GetSingleArg<int>(def, "Child") : -1);
+        load_stride.push_back(stride);
+      }else if (n->name() == "Scatter") {
+        stores.push_back(n->output(0));
+        store_names.push_back(n->output(0)->name());
+        store_child.push_back(GetSingleArg<int>(def, "Child"));
+      }else if (n->name() == "Push") {
+        CHECK(pushed_output.empty());
+        pushed_output = n->output(0)->name();
+      }
+    }
+    //the gemm heading the group computes the rows the kernel reads,
+    //its operands are the first inputs of the fused node
+    Node* gemm = NULL;
+    for (auto* n : nodes) {
+      if (n->name() == "MatMul") {
+        CHECK(on_host && !gemm);
+        gemm = n;
+      }
+    }
+    list<Edge*> dense_in_edges;
+    list<Edge*> node_in_edges;
+    if (gemm) {
+      dense_in_edges.push_back(gemm->output(0));
+      node_in_edges.push_back(gemm->input(0));
+      node_in_edges.push_back(gemm->input(1));
+    }
+    for (auto* e : in_edges) {
+      bool read_by_kernel = !gemm;
+      for (auto* n : nodes) {
+        if (n != gemm && std::find(n->input().begin(), n->input().end(), e) != n->input().end())
+          read_by_kernel = true;
+      }
+      if (read_by_kernel) {
+        dense_in_edges.push_back(e);
+        node_in_edges.push_back(e);
+      }
+    }
+    //the gemm output read out of the group is written by the gemm
+    const bool gemm_output = gemm &&
+      std::find(out_edges.begin(), out_edges.end(), gemm->output(0)) != out_edges.end();
+    list<Edge*> kernel_out_edges;
+    list<Edge*> dense_out_edges;
+    for (auto* e : out_edges) {
+      if (gemm && e == gemm->output(0))
+        continue;
+      kernel_out_edges.push_back(e);
+      if (std::find(stores.begin(), stores.end(), e) == stores.end())
+        dense_out_edges.push_back(e);
+    }
+    list<Edge*> node_out_edges = kernel_out_edges;
+    if (gemm_output)
+      node_out_edges.push_back(gemm->output(0));
+    list<Edge*> kernel_in_edges = dense_in_edges;
+    kernel_in_edges.insert(kernel_in_edges.end(), loads.begin(), loads.end());
+    list<Edge*> indexed = loads;
+    indexed.insert(indexed.end(), stores.begin(), stores.end());
+
+    //the outputs updated by the stateful ops, summed over the rows
+    //when they are smaller than the loop
+    list<Edge*> accumulated;
+    for (auto* e : dense_out_edges) {
+      for (auto* n : nodes) {
+        if (n->IsStatefulOp() && n->output(0) == e &&
+            std::find(accumulated.begin(), accumulated.end(), e) == accumulated.end())
+          accumulated.push_back(e);
+      }
+    }
+    vector<string> stateful_output;
+    auto gen_body = [&](bool bcast) {
+      string func_body = Ewise::EwiseGenBodyGetInput(dense_in_edges, bcast)
+                       + Ewise::EwiseGenBodyIndexedLoad(loads);
+      stateful_output.clear();
+      //bool batch_enable = false;
+      for (auto* n : nodes) {
+        CHECK(n->IsSingleNode());
+        CHECK(dynamic_cast<SingleNode*>(n)->op_def().device() == front_def.device());
+        if (isGraphLoad(n->name()) || n == gemm)
+          continue;
+        //if (dynamic_cast<SingleNode*>(n)->IsBatchEnabled())
+          //batch_enable = true;
+        VLOG(V_DEBUG) << dynamic_cast<SingleNode*>(n)->op_def().DebugString();
+        if (n->IsStatefulOp() &&
+            std::find(stateful_output.begin(), stateful_output.end(), n->output(0)->name())
+              == stateful_output.end()) {
+          CHECK(n->output_size() == 1);
+          stateful_output.push_back(n->output(0)->name());
+          if (std::find(accumulated.begin(), accumulated.end(), n->output(0)) !=
+              accumulated.end()) {
+            func_body += Ewise::EwiseGenBodyGetOutput(n->output(0), on_host, bcast);
+          }else {
+            func_body += Ewise::EwiseGenBodyGetInput(n->output(0)->name(), 0.f);
+          }
         }
+        if (!n->IsStatefulOp())
+          func_body +=  VarDeclStatementBuilder().SetNode(n).toCode();
+        else
+          func_body +=  AssignStatementBuilder().SetNode(n).toCode();
+      }
+      return func_body;
+    };
+    auto gen_source = [&](const string& name) {
+      if (on_host) {
+        return "#include <math.h>\n" + Host::HostGenKernelDeclaration(name)
+               + "{\n" + Host::HostGenBodyUnpackArgs(dense_in_edges, dense_out_edges)
+               + Host::HostGenBodyLoops(
+                   gen_body(false) + Host::HostGenBodyAssignOutput(dense_out_edges, false),
+                   gen_body(true)  + Host::HostGenBodyAssignOutput(dense_out_edges, true),
+                   dense_in_edges, dense_out_edges)
+               + "}\n";
+      }else {
+        string func_body = gen_body(true);
+        func_body += Ewise::EwiseGenBodyAssignOutput(dense_out_edges, accumulated)
+                   + Ewise::EwiseGenBodyIndexedStore(stores);
+        return (accumulated.empty() ? "" : Ewise::EwiseGenReduceFunctions())
+               + GenKernelDeclaration(name, kernel_in_edges, kernel_out_edges, indexed)
+               + "{\n" + Ewise::EwiseGenBodyThreadIndexing(
+                   Ewise::EwiseGenBodyStrides(dense_in_edges)
+                     + Ewise::EwiseGenBodyReduceBegin(accumulated),
+                   func_body, Ewise::EwiseGenBodyReduceEnd(accumulated))
+               + "}\n";
+      }
+    };
+    //named by the hash of the kernel without its name
+    const string name = GenKernelName(gen_source("FusedKernel"));
+    const string source = gen_source(name);
+    //the interpreted form, for the hosts without a compiler
+    vector<int> bytecode;
+    int num_registers = 0;
+    if (on_host) {
+      BytecodeBuilder builder(dense_in_edges, dense_out_edges);
+      for (auto* n : nodes) {
+        if (n != gemm)
+          builder.AddNode(n);
       }
-      if (!n->IsStatefulOp())
-        func_body +=  VarDeclStatementBuilder().SetNode(n).toCode();
-      else
-        func_body +=  AssignStatementBuilder().SetNode(n).toCode();
+      builder.Finalize(&bytecode, &num_registers);
     }
-    func_body += Ewise::EwiseGenBodyAssignOutput(out_edges);
-    source += "{\n" + Ewise::EwiseGenBodyThreadIndexing(func_body) + "}\n";
 
     {
       vector<string> output_names;
       vector<string> input_names;
       vector<TensorShapeDef> output_shapes;
-      for (auto* e : out_edges) {
+      for (auto* e : node_out_edges) {
         output_names.push_back(e->name()); 
         output_shapes.push_back(e->shape());
       }
-      for (auto* e : in_edges) {
+      for (auto* e : node_in_edges) {
         input_names.push_back(e->name()); 
       }
 
       OpDef op_def;
-      OpDefBuilder("FusedKernel")
-        .Output(output_names)
+      OpDefBuilder builder("FusedKernel");
+      builder.Output(output_names)
         .Input(input_names)
         .Shape(output_shapes)
         .AttrSingle("KernelName", name)
         .AttrSingle("KernelSource", source)
         .AttrList<string>("ZeroEnforced", stateful_output)
-        .Device("GPU")
-        .Finalize(&op_def);
-      SingleNode* new_node = new SingleNode(op_def, nodes.front()->scope());
+        .Device(front_def);
+      if (on_host) {
+        builder.AttrList<int>("KernelBytecode", bytecode)
+          .AttrSingle("KernelRegisters", num_registers);
+      }
+      if (!loads.empty()) {
+        builder.AttrList<string>("IndexedLoads", load_names)
+          .AttrList<int>("IndexedLoadChild", load_child)
+          .AttrList<int>("IndexedLoadStride", load_stride);
+      }
+      if (!stores.empty()) {
+        builder.AttrList<string>("IndexedStores", store_names)
+          .AttrList<int>("IndexedStoreChild", store_child);
+      }
+      if (!pushed_output.empty())
+        builder.AttrSingle("PushedOutput", pushed_output);
+      if (gemm) {
+        const OpDef& gemm_def = dynamic_cast<SingleNode*>(gemm)->op_def();
+        builder.AttrSingle("Gemm", true)
+          .AttrList<int>("GemmTranspose", GetListArg<int>(gemm_def, "Transpose"))
+          .AttrSingle("GemmOutput", gemm_output);
+      }
+      builder.Finalize(&op_def);
+      SingleNode* new_node = new SingleNode(op_def, nodes.front()->scope(), !owner);
+      if (owner)
+        owner->AddOwnedNode(new_node);
       //if (batch_enable) new_node->SetBatchEnabled();
 
-      for (auto* e : out_edges) {
+      for (auto* e : node_out_edges) {
         new_node->AddOutput(e);
       }
-      for (auto* e : in_edges) {
+      for (auto* e : node_in_edges) {
         new_node->AddInput(e);
       }
       parser_.AddFusedNode(new_node, i);
@@ -9,21 +9,44 @@ namespace RTC {
 class CodeGenerator {
  public:
   CodeGenerator(std::list<Node*>* n);
+  //the cpu nodes of a simple session, the fused nodes are owned by the
+  //session out of the scope, which is still differentiated after the run
+  CodeGenerator(std::list<Node*>* n, const std::vector<const Edge*>& fetched,
+                SessionBase* sess);
   inline static std::string PrefixedVar(std::string var) {
     return "tmp_" + var; 
   }
-  inline static std::string OriVar(std::string var) {
-    return "ori_" + var; 
+  inline static std::string AccVar(std::string var) {
+    return "acc_" + var; 
   }
   inline static std::string arrSize(std::string arr) {
     return arr + "_count";
   }
+  inline static std::string arrRowStride(std::string arr) {
+    return arr + "_row_stride";
+  }
+  inline static std::string arrColStride(std::string arr) {
+    return arr + "_col_stride";
+  }
+  inline static std::string arrMod(std::string arr) {
+    return arr + "_mod";
+  }
+  inline static std::string arrIds(std::string arr) {
+    return arr + "_ids";
+  }
+  inline static std::string arrIdsSize(std::string arr) {
+    return arr + "_ids_count";
+  }
+  inline static std::string arrStride(std::string arr) {
+    return arr + "_stride";
+  }
   inline static std::string typeToString(DataType type) {
     CHECK(DataTypeToString.find((int)type) != DataTypeToString.end());
     return DataTypeToString.at((int)type);
   }
   
  private:
+  void Generate(SessionBase* owner);
   std::vector<std::string> kernel_source_;
   Parser parser_;
   static std::unordered_map<int, std::string> DataTypeToString;
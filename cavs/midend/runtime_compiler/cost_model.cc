@@ -0,0 +1,150 @@
+#include "cavs/midend/runtime_compiler/cost_model.h"
+#include "cavs/midend/runtime_compiler/parser.h"
+#include "cavs/proto/devices.pb.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+using std::unordered_set;
+
+namespace midend {
+namespace RTC {
+
+string FusionEstimate::DebugInfo() const {
+  return "launches_saved: " + std::to_string(launches_saved)
+       + "\tbytes_saved: " + std::to_string(bytes_saved)
+       + "\tpenalty: " + std::to_string(penalty)
+       + "\tsavings(ns): " + std::to_string(savings);
+}
+
+float FusionCostModel::Elements(const Edge* e) const {
+  if (e->isVirtual())
+    return 0;
+  float elements = 1;
+  for (int d : e->shape().dim())
+    elements *= d;
+  return e->IsDynamicEnabled() ? elements * ExpectedRows() : elements;
+}
+
+float FusionCostModel::Bytes(const Edge* e) const {
+  return Elements(e) * (e->dtype() == DT_DOUBLE ? 8 : 4);
+}
+
+FusionEstimate FusionCostModel::Estimate(const vector<Node*>& group) const {
+  unordered_set<const Node*> members(group.begin(), group.end());
+  FusionEstimate est;
+  int ops = 0;
+  for (auto* n : group)
+    ops += isDeserved(n);
+  est.launches_saved = std::max(ops - 1, 0);
+
+  //the gemm operands are not read by the loop
+  float loop = 0;
+  for (auto* n : group) {
+    if (n->name() != "MatMul") {
+      for (auto* e : n->input())
+        loop = std::max(loop, Elements(e));
+    }
+    for (auto* e : n->output())
+      loop = std::max(loop, Elements(e));
+  }
+
+  //the intermediates are kept in the registers(or the cache for the gemm),
+  //they are written only when read out of the group
+  est.bytes_saved = 0;
+  int broadcast = 0;
+  int reduced = 0;
+  unordered_set<const Edge*> visited;
+  for (auto* n : group) {
+    for (auto* e : n->output()) {
+      if (!visited.insert(e).second)
+        continue;
+      int in_readers = 0;
+      for (auto* dst : e->dst())
+        in_readers += members.count(dst);
+      if (in_readers > 0) {
+        est.bytes_saved += in_readers * Bytes(e);
+        if (in_readers == e->dst_size())
+          est.bytes_saved += Bytes(e);
+      }
+      if (in_readers < e->dst_size() || e->dst_size() == 0)
+        reduced += (Elements(e) < loop);
+    }
+  }
+  for (auto* n : group) {
+    if (n->name() == "MatMul")
+      continue;
+    for (auto* e : n->input()) {
+      bool produced = false;
+      for (auto* src : e->src())
+        produced |= (members.count(src) > 0);
+      if (!produced && visited.insert(e).second)
+        broadcast += (Elements(e) < loop);
+    }
+  }
+  est.penalty = broadcast * BroadcastCost(loop)
+              + (reduced > 0 ? ReductionCost(loop, ops, reduced) : 0);
+  est.savings = est.launches_saved * LaunchCost()
+              + est.bytes_saved * ByteCost() - est.penalty;
+  return est;
+}
+
+namespace {
+
+//a kernel launch, the memory at the bandwidth of a discrete card,
+//a reduced output is summed by the blocks and then over their partial sums
+class GPUFusionCostModel : public FusionCostModel {
+ protected:
+  float LaunchCost() const override { return 5000; }
+  float ByteCost() const override { return 0.003; }
+  float BroadcastCost(float loop_elements) const override {
+    return 0.001 * loop_elements;
+  }
+  float ReductionCost(float loop_elements, int ops, int outputs) const override {
+    return (1000 + 0.0005 * loop_elements) * outputs;
+  }
+};
+
+//a dispatch to the thread pool, the memory at the bandwidth of one core,
+//the broadcast loses the vectorized loop and the reduced outputs are
+//read and written back for each element
+class CPUFusionCostModel : public FusionCostModel {
+ protected:
+  float LaunchCost() const override { return 2000; }
+  float ByteCost() const override { return 0.1; }
+  float BroadcastCost(float loop_elements) const override {
+    return 0.5 * loop_elements;
+  }
+  float ReductionCost(float loop_elements, int ops, int outputs) const override {
+    return 0.5 * loop_elements * outputs;
+  }
+};
+
+unordered_map<int, const FusionCostModel*>& CostModels() {
+  static GPUFusionCostModel gpu_model;
+  static CPUFusionCostModel cpu_model;
+  static unordered_map<int, const FusionCostModel*> models =
+    {{GPU, &gpu_model}, {CPU, &cpu_model}};
+  return models;
+}
+
+} //namespace
+
+const FusionCostModel* GetFusionCostModel(int device) {
+  CHECK(CostModels().find(device) != CostModels().end())
+    << "No fusion cost model for device " << device;
+  return CostModels().at(device);
+}
+
+void SetFusionCostModel(int device, const FusionCostModel* model) {
+  CHECK_NOTNULL(model);
+  CostModels()[device] = model;
+}
+
+} //namespace RTC
+} //namespace midend
@@ -0,0 +1,54 @@
+#ifndef CAVS_MIDEND_RUNTIME_COMPILER_COST_MODEL_H_
+#define CAVS_MIDEND_RUNTIME_COMPILER_COST_MODEL_H_
+
+#include "cavs/midend/node.h"
+#include "cavs/midend/edge.h"
+
+#include <string>
+#include <vector>
+
+namespace midend {
+namespace RTC {
+
+struct FusionEstimate {
+  int launches_saved;
+  float bytes_saved;
+  float penalty;
+  //in nanoseconds, per run(per round for the vertex functions)
+  float savings;
+  std::string DebugInfo() const;
+};
+
+//The time saved by running a group of nodes as one fused kernel:
+//the launches(dispatches) of all but one of its ops, and the intermediate
+//tensors neither written nor read back from the memory, minus the cost of
+//the broadcast inputs and the reduced outputs of the loop.
+//The devices plug in their own constants(or models) with SetFusionCostModel.
+class FusionCostModel {
+ public:
+  virtual ~FusionCostModel() {}
+  virtual FusionEstimate Estimate(const std::vector<Node*>& group) const;
+
+ protected:
+  //the time of launching(dispatching) one kernel
+  virtual float LaunchCost() const = 0;
+  //the time of moving one byte from or to the memory
+  virtual float ByteCost() const = 0;
+  //the broadcast inputs are indexed modulo their size
+  virtual float BroadcastCost(float loop_elements) const = 0;
+  //the outputs smaller than the loop are accumulated into
+  virtual float ReductionCost(float loop_elements, int ops, int outputs) const = 0;
+  //the rows of a dynamic tensor in one round, their shapes hold one row
+  virtual float ExpectedRows() const { return 64; }
+
+  float Elements(const Edge* e) const;
+  float Bytes(const Edge* e) const;
+};
+
+const FusionCostModel* GetFusionCostModel(int device);
+void SetFusionCostModel(int device, const FusionCostModel* model);
+
+} //namespace RTC
+} //namespace midend
+
+#endif
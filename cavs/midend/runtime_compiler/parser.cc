@@ -1,4 +1,5 @@
 #include "cavs/midend/runtime_compiler/parser.h"
+#include "cavs/midend/runtime_compiler/cost_model.h"
 #include "cavs/midend/node.h"
 #include "cavs/util/logging.h"
 
@@ -33,20 +34,53 @@ bool isDeserved(const string& op) {
         != elementwise_ops.end());
 }
 
+//the graph ops moving the rows of the round by the ids of the scheduler,
+//the fused kernel loads and stores them in place(only on the gpu)
+bool isGraphLoad(const string& op) {
+  return op == "Gather" || op == "Pull";
+}
+
+bool isGraphStore(const string& op) {
+  return op == "Scatter" || op == "Push";
+}
+
+bool isElementwise(Node* node) {
+  return node->IsSingleNode() && isElementwise(node->name());
+}
+
+bool isGraphOpOnGPU(Node* node) {
+  return node->IsSingleNode() &&
+         (isGraphLoad(node->name()) || isGraphStore(node->name())) &&
+         dynamic_cast<SingleNode*>(node)->op_def().device() == GPU;
+}
+
+//the gemm on the cpu runs the group as its epilogue, on the rows it
+//has just computed, it only heads a group
+bool isGemmOnCPU(Node* node) {
+  return node->IsSingleNode() && node->name() == "MatMul" &&
+         dynamic_cast<SingleNode*>(node)->op_def().device() == CPU;
+}
+
 bool isFusable(Node* node) {
-  return node->IsSingleNode()
-      && isElementwise(node->name());
+  return isElementwise(node) || isGraphOpOnGPU(node) || isGemmOnCPU(node);
       //&& false;
       //&& dynamic_cast<SingleNode*>(node)->IsBatchEnabled();
 }
 
+//a group runs on one device, as one kernel
+bool onSameDevice(Node* a, Node* b) {
+  return dynamic_cast<SingleNode*>(a)->op_def().device() ==
+         dynamic_cast<SingleNode*>(b)->op_def().device();
+}
+
 bool isDeserved(Node* node) {
-  return node->IsSingleNode() && isDeserved(node->name());
+  return node->IsSingleNode() &&
+         (isDeserved(node->name()) || isGraphOpOnGPU(node) || isGemmOnCPU(node));
 }
 
 //Parser::Parser(list<Node*>* n, vector<vector<int>>* dependency)
-Parser::Parser(list<Node*>* n)
-  : nodes_(n)/*, dependency_(dependency)*/ {
+Parser::Parser(list<Node*>* n, const vector<const Edge*>* fetched)
+  : nodes_(n), host_only_(fetched != NULL)/*, dependency_(dependency)*/ {
   CHECK(!nodes_->empty());
   //group_.resize(nodes_->size(), 0);
   auto iter = nodes_->begin();
@@ -60,6 +94,8 @@ Parser::Parser(list<Node*>* n)
       VLOG(V_DEBUG) << dynamic_cast<SingleNode*>(*iter)->op_def().DebugString();
     }
   }
+  if (fetched)
+    fetched_.insert(fetched->begin(), fetched->end());
 }
 
 int FindGroup(int id, const vector<int>& group) {
@@ -70,40 +106,115 @@ int FindGroup(int id, const vector<int>& group) {
   return parent_id;
 }
 
+//the nodes of the group, for the cost model
+vector<Node*> GroupNodes(const vector<int>& ids, const vector<Node*>& nodes) {
+  vector<Node*> group;
+  for (int id : ids)
+    group.push_back(nodes[id]);
+  return group;
+}
+
+string GroupDebugInfo(const vector<Node*>& group) {
+  string info;
+  for (auto* n : group)
+    info += n->name() + "(" + n->output(0)->name() + ") ";
+  return info;
+}
+
 int Parser::GenerateGroup() {
   vector<int> group(nodes_->size(), 0);
+  vector<vector<int>> members(nodes_->size());
   for (int i = 0; i < nodes_->size(); i++) {
     group[i] = i;
+    members[i] = {i};
   }
   auto iter = nodes_->begin();
-  vector<int> fusion_benefit(nodes_->size(), 0);
   vector<int> bottom_line(nodes_->size(), 0);
   vector<int> top_line(nodes_->size(), INT_MAX);
   vector<bool> activated(nodes_->size(), false);
+  vector<bool> has_gemm(nodes_->size(), false);
+  const vector<Node*> node_vec(nodes_->begin(), nodes_->end());
+  auto fusable = [this](Node* n) {
+    return isFusable(n) &&
+           (!host_only_ || dynamic_cast<SingleNode*>(n)->op_def().device() == CPU);
+  };
+  //the estimates of the groups(by their roots), until they are merged
+  vector<float> savings(nodes_->size(), 0);
+  vector<bool> estimated(nodes_->size(), false);
+  auto estimate = [&](int root, const FusionCostModel* model) {
+    if (!estimated[root]) {
+      savings[root] = model->Estimate(GroupNodes(members[root], node_vec)).savings;
+      estimated[root] = true;
+    }
+    return savings[root];
+  };
+  //the groups are merged only when the merged one saves more than both,
+  //a group saving nothing is not fused(a single node never is),
+  //so it is worth nothing rather than its loss
+  auto worth_merging = [&](int gid, int gpid) {
+    if (gid == gpid)
+      return true;
+    const FusionCostModel* model = GetFusionCostModel(
+        dynamic_cast<SingleNode*>(node_vec[gid])->op_def().device());
+    vector<int> merged = members[gid];
+    merged.insert(merged.end(), members[gpid].begin(), members[gpid].end());
+    std::sort(merged.begin(), merged.end());
+    float apart = std::max(estimate(gid, model), 0.f)
+                + std::max(estimate(gpid, model), 0.f);
+    float together = model->Estimate(GroupNodes(merged, node_vec)).savings;
+    VLOG(V_DEBUG) << "Merging groups " << gid << " and " << gpid
+                  << " saves " << together << " vs " << apart;
+    return together > apart;
+  };
   for (int id = 0; id < nodes_->size(); id++, iter++) {
-    if (isFusable(*iter)) {
-      if (isDeserved(*iter)) fusion_benefit[id] += 1;
+    //the loaded rows are only kept in the registers,
+    //so all the readers have to be fused with the load
+    bool forced = false;
+    if ((isGraphOpOnGPU(*iter) && isGraphLoad((*iter)->name())) ||
+        isGemmOnCPU(*iter)) {
+      bool all_fused = true;
+      for (Node* parent_node : (*iter)->output(0)->dst())
+        all_fused &= (node2idx_.find(parent_node) != node2idx_.end() &&
+                      isElementwise(parent_node) && fusable(parent_node) &&
+                      onSameDevice(*iter, parent_node));
+      if (!all_fused) continue;
+      forced = true;
+    }
+    if (fusable(*iter)) {
+      if (isGemmOnCPU(*iter)) has_gemm[id] = true;
       CHECK((*iter)->output_size() == 1);
       Edge* edge = (*iter)->output(0);
       for (Node* parent_node : edge->dst(true)) {
         if (node2idx_.find(parent_node) == node2idx_.end()) continue;
         //we loose this constraint because batchweightupdater may remove some nodes in this scope
         //CHECK(node2idx_.find(parent_node) != node2idx_.end());
-        if (isFusable(parent_node)) {
+        //one gemm in a group
+        bool two_gemms = isGemmOnCPU(parent_node) ||
+          (has_gemm[FindGroup(id, group)] &&
+           has_gemm[FindGroup(node2idx_.at(parent_node), group)] &&
+           FindGroup(id, group) != FindGroup(node2idx_.at(parent_node), group));
+        if (fusable(parent_node) && onSameDevice(*iter, parent_node) && !two_gemms &&
+            (forced || worth_merging(FindGroup(id, group),
+                                     FindGroup(node2idx_.at(parent_node), group)))) {
           int pid = node2idx_.at(parent_node);
           CHECK(pid > id);
           int gpid = FindGroup(pid, group);
           int gid = FindGroup(id, group);
+          const bool gemm = has_gemm[gid] || has_gemm[gpid];
           //CHECK(gpid > gid) << pid << "\t" << id << "\t" << gpid << "\t" << gid;
-          if(gpid > gid){
-            group[gid] = gpid;
-          }else{
-            group[gpid] = gid;
+          if (gpid != gid) {
+            int root = std::max(gid, gpid);
+            int child = std::min(gid, gpid);
+            group[child] = root;
+            members[root].insert(members[root].end(),
+                                 members[child].begin(), members[child].end());
+            members[child].clear();
+            estimated[root] = false;
           }
+          has_gemm[FindGroup(id, group)] = gemm;
 
           bottom_line[FindGroup(id, group)] = std::max(bottom_line[gid], bottom_line[pid]);
           top_line[FindGroup(id, group)] = std::min(top_line[gid], top_line[pid]);
-          fusion_benefit[gpid] += fusion_benefit[gid];
           activated[pid] = true;
           if (!activated[id]) {
             bottom_line[FindGroup(id, group)] = id;
@@ -128,11 +239,42 @@ int Parser::GenerateGroup() {
     VLOG(V_DEBUG) << "GroupID:\t" << iter.first;
     for (int id : iter.second)
       VLOG(V_DEBUG) << "GroupContent:\t" << id;
-    if (fusion_benefit[iter.first] > 1) {
-      group_contents_.push_back(std::move(iter.second));
-      CHECK(bottom_line[iter.first] < top_line[iter.first]);
-      group_insert_pos_.push_back(bottom_line[iter.first]);
+    const vector<Node*>& group_nodes = GroupNodes(iter.second, node_vec);
+    const FusionEstimate& est = GetFusionCostModel(
+        dynamic_cast<SingleNode*>(group_nodes.front())->op_def().device())->Estimate(group_nodes);
+    //the decisions are logged for auditing the fusion
+    if (est.savings <= 0) {
+      VLOG(V_TIMING) << "Rejected fusion group " << iter.first << ": "
+                     << GroupDebugInfo(group_nodes) << "\t" << est.DebugInfo();
+      continue;
+    }
+    //the gemm may also be read by another group(of another gemm)
+    if (has_gemm[iter.first] && bottom_line[iter.first] >= top_line[iter.first]) {
+      VLOG(V_DEBUG) << "Group " << iter.first << " is read before its gemm is done";
+      continue;
+    }
+    CHECK(bottom_line[iter.first] < top_line[iter.first]);
+    //the loads of the graph ops come first and read nothing,
+    //so the group also waits for the inputs of its other nodes
+    int insert_pos = bottom_line[iter.first];
+    set<int> group_members(iter.second.begin(), iter.second.end());
+    for (int id : iter.second) {
+      for (Edge* ie : node_vec[id]->input()) {
+        for (Node* src : ie->src(true)) {
+          if (node2idx_.find(src) != node2idx_.end() &&
+              group_members.find(node2idx_.at(src)) == group_members.end())
+            insert_pos = std::max(insert_pos, node2idx_.at(src));
+        }
+      }
+    }
+    if (insert_pos >= top_line[iter.first]) {
+      VLOG(V_DEBUG) << "Group " << iter.first << " is read before its inputs are ready";
+      continue;
     }
+    VLOG(V_TIMING) << "Fusing group " << iter.first << ": "
+                   << GroupDebugInfo(group_nodes) << "\t" << est.DebugInfo();
+    group_contents_.push_back(std::move(iter.second));
+    group_insert_pos_.push_back(insert_pos);
   }
 
   return group_contents_.size();
@@ -162,7 +304,8 @@ void Parser::FuseGroup(int gid, list<Node*>* nodes, list<Edge*>* in_edge, list<E
     for (Edge* oe : (*iter)->output()) {
       //loose this constraint because of accumulate operator
       //CHECK(out_edge_times.find(oe) == out_edge_times.end());
-      out_edge_times[oe] = oe->dst_size();
+      //the fetched ones are read after the group
+      out_edge_times[oe] = oe->dst_size() + fetched_.count(oe);
     }
     nodes->push_back(*std::next(nodes_->begin(), id));
     auto ret = remove_nodes_.insert(*iter);
@@ -173,7 +316,10 @@ void Parser::FuseGroup(int gid, list<Node*>* nodes, list<Edge*>* in_edge, list<E
     out_edge->push_back(iter.first);
   }
 
-  CHECK(!in_edge->empty());
+  //the group may only read the rows loaded by the graph ops
+  CHECK(!in_edge->empty() ||
+        std::any_of(nodes->begin(), nodes->end(),
+                    [](Node* n) { return isGraphLoad(n->name()); }));
   CHECK(!out_edge->empty());
 }
 
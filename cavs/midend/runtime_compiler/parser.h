@@ -13,10 +13,18 @@
 namespace midend {
 namespace RTC {
 
+//Gather/Pull and Scatter/Push
+bool isGraphLoad(const std::string& op);
+bool isGraphStore(const std::string& op);
+//the ops running a kernel of their own when not fused
+bool isDeserved(Node* node);
+
 class Parser {
  public:
   //Parser(std::list<Node*>* n, std::vector<std::vector<int>>* dependency);
-  Parser(std::list<Node*>* n);
+  //in a simple session(the fetched edges given), only the nodes on the cpu
+  //are grouped, and the fetched edges stay the outputs of the groups
+  Parser(std::list<Node*>* n, const std::vector<const Edge*>* fetched = NULL);
   int GenerateGroup();
   void FuseGroup(int gid, std::list<Node*>* nodes,
                  std::list<Edge*>* in_edges, std::list<Edge*>* out_Edges);
@@ -26,6 +34,8 @@ class Parser {
  private:
   //int FindGroup(int id) const;
   std::list<Node*>* nodes_;
+  bool host_only_;
+  std::set<const Edge*> fetched_;
   //std::vector<std::vector<int>>* dependency_;
 
   std::unordered_map<Node*, int> node2idx_;
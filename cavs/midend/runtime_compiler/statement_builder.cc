@@ -18,8 +18,9 @@ AssignStatementBuilder& AssignStatementBuilder::SetNode(Node* node) {
     {{"Add", "+"}, {"Minus", "-"}, {"Mul", "*"}};
   static unordered_map<string, string> u_ops =
     {{"Tanh", "tanhf"}};
+  //scatter and push copy their input, the kernel stores it in place
   static vector<string> ref_ops =
-    {"Assign", "Mirror", "Accumulate"};
+    {"Assign", "Mirror", "Accumulate", "Scatter", "Push"};
   static vector<string> self_defined_ops =
     {"Sigmoid", "Tanh_grad", "Sigmoid_grad", "Relu"};
   string right_hand;
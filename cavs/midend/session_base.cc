@@ -1,5 +1,6 @@
 #include "cavs/midend/session_base.h"
 #include "cavs/midend/allocator.h"
+#include "cavs/midend/graph_session.h"
 #include "cavs/util/logging.h"
 
 #include <unordered_map>
@@ -24,6 +25,54 @@ const Tensor* SessionBase::GetTensor(
   }
 }
 
+SessionBase::~SessionBase() {
+  for (auto& iter : graph_sessions_)
+    delete iter.second;
+  if (variable_source_)
+    variable_source_->replicas_.erase(this);
+  //the shared tensors are held by the replicas
+  for (auto* r : replicas_) {
+    r->variable_source_ = NULL;
+    r->variable_source_lost_ = true;
+  }
+}
+
+GraphSession* SessionBase::FindGraphSession(const string& name) const {
+  auto iter = graph_sessions_.find(name);
+  return (iter == graph_sessions_.end()) ? NULL : iter->second;
+}
+
+void SessionBase::InsertGraphSession(const string& name, GraphSession* sess) {
+  CHECK(graph_sessions_.find(name) == graph_sessions_.end()) << name;
+  graph_sessions_.emplace(name, sess);
+}
+
+std::mutex& SessionBase::compile_mutex() {
+  static std::mutex mu;
+  return mu;
+}
+
+std::mutex& SessionBase::gpu_mutex() {
+  static std::mutex mu;
+  return mu;
+}
+
+const Tensor* SessionBase::SharedVariable(const Edge* edge) {
+  if ((!variable_source_ && !variable_source_lost_) || !edge->isVariable())
+    return NULL;
+  if (GetTensor(edge->scoped_name()))
+    return GetTensor(edge->scoped_name());
+  CHECK(!variable_source_lost_) << "The session sharing " << edge->scoped_name()
+                                << " is destroyed";
+  const Tensor* t = variable_source_->GetTensor(edge->scoped_name());
+  if (t) {
+    VLOG(V_DEBUG) << "Sharing variable " << edge->scoped_name();
+    InsertTensor(*t);
+    t = GetTensor(edge->scoped_name());
+  }
+  return t;
+}
+
 void SessionBase::InsertTensor(const Tensor& t){
   CHECK(t.name().find_last_of(":") != string::npos) 
        << "tensor name must be a scoped name: " << t.name();
@@ -32,23 +81,26 @@ void SessionBase::InsertTensor(const Tensor& t){
   string tensor_name = t.name().substr(t.name().find_last_of(":")+1);
   CHECK(tensor_name.length());
   if (raw_tensor_map_.find(tensor_name) != raw_tensor_map_.end()) {
-    CHECK(raw_tensor_map_.at(tensor_name).buf_.get() == t.buf_.get());
+    CHECK(raw_tensor_map_.at(tensor_name).buffer() == t.buffer());
   }else {
     raw_tensor_map_[tensor_name] = t;
   }
 }
 
 OpContext* SessionBase::GetContext(const Node* node) {
-  OpContext* ctxt  = new OpContext();
+  OpContext* ctxt  = arena()->New<OpContext>(arena(), execution_state());
+  ctxt->Reserve(node->input_size(), node->output_size());
   CHECK(node->IsSingleNode());
   const OpDef& op_def = dynamic_cast<const SingleNode*>(node)->op_def();
   for (auto* input : node->input()) {
     const Tensor* t = GetTensor(input->scoped_name()); 
+    if (!t) t = SharedVariable(input);
     CHECK(t) << "Getting " << input->scoped_name();
     ctxt->AppendInput(t);
   }
   for (auto* output : node->output()) {
     const Tensor* t = GetTensor(output->scoped_name());
+    if (!t) t = SharedVariable(output);
     if (!t) {
       const Tensor* upper_t = GetTensor(output->scoped_name(), true);
       if (upper_t) {
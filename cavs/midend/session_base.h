@@ -3,16 +3,29 @@
 
 #include "cavs/midend/tensor.h"
 #include "cavs/midend/node.h"
+#include "cavs/midend/arena.h"
+#include "cavs/midend/op_context.h"
 
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace midend {
 
 class OpContext;
 class Node;
+class Edge;
+class Statement;
+class GraphSession;
 class SessionBase {
  public:
-  explicit SessionBase(int opt = 0) : opt_(opt) {}
+  explicit SessionBase(int opt = 0)
+    : opt_(opt), variable_source_(NULL), variable_source_lost_(false) {}
+  //the graph sessions of the function bodies are owned by the session
+  virtual ~SessionBase();
   virtual const Tensor* GetTensor(const std::string& name, bool recursive = false) const;
   virtual OpContext* GetContext(const Node* node) ;
   virtual void Run(const std::vector<std::string>& output_names, 
@@ -21,19 +34,108 @@ class SessionBase {
                    const std::vector<Tensor>& input_tensors) {
     LOG(FATAL) << "Base Session";
   }
+  //resolves the outputs and the inputs once, and returns a handle to run them.
+  //RunPrepared feeds the user memory of the inputs directly(the host tensors
+  //are bound to it during the run), and the outputs are views owned by the
+  //session, valid until the next run of the handle.
+  virtual int Prepare(const std::vector<std::string>& output_names,
+                      const std::vector<std::string>& input_names) {
+    LOG(FATAL) << "Base Session";
+  }
+  virtual void RunPrepared(int handle,
+                           const std::vector<void*>& inputs,
+                           std::vector<const void*>* outputs) {
+    LOG(FATAL) << "Base Session";
+  }
+  //queues a run of the handle and returns at once(or when too many runs are
+  //in flight). The runs are done one by one in the order they are queued,
+  //the outputs are copied to the given host memory(NULL to skip), which must
+  //stay valid until the future is ready. The inputs are copied before it
+  //returns, and sent to the device while the runs before are running.
+  virtual std::future<void> RunAsync(int handle,
+                                     const std::vector<void*>& inputs,
+                                     const std::vector<void*>& outputs) {
+    LOG(FATAL) << "Base Session";
+  }
+  virtual void SetMaxInFlight(int n) {
+    LOG(FATAL) << "Base Session";
+  }
+  //the compiled statements of the outputs and their tensors, so that another
+  //process runs them without building and compiling the graph again
+  virtual void SavePlan(const std::vector<std::string>& output_names,
+                        const std::string& filename) {
+    LOG(FATAL) << "Base Session";
+  }
+  virtual void LoadPlan(const std::string& filename) {
+    LOG(FATAL) << "Base Session";
+  }
+  //the variables of the compiled outputs. The asynchronous save only waits
+  //for the variables to be copied to the host, and for the former save.
+  virtual void SaveCheckpoint(const std::string& filename, bool async) {
+    LOG(FATAL) << "Base Session";
+  }
+  virtual void RestoreCheckpoint(const std::string& filename) {
+    LOG(FATAL) << "Base Session";
+  }
 
   enum SessionType { SIMPLE=1, MPI=2, GRAPH=4 };
   virtual int session_type() const {}
   int opt_type() const { return opt_; }
+  //the statements, contexts and ops compiled by this session
+  virtual Arena* arena() { return &arena_; }
+  //the round, the dynamic dimension and so on of the runs
+  virtual ExecutionState* execution_state() { return &exec_state_; }
+  //the statement compiled for the node by this session
+  Statement*& CompiledStatement(const Node* node) { return compiled_[node]; }
+  //the nodes made by the compiling passes out of the scopes,
+  //they live as long as the statements compiled from them
+  void AddOwnedNode(Node* node) { owned_nodes_.emplace_back(node); }
+  //the function bodies are compiled once for each session
+  virtual GraphSession* FindGraphSession(const std::string& name) const;
+  virtual void InsertGraphSession(const std::string& name, GraphSession* sess);
+  //the variables are not allocated(nor initialized) again,
+  //but taken from the given session. They are read-only for both sessions
+  //when they run at the same time, as the replicas serving a model do.
+  //The replica holds the tensors and compiles its own statements on them,
+  //so its runs do not touch the source. The source must outlive the
+  //compiling of the replica, which is checked when it is destroyed before.
+  void ShareVariablesWith(SessionBase* source) {
+    CHECK(source && source != this);
+    CHECK(!variable_source_);
+    variable_source_ = source;
+    source->replicas_.insert(this);
+  }
+  SessionBase* variable_source() const {
+    CHECK(!variable_source_lost_) << "The session sharing the variables is destroyed";
+    return variable_source_;
+  }
+  //the tensor of the source session for the shared variable edges
+  const Tensor* SharedVariable(const Edge* edge);
+  //the graph(main_scope) is shared by the sessions,
+  //and some compiling passes rewrite it
+  static std::mutex& compile_mutex();
+  //the cublas/cudnn handles and the streams are the ones of the process,
+  //so the sessions running at the same time take turns on the gpu
+  static std::mutex& gpu_mutex();
   //void AddType(SessionType t) { type_ += (int)t; }
 
   void InsertTensor(const Tensor& t);
   std::string debug_info() const ;
  protected:
+  //tensors sharing the buffer are the same memory for the dependency analysis
+  static const void* BufferOf(const Tensor& t) { return t.buffer(); }
   std::unordered_map<std::string, Tensor> raw_tensor_map_;
   std::unordered_map<std::string, Tensor> scoped_tensor_map_;
   //int type_;
   int opt_;
+  Arena arena_;
+  ExecutionState exec_state_;
+  std::unordered_map<const Node*, Statement*> compiled_;
+  std::vector<std::unique_ptr<Node>> owned_nodes_;
+  std::unordered_map<std::string, GraphSession*> graph_sessions_;
+  SessionBase* variable_source_;
+  bool variable_source_lost_;
+  std::set<SessionBase*> replicas_;
 };
 
 SessionBase* GetSession(const std::string& name, int opt);
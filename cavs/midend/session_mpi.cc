@@ -26,6 +26,8 @@ class MPISession: public SimpleSession {
   void Compile(const vector<string>& output_names) override;
   void FetchOutput(const vector<string>& output_names,
                    vector<Tensor>* output_tensors) override;
+  void RunPrepared(int handle, const vector<void*>& inputs,
+                   vector<const void*>* outputs) override;
 };
 
 void AddMPIOnPath(list<Node*>& critical_path) {
@@ -85,11 +87,14 @@ MPISession::MPISession(int opt) : SimpleSession(opt) {
 }
 
 MPISession::~MPISession() {
+  //the queued runs still communicate
+  StopAsync();
   MPI_Finalize();
 }
 
 void MPISession::Compile(
     const vector<string>& output_names) {
+  std::lock_guard<std::mutex> lock(compile_mutex());
   list<Node*> critical_path;
   set<Node*> include;
   for (auto& output : output_names) {
@@ -137,6 +142,18 @@ void MPISession::FetchOutput(const vector<string>& output_names,
   }
 }
 
+void MPISession::RunPrepared(int handle, const vector<void*>& inputs,
+    vector<const void*>* outputs) {
+  SimpleSession::RunPrepared(handle, inputs, outputs);
+  const Prepared* p = prepared_[handle].get();
+  for (int i = 0; i < outputs->size(); i++) {
+    if (outputs->at(i)) {
+      void* buf = const_cast<void*>(outputs->at(i));
+      MPIAllReduceFunctor<float>::Compute(buf, buf, p->outputs[i]->count());
+    }
+  }
+}
+
 REGISTER_SESSION_BUILDER("MPISession", MPISession);
 
 } //namespace midend
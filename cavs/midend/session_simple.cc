@@ -1,10 +1,20 @@
 #include "cavs/midend/session_simple.h"
 #include "cavs/midend/allocator.h"
+#include "cavs/midend/graph_simplifier.h"
+#include "cavs/midend/runtime_compiler/code_generator.h"
 #include "cavs/util/logging.h"
 #include "cavs/util/macros_gpu.h"
 #include "cavs/util/op_def_builder.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/proto/plan_def.pb.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iterator>
+#include <map>
+#include <unordered_map>
 
 using std::string;
 using std::vector;
@@ -13,7 +23,22 @@ using std::set;
 
 namespace midend {
 
-SimpleSession::SimpleSession(int opt) : SessionBase(opt), s_(main_scope()) {}
+SimpleSession::SimpleSession(int opt)
+    : SessionBase(opt), in_flight_(0), max_in_flight_(2),
+      copy_stream_(NULL), async_stop_(false), s_(main_scope()) {}
+
+SimpleSession::~SimpleSession() {
+  StopAsync();
+  for (auto& st : staging_) {
+    for (void* h : st->host)   if (h) checkCudaError(cudaFreeHost(h));
+    for (void* d : st->device) if (d) checkCudaError(cudaFree(d));
+    checkCudaError(cudaEventDestroy(st->copied));
+    checkCudaError(cudaEventDestroy(st->done));
+  }
+  if (copy_stream_)
+    checkCudaError(cudaStreamDestroy(copy_stream_));
+  VLOG(V_TIMING) << "Thread pool utilization:\n" << ThreadPool::UtilizationInfo();
+}
 
 void SimpleSession::DepthSearch(Node* curr,
     list<Node*>* critical_path,
@@ -53,8 +78,26 @@ string SimpleSession::HashString(const vector<string>& input) {
   return str;
 }
 
+const Tensor* SimpleSession::FindTensor(const string& name) {
+  const Edge* edge = s_->FindEdge(name);
+  if (edge) {
+    if (edge->isVirtual())
+      return NULL;
+    const Tensor* t = GetTensor(edge->scoped_name());
+    CHECK(t) << "Getting " << edge->scoped_name()
+             << "\tin\n"   << debug_info();
+    return t;
+  }
+  if (plan_virtual_fetches_.count(name))
+    return NULL;
+  auto iter = raw_tensor_map_.find(name);
+  CHECK(iter != raw_tensor_map_.end()) << "Edge: " << name;
+  return &(iter->second);
+}
+
 void SimpleSession::Compile(
     const vector<string>& output_names) {
+  std::lock_guard<std::mutex> lock(compile_mutex());
   list<Node*> critical_path;
   set<Node*> include;
   VLOG(V_DEBUG) << "Searching Critical Path";
@@ -65,6 +108,33 @@ void SimpleSession::Compile(
   }
   CHECK(critical_path.size() >= 2);
 
+  std::unique_ptr<GraphSimplifier> simplifier;
+  if (opt_type() & OPT_GRAPH_SIMPLIFY) {
+    vector<const Node*> outputs;
+    for (auto& output : output_names)
+      outputs.push_back(s_->FindNode(output));
+    simplifier.reset(new GraphSimplifier(&critical_path, outputs, this));
+  }
+
+  //the gpu groups are only fused in the graph sessions
+  if (opt_type() & OPT_FUSION) {
+    vector<const Edge*> fetched;
+    for (auto& output : output_names) {
+      for (auto* e : s_->FindNode(output)->output())
+        fetched.push_back(e);
+    }
+    if (simplifier) {
+      //the removed nodes read the tensors of the kept ones
+      for (auto* node : critical_path) {
+        for (auto* e : node->output()) {
+          if (!simplifier->aliases(e).empty())
+            fetched.push_back(e);
+        }
+      }
+    }
+    RTC::CodeGenerator generator(&critical_path, fetched, this);
+  }
+
   VLOG(V_DEBUG) << "============In Critical Path============";
   for (auto* node : critical_path) {
     VLOG(V_DEBUG) << "-------Node INFO\t"
@@ -81,41 +151,413 @@ void SimpleSession::Compile(
     Statement* stmt = node->Compile(this);
     CHECK(stmt);
     executor->push_back(stmt);
+    if (simplifier) {
+      //the removed nodes read and write the tensors of the kept ones
+      for (auto* kept : node->output()) {
+        const Tensor* t = GetTensor(kept->scoped_name());
+        for (auto* removed : simplifier->aliases(kept)) {
+          CHECK_NOTNULL(t);
+          InsertTensor(Tensor(removed->scoped_name(), *t));
+        }
+      }
+    }
+  }
+
+  if (opt_type() & OPT_INTEROP_PARALLEL) {
+    dag_executors_[HashString(output_names)].reset(
+        BuildDagExecutor(critical_path, *executor));
   }
 
   return;
 }
 
+DagExecutor* SimpleSession::BuildDagExecutor(
+    const list<Node*>& critical_path,
+    const vector<Statement*>& stmts) {
+  CHECK(critical_path.size() == stmts.size());
+  DagExecutor* dag = new DagExecutor(ThreadPool::Get());
+  std::unordered_map<const Node*, int> index;
+  //the statements are ordered by both the graph edges and the memory they touch,
+  //the optimizers update the variables in place, and a scoped node reads and
+  //writes all the tensors of its body.
+  std::unordered_map<const void*, int> last_writer;
+  std::unordered_map<const void*, vector<int>> readers;
+  //the gpu statements share the cublas/cudnn handles and the streams,
+  //so they are chained in their order and only the cpu ones overlap
+  int last_gpu = -1;
+  auto it = critical_path.begin();
+  for (int i = 0; i < stmts.size(); i++, it++) {
+    vector<OpContext*> ctxts;
+    stmts[i]->GetContexts(&ctxts);
+    //the explicit hint, or the amount of data the statement touches
+    float cost = 0;
+    if ((*it)->IsSingleNode())
+      cost = GetSingleArg<float>(dynamic_cast<SingleNode*>(*it)->op_def(), "CostHint", -1.f);
+    if (cost < 0) {
+      cost = 0;
+      for (auto* c : ctxts) {
+        for (int j = 0; j < c->InputSize(); j++)  cost += c->Input(j).count();
+        for (int j = 0; j < c->OutputSize(); j++) cost += c->Output(j)->count();
+      }
+    }
+    int id = dag->AddStatement(stmts[i], cost);
+    index[*it] = id;
+
+    bool on_gpu = (*it)->IsSingleNode() &&
+                  dynamic_cast<SingleNode*>(*it)->op_def().device() == GPU;
+    for (auto* c : ctxts)
+      on_gpu |= OnGPU(c);
+    if (on_gpu) {
+      if (last_gpu >= 0)
+        dag->AddDependency(last_gpu, id);
+      last_gpu = id;
+    }
+
+    for (auto* edge : (*it)->input())
+      for (auto* src : edge->src(true))
+        if (index.find(src) != index.end() && index.at(src) != id)
+          dag->AddDependency(index.at(src), id);
+    for (auto* edge : (*it)->control_dependency())
+      for (auto* src : edge->src(true))
+        if (index.find(src) != index.end() && index.at(src) != id)
+          dag->AddDependency(index.at(src), id);
+
+    set<const void*> reads, writes;
+    for (auto* c : ctxts) {
+      for (int j = 0; j < c->InputSize(); j++)  reads.insert(BufferOf(c->Input(j)));
+      for (int j = 0; j < c->OutputSize(); j++) writes.insert(BufferOf(*c->Output(j)));
+    }
+    for (auto* b : reads) {
+      if (last_writer.find(b) != last_writer.end() && last_writer.at(b) != id)
+        dag->AddDependency(last_writer.at(b), id);
+    }
+    for (auto* b : writes) {
+      if (last_writer.find(b) != last_writer.end() && last_writer.at(b) != id)
+        dag->AddDependency(last_writer.at(b), id);
+      for (int r : readers[b])
+        if (r != id) dag->AddDependency(r, id);
+    }
+    for (auto* b : reads)
+      readers[b].push_back(id);
+    for (auto* b : writes) {
+      last_writer[b] = id;
+      readers[b].clear();
+    }
+  }
+  dag->Finalize();
+  return dag;
+}
+
+bool SimpleSession::OnGPU(OpContext* ctxt) {
+  for (int i = 0; i < ctxt->InputSize(); i++) {
+    const Tensor& t = ctxt->Input(i);
+    if (!t.empty() && t.device_type() == GPU)
+      return true;
+  }
+  for (int i = 0; i < ctxt->OutputSize(); i++) {
+    const Tensor* t = ctxt->Output(i);
+    if (!t->empty() && t->device_type() == GPU)
+      return true;
+  }
+  return false;
+}
+
+bool SimpleSession::OnGPU(const vector<Statement*>* stmts) {
+  auto iter = on_gpu_.find(stmts);
+  if (iter != on_gpu_.end())
+    return iter->second;
+  bool on_gpu = false;
+  for (auto* stmt : *stmts) {
+    vector<OpContext*> ctxts;
+    stmt->GetContexts(&ctxts);
+    for (auto* c : ctxts)
+      on_gpu |= OnGPU(c);
+  }
+  on_gpu_[stmts] = on_gpu;
+  return on_gpu;
+}
+
+void SimpleSession::Execute(const vector<Statement*>* stmts, DagExecutor* dag) {
+  std::unique_lock<std::mutex> lock(gpu_mutex(), std::defer_lock);
+  if (OnGPU(stmts))
+    lock.lock();
+  if (dag) {
+    dag->Run();
+  }else {
+    for (auto* exe : *stmts) {
+      exe->Run();
+    }
+  }
+}
+
 void SimpleSession::Run(const vector<string>& output_names,
     vector<Tensor>* output_tensors,
     const vector<string>& input_names,
     const vector<Tensor>& input_tensors) {
+  WaitAsync();
   VLOG(V_TIMING) << "Compiling for calculating the output ...";
-  if (executors_.find(HashString(output_names)) == executors_.end()) {
+  const string key = HashString(output_names);
+  if (executors_.find(key) == executors_.end()) {
     Compile(output_names);
   }
   VLOG(V_TIMING) << "Feeding inputs...";
   FeedInput(input_names, input_tensors);
   VLOG(V_TIMING) << "Executing...";
-  for (auto* exe : executors_[HashString(output_names)]) {
-    exe->Run();
-  }
+  auto dag = dag_executors_.find(key);
+  Execute(&executors_.at(key), (dag == dag_executors_.end()) ? NULL : dag->second.get());
   VLOG(V_TIMING) << "Fetching output..";
   FetchOutput(output_names, output_tensors);
   VLOG(V_TIMING) << "Execution completed";
-  Statement::IncRound();
+  execution_state()->round++;
+  //the statements may run on the streams of the pool(OPT_STREAMMING)
   checkCudaError(cudaDeviceSynchronize());
 }
 
+int SimpleSession::Prepare(const vector<string>& output_names,
+    const vector<string>& input_names) {
+  const string key = HashString(output_names);
+  //the names can not contain '\0'
+  string handle_key = key;
+  for (auto& s : input_names)
+    handle_key += '\0' + s;
+  auto iter = handles_.find(handle_key);
+  if (iter != handles_.end())
+    return iter->second;
+
+  //the queued runs read the compiled handles
+  WaitAsync();
+  if (executors_.find(key) == executors_.end()) {
+    Compile(output_names);
+  }
+  Prepared* p = new Prepared();
+  p->stmts = &executors_.at(key);
+  auto dag = dag_executors_.find(key);
+  p->dag = (dag == dag_executors_.end()) ? NULL : dag->second.get();
+  for (auto& name : input_names) {
+    Tensor* t = const_cast<Tensor*>(FindTensor(name));
+    CHECK(t) << name << "\t" << debug_info();
+    p->inputs.push_back(t);
+  }
+  for (auto& name : output_names) {
+    p->outputs.push_back(FindTensor(name));
+  }
+  p->mirrors.resize(p->outputs.size());
+  prepared_.emplace_back(p);
+  handles_[handle_key] = prepared_.size()-1;
+  return prepared_.size()-1;
+}
+
+void SimpleSession::RunPrepared(int handle,
+    const vector<void*>& inputs,
+    vector<const void*>* outputs) {
+  CHECK(handle >= 0 && handle < prepared_.size()) << handle;
+  WaitAsync();
+  Prepared* p = prepared_[handle].get();
+  CHECK(inputs.size() == p->inputs.size());
+  VLOG(V_TIMING) << "Binding inputs...";
+  for (int i = 0; i < inputs.size(); i++) {
+    if (p->inputs[i]->device_type() == GPU)
+      p->inputs[i]->SyncWithHost(inputs[i]);
+    else
+      p->inputs[i]->BindExternal(inputs[i]);
+  }
+  VLOG(V_TIMING) << "Executing...";
+  Execute(p->stmts, p->dag);
+  VLOG(V_TIMING) << "Fetching output..";
+  outputs->resize(p->outputs.size());
+  for (int i = 0; i < p->outputs.size(); i++) {
+    const Tensor* t = p->outputs[i];
+    if (!t) {
+      outputs->at(i) = NULL;
+    }else if (t->device_type() == GPU) {
+      Tensor& mirror = p->mirrors[i];
+      if (mirror.empty() || mirror.count() != t->count())
+        mirror.Rebase(GetAllocator(DeviceTypeToString(CPU)), *t);
+      t->CopyToHost(mirror.mutable_data<char>());
+      outputs->at(i) = mirror.data<char>();
+    }else {
+      outputs->at(i) = t->data<char>();
+    }
+  }
+  for (int i = 0; i < inputs.size(); i++) {
+    if (p->inputs[i]->device_type() != GPU)
+      p->inputs[i]->UnbindExternal();
+  }
+  VLOG(V_TIMING) << "Execution completed";
+  execution_state()->round++;
+  checkCudaError(cudaDeviceSynchronize());
+}
+
+SimpleSession::Staging* SimpleSession::StageInputs(const Prepared* p,
+    const vector<void*>& inputs) {
+  Staging* st = NULL;
+  {
+    std::lock_guard<std::mutex> lock(async_mu_);
+    if (!copy_stream_) {
+      checkCudaError(cudaStreamCreateWithFlags(&copy_stream_, cudaStreamNonBlocking));
+    }
+    if (free_staging_.empty()) {
+      st = new Staging();
+      checkCudaError(cudaEventCreateWithFlags(&st->copied, cudaEventDisableTiming));
+      checkCudaError(cudaEventCreateWithFlags(&st->done, cudaEventDisableTiming));
+      staging_.emplace_back(st);
+    }else {
+      st = free_staging_.back();
+      free_staging_.pop_back();
+    }
+  }
+  if (st->bytes.size() < inputs.size()) {
+    st->host.resize(inputs.size(), NULL);
+    st->device.resize(inputs.size(), NULL);
+    st->bytes.resize(inputs.size(), 0);
+  }
+  for (int i = 0; i < inputs.size(); i++) {
+    const Tensor* t = p->inputs[i];
+    const size_t bytes = t->bytes();
+    if (st->bytes[i] < bytes) {
+      if (st->host[i])   checkCudaError(cudaFreeHost(st->host[i]));
+      if (st->device[i]) checkCudaError(cudaFree(st->device[i]));
+      checkCudaError(cudaMallocHost(&st->host[i], bytes));
+      st->device[i] = NULL;
+      st->bytes[i] = bytes;
+    }
+    memcpy(st->host[i], inputs[i], bytes);
+    if (t->device_type() == GPU) {
+      if (!st->device[i])
+        checkCudaError(cudaMalloc(&st->device[i], st->bytes[i]));
+      checkCudaError(cudaMemcpyAsync(st->device[i], st->host[i], bytes,
+                                     cudaMemcpyHostToDevice, copy_stream_));
+    }
+  }
+  checkCudaError(cudaEventRecord(st->copied, copy_stream_));
+  return st;
+}
+
+void SimpleSession::RunStaged(int handle, Staging* st,
+    const vector<void*>& outputs) {
+  Prepared* p = prepared_[handle].get();
+  //the copy into the input tensors is after the runs before,
+  //by the order of the default stream
+  checkCudaError(cudaStreamWaitEvent(0, st->copied, 0));
+  for (int i = 0; i < p->inputs.size(); i++) {
+    Tensor* t = p->inputs[i];
+    if (t->device_type() == GPU) {
+      checkCudaError(cudaMemcpyAsync(t->mutable_data<char>(), st->device[i],
+                                     t->bytes(), cudaMemcpyDeviceToDevice, 0));
+    }else {
+      t->BindExternal(st->host[i]);
+    }
+  }
+  VLOG(V_TIMING) << "Executing...";
+  Execute(p->stmts, p->dag);
+  for (int i = 0; i < outputs.size(); i++) {
+    const Tensor* t = p->outputs[i];
+    if (outputs[i] && t && t->device_type() == GPU) {
+      checkCudaError(cudaMemcpyAsync(outputs[i], t->data<char>(), t->bytes(),
+                                     cudaMemcpyDeviceToHost, 0));
+    }
+  }
+  //the legacy default stream waits for the blocking streams of the pool
+  checkCudaError(cudaEventRecord(st->done, 0));
+  checkCudaError(cudaEventSynchronize(st->done));
+  for (int i = 0; i < outputs.size(); i++) {
+    const Tensor* t = p->outputs[i];
+    if (outputs[i] && t && t->device_type() != GPU)
+      t->CopyToHost(outputs[i]);
+  }
+  for (auto* t : p->inputs) {
+    if (t->device_type() != GPU)
+      t->UnbindExternal();
+  }
+  execution_state()->round++;
+  {
+    std::lock_guard<std::mutex> lock(async_mu_);
+    free_staging_.push_back(st);
+  }
+}
+
+std::future<void> SimpleSession::RunAsync(int handle,
+    const vector<void*>& inputs,
+    const vector<void*>& outputs) {
+  CHECK(handle >= 0 && handle < prepared_.size()) << handle;
+  const Prepared* p = prepared_[handle].get();
+  CHECK(inputs.size() == p->inputs.size());
+  CHECK(outputs.size() == p->outputs.size());
+  {
+    std::unique_lock<std::mutex> lock(async_mu_);
+    CHECK(std::this_thread::get_id() != async_worker_.get_id());
+    async_cv_.wait(lock, [this] { return in_flight_ < max_in_flight_; });
+    if (!async_worker_.joinable())
+      async_worker_ = std::thread(&SimpleSession::AsyncLoop, this);
+    in_flight_++;
+  }
+  //sent to the device while the runs before are running
+  Staging* st = StageInputs(p, inputs);
+  std::packaged_task<void()> task([this, handle, st, outputs]() {
+    RunStaged(handle, st, outputs);
+  });
+  std::future<void> done = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(async_mu_);
+    async_queue_.push_back(std::move(task));
+  }
+  async_cv_.notify_all();
+  return done;
+}
+
+void SimpleSession::SetMaxInFlight(int n) {
+  CHECK(n > 0);
+  {
+    std::lock_guard<std::mutex> lock(async_mu_);
+    max_in_flight_ = n;
+  }
+  async_cv_.notify_all();
+}
+
+void SimpleSession::AsyncLoop() {
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(async_mu_);
+      async_cv_.wait(lock, [this] {
+        return async_stop_ || !async_queue_.empty();
+      });
+      if (async_queue_.empty())
+        return;
+      task = std::move(async_queue_.front());
+      async_queue_.pop_front();
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(async_mu_);
+      in_flight_--;
+    }
+    async_cv_.notify_all();
+  }
+}
+
+void SimpleSession::WaitAsync() {
+  std::unique_lock<std::mutex> lock(async_mu_);
+  if (std::this_thread::get_id() == async_worker_.get_id())
+    return;
+  async_cv_.wait(lock, [this] { return in_flight_ == 0; });
+}
+
+void SimpleSession::StopAsync() {
+  {
+    std::lock_guard<std::mutex> lock(async_mu_);
+    async_stop_ = true;
+  }
+  async_cv_.notify_all();
+  if (async_worker_.joinable())
+    async_worker_.join();
+}
+
 void SimpleSession::FeedInput(const vector<string>& input_names,
     const vector<Tensor>& input_tensors) {
   CHECK(input_names.size() == input_tensors.size());
   for (int i = 0; i < input_names.size(); i++) {
-    //const Edge* edge = graph_->FindEdge(input_names[i]);
-    const Edge* edge = s_->FindEdge(input_names[i]);
-    CHECK(edge) << "Edge: " << input_names[i];
-    //Tensor* t = &(tensor_map_[edge->scoped_name()]);
-    Tensor* t = const_cast<Tensor*>(GetTensor(edge->scoped_name()));
+    Tensor* t = const_cast<Tensor*>(FindTensor(input_names[i]));
     CHECK(t) << input_names[i] << "\t" << debug_info();
     if (t->device_type() == GPU) {
       VLOG(V_DEBUG) << "Copying to GPU...";
@@ -131,18 +573,11 @@ void SimpleSession::FetchOutput(const vector<string>& output_names,
     vector<Tensor>* output_tensors) {
   CHECK(output_names.size() == output_tensors->size());
   for (int i = 0; i < output_names.size(); i++) {
+    const Tensor* t = FindTensor(output_names[i]);
     VLOG(V_DEBUG) << "Fetching\t" << output_names[i]
-                  << "\tVirtual?\t"
-                  << s_->FindEdge(output_names[i])->isVirtual();
-    //if (graph_->FindEdge(output_names[i])->isVirtual())
-    if (s_->FindEdge(output_names[i])->isVirtual())
+                  << "\tVirtual?\t" << (t == NULL);
+    if (!t)
       continue;
-    //const Edge* edge = graph_->FindEdge(output_names[i]);
-    const Edge* edge = s_->FindEdge(output_names[i]);
-    CHECK_NOTNULL(edge);
-    const Tensor* t = GetTensor(edge->scoped_name());
-    CHECK(t) << "Getting " << edge->scoped_name()
-             << "\tin\n"   << debug_info();
     if (t->device_type() == GPU) {
       output_tensors->at(i).Rebase(GetAllocator(DeviceTypeToString(CPU)),
           *t);
@@ -153,6 +588,237 @@ void SimpleSession::FetchOutput(const vector<string>& output_names,
   }
 }
 
+void SimpleSession::SavePlan(const vector<string>& output_names,
+    const string& filename) {
+  WaitAsync();
+  const string key = HashString(output_names);
+  if (executors_.find(key) == executors_.end()) {
+    Compile(output_names);
+  }
+  PlanDef plan;
+  for (auto& name : output_names) {
+    plan.add_fetch(name);
+    if (!FindTensor(name))
+      plan.add_virtual_fetch(name);
+  }
+  //the first tensor of a buffer allocates it when loaded,
+  //the others share it
+  std::unordered_map<const void*, string> buffer_owners;
+  set<string> saved;
+  auto save_tensor = [&](const Tensor& t) {
+    if (!saved.insert(t.name()).second)
+      return;
+    PlanDef::TensorDef* def = plan.add_tensor();
+    def->set_name(t.name());
+    for (int i = 0; i < t.dims(); i++)
+      def->mutable_shape()->add_dim(t.dims(i));
+    def->set_dtype(t.data_type());
+    def->set_device(t.device_type());
+    def->set_dynamic(t.IsDynamicShape());
+    def->set_zero_init(t.ZeroInitEnforced());
+    auto iter = buffer_owners.find(BufferOf(t));
+    if (iter == buffer_owners.end()) {
+      buffer_owners.emplace(BufferOf(t), t.name());
+      const size_t element_bytes = (t.count() > 0) ? t.bytes() / t.count() : 1;
+      def->set_buffer_count(std::max<int64_t>(t.debug_size() / element_bytes, t.count()));
+    }else {
+      def->set_buffer_of(iter->second);
+    }
+  };
+  //the blocks of the scoped nodes(the optimizers) with their statements
+  std::function<void(Statement*, PlanDef::StatementDef*)> save_stmt =
+      [&](Statement* stmt, PlanDef::StatementDef* def) {
+    if (MicroBatchBlock* block = dynamic_cast<MicroBatchBlock*>(stmt)) {
+      def->set_micro_batches(block->micro_batches());
+      for (auto* s : block->parts())
+        save_stmt(s, def->add_stmt());
+      return;
+    }
+    if (BasicBlock* block = dynamic_cast<BasicBlock*>(stmt)) {
+      def->set_iter(block->iter());
+      for (auto* s : block->stmts())
+        save_stmt(s, def->add_stmt());
+      return;
+    }
+    CHECK(stmt->type() == Statement::EXPR)
+      << "The plans of the graph statements can not be saved";
+    ExprStatement* expr = dynamic_cast<ExprStatement*>(stmt);
+    OpContext* ctxt = expr->GetContext();
+    *(def->mutable_op()) = expr->GetOp()->op_def();
+    for (int i = 0; i < ctxt->InputSize(); i++) {
+      save_tensor(ctxt->Input(i));
+      def->add_input(ctxt->Input(i).name());
+    }
+    for (int i = 0; i < ctxt->OutputSize(); i++) {
+      save_tensor(*ctxt->Output(i));
+      def->add_output(ctxt->Output(i)->name());
+    }
+  };
+  for (auto* stmt : executors_.at(key))
+    save_stmt(stmt, plan.add_stmt());
+  std::ofstream out(filename, std::ios::binary);
+  CHECK(out.is_open()) << filename;
+  CHECK(plan.SerializeToOstream(&out)) << filename;
+  VLOG(V_DEBUG) << "Saved " << plan.stmt_size() << " statements and "
+                << plan.tensor_size() << " tensors to " << filename;
+}
+
+void SimpleSession::LoadPlan(const string& filename) {
+  WaitAsync();
+  PlanDef plan;
+  {
+    std::ifstream in(filename, std::ios::binary);
+    CHECK(in.is_open()) << filename;
+    CHECK(plan.ParseFromIstream(&in)) << filename;
+  }
+  vector<string> output_names(plan.fetch().begin(), plan.fetch().end());
+  const string key = HashString(output_names);
+  CHECK(executors_.find(key) == executors_.end())
+    << "The outputs have been compiled: " << key;
+
+  std::lock_guard<std::mutex> lock(compile_mutex());
+  //the whole buffers, which the tensors are the views of
+  std::unordered_map<string, Tensor> buffers;
+  for (auto& def : plan.tensor()) {
+    //shared with the plans loaded before
+    if (GetTensor(def.name())) {
+      buffers.emplace(def.name(), *GetTensor(def.name()));
+      continue;
+    }
+    vector<int> dims(def.shape().dim().begin(), def.shape().dim().end());
+    if (def.buffer_of().empty()) {
+      int64_t count = 1;
+      for (int d : dims) count *= d;
+      count = std::max<int64_t>(count, def.buffer_count());
+      buffers.emplace(def.name(), Tensor(def.name(),
+          GetAllocator(DeviceTypeToString(def.device())), def.dtype(),
+          TensorShape(std::vector<int>{static_cast<int>(count)})));
+    }
+    auto buffer = buffers.find(def.buffer_of().empty() ? def.name() : def.buffer_of());
+    CHECK(buffer != buffers.end()) << def.buffer_of();
+    //no larger than the buffer, so it is not reallocated
+    Tensor view(def.name(), buffer->second);
+    view.Resize(TensorShape(dims));
+    InsertTensor(view);
+    Tensor* t = const_cast<Tensor*>(GetTensor(def.name()));
+    if (def.dynamic())   t->SetAsDynamic();
+    if (def.zero_init()) t->SetZeroInitEnforced();
+  }
+  std::function<Statement*(const PlanDef::StatementDef&)> load_stmt =
+      [&](const PlanDef::StatementDef& def) -> Statement* {
+    if (def.micro_batches() > 0) {
+      CHECK(def.stmt_size() == 4) << def.stmt_size();
+      return arena()->New<MicroBatchBlock>(def.micro_batches(),
+          load_stmt(def.stmt(0)), load_stmt(def.stmt(1)),
+          load_stmt(def.stmt(2)), load_stmt(def.stmt(3)));
+    }
+    if (def.iter() > 0) {
+      BasicBlock* block = arena()->New<BasicBlock>(def.iter());
+      for (auto& s : def.stmt())
+        block->AppendStmt(load_stmt(s));
+      return block;
+    }
+    OpImpl* op = CreateOp(def.op(), arena());
+    CHECK(op) << def.op().DebugString();
+    OpContext* ctxt = arena()->New<OpContext>(arena(), execution_state());
+    ctxt->Reserve(def.input_size(), def.output_size());
+    for (auto& name : def.input()) {
+      const Tensor* t = GetTensor(name);
+      CHECK(t) << name;
+      ctxt->AppendInput(t);
+    }
+    for (auto& name : def.output()) {
+      const Tensor* t = GetTensor(name);
+      CHECK(t) << name;
+      ctxt->AppendOutput(const_cast<Tensor*>(t));
+    }
+    ctxt->SetKernelName(def.op().name());
+    return arena()->New<ExprStatement>(op, ctxt);
+  };
+  vector<Statement*>* executor = &executors_[key];
+  for (auto& def : plan.stmt())
+    executor->push_back(load_stmt(def));
+  for (auto& name : plan.virtual_fetch())
+    plan_virtual_fetches_.insert(name);
+  VLOG(V_DEBUG) << "Loaded " << plan.stmt_size() << " statements and "
+                << plan.tensor_size() << " tensors from " << filename;
+}
+
+void SimpleSession::CollectVariables(vector<Statement*>* stmts,
+    vector<const Tensor*>* vars) {
+  std::map<string, std::pair<Statement*, const Tensor*>> found;
+  for (auto& iter : executors_) {
+    for (auto* stmt : iter.second) {
+      if (stmt->type() != Statement::EXPR)
+        continue;
+      ExprStatement* expr = dynamic_cast<ExprStatement*>(stmt);
+      const string& op = expr->GetOp()->op_def().name();
+      if (op == "Variable" || op == "VariableMPI") {
+        const Tensor* t = expr->GetContext()->Output(0);
+        found.emplace(t->name(), std::make_pair(stmt, t));
+      }
+    }
+  }
+  for (auto& iter : found) {
+    if (stmts) stmts->push_back(iter.second.first);
+    vars->push_back(iter.second.second);
+  }
+}
+
+void SimpleSession::CheckMicroBatchBoundary() {
+  std::function<void(Statement*)> check = [&](Statement* stmt) {
+    if (MicroBatchBlock* block = dynamic_cast<MicroBatchBlock*>(stmt)) {
+      CHECK(block->at_boundary())
+        << "The checkpoint is taken in the middle of the "
+        << block->micro_batches() << " micro-batches of a batch";
+    }else if (BasicBlock* block = dynamic_cast<BasicBlock*>(stmt)) {
+      for (auto* s : block->stmts())
+        check(s);
+    }
+  };
+  for (auto& iter : executors_) {
+    for (auto* stmt : iter.second)
+      check(stmt);
+  }
+}
+
+void SimpleSession::SaveCheckpoint(const string& filename, bool async) {
+  //between the iterations
+  WaitAsync();
+  CheckMicroBatchBoundary();
+  checkCudaError(cudaDeviceSynchronize());
+  vector<const Tensor*> vars;
+  CollectVariables(NULL, &vars);
+  CHECK(!vars.empty()) << "No variable is compiled";
+  if (async) {
+    if (!snapshotter_)
+      snapshotter_.reset(new CheckpointSnapshotter());
+    snapshotter_->Snapshot(vars, filename);
+  }else {
+    if (snapshotter_)
+      snapshotter_->Wait();
+    midend::SaveCheckpoint(vars, filename);
+  }
+}
+
+void SimpleSession::RestoreCheckpoint(const string& filename) {
+  WaitAsync();
+  CheckMicroBatchBoundary();
+  vector<Statement*> stmts;
+  vector<const Tensor*> vars;
+  CollectVariables(&stmts, &vars);
+  CHECK(!vars.empty()) << "No variable is compiled";
+  CheckpointReader reader(filename);
+  for (int i = 0; i < vars.size(); i++) {
+    //the variables are initialized only when they first run,
+    //which must not overwrite the restored values
+    stmts[i]->Run();
+    reader.Restore(const_cast<Tensor*>(vars[i]));
+  }
+  checkCudaError(cudaDeviceSynchronize());
+  VLOG(V_DEBUG) << "Restored " << vars.size() << " variables from " << filename;
+}
+
 REGISTER_SESSION_BUILDER("SimpleSession", SimpleSession);
 
 } //namespace midend
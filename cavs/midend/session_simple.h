@@ -4,19 +4,41 @@
 #include "cavs/midend/session_base.h"
 #include "cavs/midend/scope.h"
 #include "cavs/midend/statement.h"
+#include "cavs/midend/dag_executor.h"
+#include "cavs/midend/checkpoint.h"
 
 #include <set>
 #include <list>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 namespace midend {
 
 class SimpleSession : public SessionBase {
  public:
   SimpleSession(int opt);
+  ~SimpleSession();
   void Run(const std::vector<std::string>& output_names, 
            std::vector<Tensor>* output_tensors,
            const std::vector<std::string>& input_names,
            const std::vector<Tensor>& input_tensors) override;
+  int Prepare(const std::vector<std::string>& output_names,
+              const std::vector<std::string>& input_names) override;
+  void RunPrepared(int handle,
+                   const std::vector<void*>& inputs,
+                   std::vector<const void*>* outputs) override;
+  std::future<void> RunAsync(int handle,
+                             const std::vector<void*>& inputs,
+                             const std::vector<void*>& outputs) override;
+  void SetMaxInFlight(int n) override;
+  void SavePlan(const std::vector<std::string>& output_names,
+                const std::string& filename) override;
+  void LoadPlan(const std::string& filename) override;
+  void SaveCheckpoint(const std::string& filename, bool async) override;
+  void RestoreCheckpoint(const std::string& filename) override;
   int session_type() const override { return SIMPLE; }
 
  protected:
@@ -29,7 +51,74 @@ class SimpleSession : public SessionBase {
                    std::list<Node*>* critical_path,
                    std::set<Node*>* include);
   std::string HashString(const std::vector<std::string>& input);
+  //through the graph, or the loaded plans when there is no graph.
+  //NULL for the virtual edges.
+  const Tensor* FindTensor(const std::string& name);
+  DagExecutor* BuildDagExecutor(const std::list<Node*>& critical_path,
+                                const std::vector<Statement*>& stmts);
+  //the statements run by the dag when it is given,
+  //holding the gpu of the process when they launch gpu work
+  void Execute(const std::vector<Statement*>* stmts, DagExecutor* dag);
+  bool OnGPU(const std::vector<Statement*>* stmts);
+  static bool OnGPU(OpContext* ctxt);
   std::unordered_map<std::string, std::vector<Statement*>> executors_;
+  std::unordered_map<std::string, std::unique_ptr<DagExecutor>> dag_executors_;
+  std::unordered_map<const std::vector<Statement*>*, bool> on_gpu_;
+
+  //everything a run needs, looked up once
+  struct Prepared {
+    std::vector<Statement*>* stmts;
+    DagExecutor* dag;
+    std::vector<Tensor*> inputs;
+    //NULL for the virtual outputs
+    std::vector<const Tensor*> outputs;
+    //host copies of the gpu outputs, reused by the runs
+    std::vector<Tensor> mirrors;
+  };
+  std::vector<std::unique_ptr<Prepared>> prepared_;
+  std::unordered_map<std::string, int> handles_;
+  //the virtual fetches of the loaded plans
+  std::set<std::string> plan_virtual_fetches_;
+  //the variable statements of all the compiled outputs, ordered by the names
+  void CollectVariables(std::vector<Statement*>* stmts,
+                        std::vector<const Tensor*>* vars);
+  //the gradients of the micro-batches are not in the checkpoints
+  void CheckMicroBatchBoundary();
+  std::unique_ptr<CheckpointSnapshotter> snapshotter_;
+
+  //The inputs of an asynchronous run, copied into the pinned buffers by the
+  //caller and sent to the device on the copy stream, so that the copy
+  //overlaps the runs before. The run waits for its copy by the event,
+  //and the worker for the run by the other one.
+  struct Staging {
+    std::vector<void*> host;
+    std::vector<void*> device;
+    std::vector<size_t> bytes;
+    cudaEvent_t copied;
+    cudaEvent_t done;
+  };
+  Staging* StageInputs(const Prepared* p, const std::vector<void*>& inputs);
+  void RunStaged(int handle, Staging* st, const std::vector<void*>& outputs);
+  //one per run in flight, reused by the later runs
+  std::vector<std::unique_ptr<Staging>> staging_;
+  std::vector<Staging*> free_staging_;
+  cudaStream_t copy_stream_;
+
+  //the asynchronous runs are done by one thread, so that the variable
+  //updates of a run are seen by the next one, while the caller prepares
+  //the inputs of the next run
+  void AsyncLoop();
+  //waits for the queued runs before running on the caller thread
+  void WaitAsync();
+  void StopAsync();
+  std::deque<std::packaged_task<void()>> async_queue_;
+  std::thread async_worker_;
+  std::mutex async_mu_;
+  std::condition_variable async_cv_;
+  //queued and running
+  int in_flight_;
+  int max_in_flight_;
+  bool async_stop_;
 
  protected:
   const Scope* s_;
@@ -4,8 +4,6 @@
 
 namespace midend {
 
-int Statement::round_ = 0;
-
 void ExprStatement::Run() {
   CHECK(op_);
   CHECK(ctxt_);
@@ -14,24 +12,11 @@ void ExprStatement::Run() {
   VLOG(V_DEBUG)  << "Running Operator " << op_->DebugInfo(V_DEBUG);
   VLOG(V_TIMING) << "--------------------------------------";
   VLOG(V_TIMING) << "Context Info \n"   << ctxt_->debug_info();
-  //for data-dependent variable support(variable and placeholder should have the same batch_id)
-  ctxt_->SetRound(round());
-  VLOG(V_TIMING) << "Setting Round-------------------------";
-  //for function support(the function body should get the offset of the whole buffer)
-  VLOG(V_TIMING) << "Setting Offset------------------------";
-  ctxt_->SetTensorOffset();
-  //for dynamic tensor size support(the tensor size may vary during iterations)
-  //input tensor should also be scaled in the case of the backwarding of skewed tree
-  //when the forward data is reused, it's 1st dimension is the last round dim,
-  //which should be changed from round to round
-  VLOG(V_TIMING) << "Setting Input/Output Tenesor Scale----";
-  ctxt_->ScaleInputTensor();
-  ctxt_->ScaleOutputTensor();
-  //for some gradient tensor, the original value must be set to 0
-  VLOG(V_TIMING) << "Setting Zero--------------------------";
-  ctxt_->SetZero();
-  VLOG(V_TIMING) << "Waiting for inputs--------------------";
-  ctxt_->WaitForEvent();
+  //round for data-dependent variables, offsets for the function body,
+  //the dynamic first dimension, zero-init of the gradients and the events
+  //of the other streams, only for the tensors planned in the context
+  VLOG(V_TIMING) << "Preparing Context---------------------";
+  ctxt_->PrepareRun();
   VLOG(V_TIMING) << "Computing-----------------------------";
 #ifdef CORTEX_TIME_PROFILE
   Timing::TimingBegin("ExecutionCPUTime");
@@ -42,7 +27,7 @@ void ExprStatement::Run() {
 #endif
 
   VLOG(V_TIMING) << "Recording My Event if necessary-------";
-  ctxt_->RecordMyEvent();
+  ctxt_->FinishRun();
   //checkCudaError(cudaDeviceSynchronize());
   VLOG(V_TIMING) << "======================================";
 }
@@ -65,6 +50,15 @@ void GraphStatement::Run() {
   int output_length = gscheduler_->LoadGraph(global_ctxt_->Input(0));
   //LOG(INFO) << "Load graph done...";
   CHECK(output_length > 0);
+  //the ops depending only on the pulled vertices run on all of them at once,
+  //the rounds read their rows like the rows of their own outputs
+  if (!hoisted_.empty()) {
+    global_ctxt_->SetDynDim(output_length);
+    for (auto* stmt : hoisted_) {
+      dynamic_cast<ExprStatement*>(stmt)->GetContext()->ResetTensorOffset();
+      stmt->Run();
+    }
+  }
   //we must clear the dynamic size in case previous ops have changed it;
   //The only case we have to reset the dynamic size is when the previous round sets
   //the dynamic size to a size larger than the gather output capacity,
@@ -82,6 +76,9 @@ void GraphStatement::Run() {
     VLOG(V_DEBUG) << "round: " << round++
       << "\t job_counts:" << gscheduler_->GetJobId().size()
       << "\t job_id :" << gscheduler_->GetJobId()[0];
+    //the rows of the round, also when the gather/pull setting it
+    //is fused into a kernel placed after the other ops of the round
+    global_ctxt_->SetDynDim(gscheduler_->GetJobId().size());
     node_func_->Run();
     gscheduler_->ActivateNext();
   }
@@ -121,11 +118,14 @@ void GraphGradStatement::Run() {
     VLOG(V_DEBUG) << "round: " << round++
       << "\t job_counts:" << gscheduler_->GetJobId().size()
       << "\t job_id :" << gscheduler_->GetJobId()[0];
+    //the rows of the round, also when the gather/pull setting it
+    //is fused into a kernel placed after the other ops of the round
+    global_ctxt_->SetDynDim(gscheduler_->GetJobId().size());
     node_func_->Run();
     gscheduler_->ActivateNext();
   }
 
-  OpContext::SetDynDim(input_length);
+  global_ctxt_->SetDynDim(input_length);
   for (auto* stmt : batch_weight_updates_) {
     dynamic_cast<ExprStatement*>(stmt)->GetContext()->ResetTensorOffset();
     dynamic_cast<ExprStatement*>(stmt)->GetContext()->ScaleInputTensor();
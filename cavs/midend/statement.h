@@ -17,29 +17,27 @@ using ::backend::CreateOp;
 class Statement {
  public:
   enum SType { EXPR = 0, BASICBLOCK = 1, FUNCCALL = 2 };
+  //statements, with their ops and contexts, are owned by the arena
+  //of the session compiling them
+  virtual ~Statement() {}
   virtual void Run() = 0;
   virtual SType type() const = 0;
-  inline static void IncRound() { round_++; }
-
- protected:
-  inline static int round() { return round_; }
-
- private:
-  static int round_;
+  //the contexts of all the expressions it runs
+  virtual void GetContexts(std::vector<OpContext*>* ctxts) const = 0;
 };
 
 class ExprStatement : public Statement {
  public:
   ExprStatement(OpImpl* op, OpContext* ctxt)
     : op_(op), ctxt_(ctxt)/*, custom_p_(NULL)*/ {}
-  ~ExprStatement() {
-    if (op_) free(op_);
-    if (ctxt_) free(ctxt_);
-  }
   SType type() const override { return EXPR; }
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    ctxts->push_back(ctxt_);
+  }
   inline void SetOp(OpImpl* op) { op_ = op; }
   inline void SetContext(OpContext* ctxt) { ctxt_ = ctxt; }
   inline OpContext* GetContext() { return ctxt_; }
+  inline const OpImpl* GetOp() const { return op_; }
   inline std::string debug_info() { return op_->DebugInfo(0); }
 
   void Run() override;
@@ -58,13 +56,6 @@ class BasicBlock : public Statement {
     CHECK(iter > 0) ;
   }
 
-  ~BasicBlock() {
-    for (auto* stmt : stmts_)
-      free(stmt);
-    //if (!init_) free(init_);
-    //if (!finalize_) free(finalize_);
-  }
-
   inline void Run() override {
     VLOG(V_TIMING) << "This Basic Block Begins";
     for (int i = 0; i < iter_; i++) {
@@ -76,12 +67,18 @@ class BasicBlock : public Statement {
     VLOG(V_TIMING) << "This Basic Block Ends";
   }
   SType type() const override { return BASICBLOCK; }
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    for (auto* stmt : stmts_)
+      stmt->GetContexts(ctxts);
+  }
 
   inline Statement* AppendStmt(Statement* stmt) {
     CHECK(stmt);
     stmts_.push_back(stmt); 
     return stmt;
   }
+  inline int iter() const { return iter_; }
+  inline const std::vector<Statement*>& stmts() const { return stmts_; }
 
   friend class ScopedNode;
 
@@ -92,13 +89,57 @@ class BasicBlock : public Statement {
   //std::vector<Statement*> finalize_;
 };
 
-class FunctionCallStatement : public Statement {
+//The body(forward and backward of one micro-batch) runs every time, and its
+//gradients are copied into the accumulators on the first micro-batch of a
+//logical batch and added to them on the others. The update runs once, after
+//the last micro-batch, so the memory is the one of a single micro-batch.
+//The accumulators are not variables, so the checkpoints are only taken
+//between the logical batches.
+class MicroBatchBlock : public Statement {
  public:
-  ~FunctionCallStatement() {
-    if (push_arg_stmt_)   free(push_arg_stmt_);
-    if (pop_ret_stmt_)    free(pop_ret_stmt_);
-    if (global_ctxt_)     free(global_ctxt_);
+  MicroBatchBlock(int micro_batches, Statement* body,
+      Statement* first, Statement* rest, Statement* apply)
+    : micro_batches_(micro_batches), count_(0),
+      body_(body), first_(first), rest_(rest), apply_(apply) {
+    CHECK(micro_batches > 1);
   }
+
+  inline void Run() override {
+    body_->Run();
+    (count_ == 0 ? first_ : rest_)->Run();
+    if (++count_ == micro_batches_) {
+      VLOG(V_DEBUG) << "Applying the gradients of "
+                    << micro_batches_ << " micro-batches";
+      apply_->Run();
+      count_ = 0;
+    }
+  }
+  SType type() const override { return BASICBLOCK; }
+  inline int micro_batches() const { return micro_batches_; }
+  //no gradient is accumulated but not yet applied
+  inline bool at_boundary() const { return count_ == 0; }
+  //the body, first, rest and apply
+  inline std::vector<Statement*> parts() const {
+    return {body_, first_, rest_, apply_};
+  }
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    body_->GetContexts(ctxts);
+    first_->GetContexts(ctxts);
+    rest_->GetContexts(ctxts);
+    apply_->GetContexts(ctxts);
+  }
+
+ private:
+  int micro_batches_;
+  int count_;
+  Statement* body_;
+  Statement* first_;
+  Statement* rest_;
+  Statement* apply_;
+};
+
+class FunctionCallStatement : public Statement {
+ public:
   inline void SetPushArgStatement(ExprStatement* push_arg) {
     push_arg_stmt_ = push_arg; 
   }
@@ -115,6 +156,11 @@ class FunctionCallStatement : public Statement {
     CHECK_NOTNULL(global_ctxt_);
   }
   SType type() const override { return FUNCCALL; }
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    if (global_ctxt_)  ctxts->push_back(global_ctxt_);
+    if (push_arg_stmt_) push_arg_stmt_->GetContexts(ctxts);
+    if (pop_ret_stmt_)  pop_ret_stmt_->GetContexts(ctxts);
+  }
 
  protected:
   FunctionCallStatement()
@@ -131,10 +177,21 @@ class GraphStatement : public FunctionCallStatement {
   GraphStatement(Statement* node_func, GraphSchedulerBase* gs)
     : node_func_(node_func), gscheduler_(gs) {}
   void Run() override;
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    FunctionCallStatement::GetContexts(ctxts);
+    for (auto* stmt : hoisted_)
+      stmt->GetContexts(ctxts);
+    node_func_->GetContexts(ctxts);
+  }
+  //run once on all the vertices before the rounds
+  inline void SetHoisted(std::vector<Statement*>&& hoisted) {
+    hoisted_ = std::move(hoisted);
+  }
 
  protected:
   Statement* node_func_;
   GraphSchedulerBase* gscheduler_;
+  std::vector<Statement*> hoisted_;
 };
 
 class GraphGradStatement : public GraphStatement {
@@ -142,6 +199,11 @@ class GraphGradStatement : public GraphStatement {
   GraphGradStatement(Statement* node_func, GraphSchedulerBase* gs)
     : GraphStatement(node_func, gs), batch_weight_updates_(0) {}
   void Run() override;
+  void GetContexts(std::vector<OpContext*>* ctxts) const override {
+    GraphStatement::GetContexts(ctxts);
+    for (auto* stmt : batch_weight_updates_)
+      stmt->GetContexts(ctxts);
+  }
   inline void SetBatchWeightUpdate(std::vector<Statement*>&& wu) {
     batch_weight_updates_ = std::move(wu);
   }
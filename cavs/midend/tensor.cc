@@ -4,6 +4,8 @@
 #include "cavs/util/macros_gpu.h"
 
 #include <iomanip>
+#include <mutex>
+#include <unordered_set>
 
 using std::string;
 using std::vector;
@@ -31,43 +33,53 @@ template <typename T>
 class TensorBuffer : public TensorBufferBase {
  public:
   TensorBuffer(Allocator* alloc, size_t elem) 
-      : TensorBufferBase(alloc), data_(NULL), elem_(elem) {
-    if (elem_ > 0)
-      data_ = alloc->Allocate<T>(elem_);   
+      : TensorBufferBase(alloc) {
+    if (elem > 0) {
+      data_ = alloc->Allocate<T>(elem);   
+      size_ = elem*sizeof(T);
+    }
+  }
+  ~TensorBuffer() override {
+    UnbindExternal();
+    alloc_->Deallocate<T>(reinterpret_cast<T*>(data_));
   }
-  ~TensorBuffer() override { alloc_->Deallocate<T>(data_); }
-  FORCE_INLINE void* data() const override  { return data_; }
-  FORCE_INLINE size_t size() const override { return elem_*sizeof(T); }
   FORCE_INLINE void InitWithZero() override {
     alloc_->InitWithZero(data(), size());
   }
   FORCE_INLINE void* Resize(size_t size) override { 
     CHECK(size % sizeof(T) == 0);
-    CHECK(size != elem_*sizeof(T));
-    if (data_) { alloc_->Deallocate<T>(data_); }
+    CHECK(size != size_);
+    CHECK(!external_) << "the bound user memory can not be resized";
+    if (data_) { alloc_->Deallocate<T>(reinterpret_cast<T*>(data_)); }
     data_ = alloc_->Allocate<T>(size/sizeof(T));   
-    elem_ = size/sizeof(T);
+    size_ = size;
+    return data_;
   }
 
  private:
-  T* data_;
-  int elem_;
-
   DISALLOW_COPY_AND_ASSIGN(TensorBuffer);
 };
 
+const string* InternTensorName(const string& name) {
+  static std::unordered_set<string>* names = new std::unordered_set<string>();
+  static std::mutex mu;
+  std::lock_guard<std::mutex> lock(mu);
+  return &*(names->insert(name).first);
+}
+
 string TensorShape::debug_info() const {
   string ret; 
-  for (auto& s : shape_)
-    ret += std::to_string(s) + ",";
+  for (int i = 0; i < ndims_; i++)
+    ret += std::to_string(shape_[i]) + ",";
   return ret;
 }
 
 string Tensor::debug_info() const {
   string ret; 
-  ret += "\nname: " + name_;
+  ret += "\nname: " + name();
   ret += "\nshape: " + shape_.debug_info();
-  ret += "\ntype: " + std::to_string(params_->type);
+  if (block_)
+    ret += "\ntype: " + std::to_string(block_->params.type);
   return ret;
 }
 
@@ -95,9 +107,9 @@ void Tensor::DebugNumerical<float>() const {
       L2_norm_unit += res[i]*res[i]; 
       checksum_unit += res[i];
     }
-    VLOG(V_DEBUG) << "pointer-addr:\t" << buf_.get();
-    VLOG(V_DEBUG) << "dynamic: " << params_->dynamic;
-    VLOG(V_DEBUG) << "offset: " << params_->offset;
+    VLOG(V_DEBUG) << "pointer-addr:\t" << buffer();
+    VLOG(V_DEBUG) << "dynamic: " << block_->params.dynamic;
+    VLOG(V_DEBUG) << "offset: " << block_->params.offset;
     VLOG(V_EXHAUSTIVE_DEBUG) << name() << std::setprecision(15)
       << "\tL2 Norm:\t" << L2_norm
       << "\t checksum:\t" << checksum;
@@ -112,47 +124,45 @@ void Tensor::DebugNumerical<float>() const {
   }
 }
 
-Tensor::Tensor() : buf_(nullptr), name_(""), params_(nullptr) {}
+Tensor::Tensor() : block_(NULL), name_(InternTensorName("")) {}
 
 Tensor::Tensor(const string& name, Allocator *a, 
                DataType type, const TensorShape& shape) 
-    : buf_(nullptr), name_(name) {
-  params_.reset(new Params());
-  params_->type = type;
+    : block_(new Block()), name_(InternTensorName(name)) {
+  block_->params.type = type;
   CHECK(shape.dim() > 0);
   if (shape.dim(0) == -1) {
-    params_->dynamic = true;
+    block_->params.dynamic = true;
     shape_ = shape;
-    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0)));
+    CASES(block_->params.type, block_->buf = new TensorBuffer<T>(a, 0));
   }else {
     CHECK(shape.n_elements() > 0);
-    Rebase(a, params_->type, shape);
+    Rebase(a, block_->params.type, shape);
   }
 }
 
 Tensor::Tensor(const string& name, Allocator *a, 
                DataType type, TensorShape&& shape) 
-    : buf_(nullptr), name_(name) {
-  params_.reset(new Params());
-  params_->type = type;
+    : block_(new Block()), name_(InternTensorName(name)) {
+  block_->params.type = type;
   CHECK(shape.dim() > 0);
   if (shape.dim(0) == -1) {
-    params_->dynamic = true;
+    block_->params.dynamic = true;
     shape_ = std::move(shape);
-    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0)));
+    CASES(block_->params.type, block_->buf = new TensorBuffer<T>(a, 0));
   }else {
     CHECK(shape.n_elements() > 0);
-    Rebase(a, params_->type, std::move(shape));
+    Rebase(a, block_->params.type, std::move(shape));
   }
 }
 
 //for sharing buffer operators like reshape
-Tensor::Tensor(const std::string& name, const Tensor& t) {
-  buf_ = t.buf_;
-  name_ = name;
-  shape_  = t.shape_;
-  params_.reset(new Params());
-  params_->type = t.params_->type;
+Tensor::Tensor(const std::string& name, const Tensor& t)
+    : block_(new Block()), shape_(t.shape_), name_(InternTensorName(name)) {
+  CHECK_NOTNULL(t.block_);
+  block_->buf = t.block_->buf;
+  if (block_->buf) block_->buf->Ref();
+  block_->params.type = t.block_->params.type;
   //I don't know whether it is necessary for the followings
   //After one-day debugging, I found assign operator(share memory)
   //lead to one buffer initialized twice. It is a fatal bug.
@@ -160,53 +170,49 @@ Tensor::Tensor(const std::string& name, const Tensor& t) {
   //but the output tensor should have its own behavior.
   //So the following configuration should not be copied
   //Actually, the reset shape is called 
-  //params_->offset = t.params_->offset;
-  //params_->dynamic = t.params_->dynamic;
-  //params_->zero_init_enforced = t.params_->zero_init_enforced;
-  //params_->iteration = t.params_->iteration;
+  //block_->params.offset = t.block_->params.offset;
+  //block_->params.dynamic = t.block_->params.dynamic;
+  //block_->params.zero_init_enforced = t.block_->params.zero_init_enforced;
+  //block_->params.iteration = t.block_->params.iteration;
 } 
 
-Tensor& Tensor::operator =(const Tensor& t) {
-  buf_    = t.buf_;
-  shape_  = t.shape_;
-  name_   = t.name_;
-  params_ = t.params_;
-  return *this;
+//Rebase only happens on the tensors owned by one handle(fetching, buffering),
+//the new block is not seen by the former copies.
+void Tensor::ResetBlock(TensorBufferBase* buf) {
+  Block* b = new Block();
+  if (block_) b->params = block_->params;
+  b->buf = buf;
+  Release();
+  block_ = b;
 }
 
 void Tensor::Rebase(Allocator *a, 
         DataType type, const TensorShape& shape) {
-  //CHECK_NOTNULL(params_.get());
-  if (!params_)  params_.reset(new Params());
-  params_->type = type;
   shape_ = shape;
-  //CASES(type, buf_.reset(new TensorBuffer<T>(a, shape_.n_elements())));
-  CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, shape_.n_elements())));
+  CASES(type, ResetBlock(new TensorBuffer<T>(a, shape_.n_elements())));
+  block_->params.type = type;
 }
 
 void Tensor::Rebase(Allocator *a, 
         DataType type, TensorShape&& shape) {
-  //CHECK_NOTNULL(params_.get());
-  if (!params_)  params_.reset(new Params());
-  params_->type = type;
   shape_ = std::move(shape);
-  //CASES(type, buf_.reset(new TensorBuffer<T>(a, shape_.n_elements())));
-  CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, shape_.n_elements())));
+  CASES(type, ResetBlock(new TensorBuffer<T>(a, shape_.n_elements())));
+  block_->params.type = type;
 }
 
 void Tensor::Rebase(Allocator *a, const Tensor& t) {
-  CHECK_NOTNULL(t.params_.get());
-  Rebase(a, t.params_->type, t.shape_);
+  CHECK_NOTNULL(t.block_);
+  Rebase(a, t.block_->params.type, t.shape_);
 }
 
 void Tensor::Reshape(const TensorShapeDef& shape) {
   CHECK(shape.dim_size() > 0);
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   int new_counts = 1;
   for (auto& dim : shape.dim())
     new_counts *= dim;
   if (shape.dim(0) == -1) {
-    params_->dynamic = true;
+    block_->params.dynamic = true;
   }else {
     CHECK(new_counts == count())
       << new_counts << "\t" << count() << name();
@@ -214,19 +220,19 @@ void Tensor::Reshape(const TensorShapeDef& shape) {
   //if (new_counts != count()) {
     //CHECK(shape.dim(0) == -1) << new_counts << "\tvs\t" << count();
     ////dynamic_ = true;
-    //params_->dynamic = true;
+    //block_->params.dynamic = true;
   //}
   shape_ = TensorShape(shape);
 }
 
 void Tensor::Reshape(const vector<int>& dims) {
   CHECK(!dims.empty());
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   int new_counts = 1;
   for (auto& dim : dims)
     new_counts *= dim;
   if (dims[0] == -1) {
-    params_->dynamic = true;
+    block_->params.dynamic = true;
   }else {
     CHECK(new_counts == count());
   }
@@ -236,9 +242,9 @@ void Tensor::Reshape(const vector<int>& dims) {
 }
 
 void Tensor::Reshape(const Tensor& t) {
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   if (t.dims(0) == -1) {
-    params_->dynamic = true;
+    block_->params.dynamic = true;
   }else {
     CHECK(t.count() == count());
   }
@@ -246,66 +252,67 @@ void Tensor::Reshape(const Tensor& t) {
 }
 
 void Tensor::Resize(const TensorShape& shape) {
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   if (shape.n_elements() > count()) {
     size_t new_size = shape.n_elements();
-    CASES(params_->type, new_size *= sizeof(T));
-    CHECK_NOTNULL(buf_.get());
-    buf_->Resize(new_size);
+    CASES(block_->params.type, new_size *= sizeof(T));
+    CHECK_NOTNULL(block_->buf);
+    block_->buf->Resize(new_size);
   }
   shape_ = shape;
 }
 
 bool Tensor::ScaleDynamicDimension(int new_dim) {
-  CHECK_NOTNULL(params_.get());
-  CHECK(params_->dynamic);
+  CHECK_NOTNULL(block_);
+  CHECK(block_->params.dynamic);
   int old_dim = shape_.dim(0);
   shape_.SetDim(0, new_dim);   
   size_t new_size = shape_.n_elements();
-  CASES(params_->type, new_size *= sizeof(T));
-  if (old_dim < new_dim && buf_->size() < new_size) {
-    CHECK_NOTNULL(buf_.get());
+  CASES(block_->params.type, new_size *= sizeof(T));
+  if (old_dim < new_dim && block_->buf->size() < new_size) {
+    CHECK_NOTNULL(block_->buf);
     //VLOG(V_DEBUG) << "Resizing " << new_size << " Bytes";
-    buf_->Resize(new_size);
+    block_->buf->Resize(new_size);
   }
+  return old_dim != new_dim;
 }
 
 void Tensor::SetZeroInitEnforced() {
-  CHECK_NOTNULL(params_.get());
-  params_->zero_init_enforced = true;
+  CHECK_NOTNULL(block_);
+  block_->params.zero_init_enforced = true;
 }
 
 bool Tensor::ZeroInitEnforced() const {
-  CHECK_NOTNULL(params_.get());
-  return params_->zero_init_enforced;
+  CHECK_NOTNULL(block_);
+  return block_->params.zero_init_enforced;
 }
 
 bool Tensor::InitWithZero(int iteration) {
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   CHECK(ZeroInitEnforced());
   size_t visable_size = count();
-  CASES(params_->type, visable_size *= sizeof(T));
-  if (params_->iteration == iteration-1) {
-    buf_->InitWithZero();
-    params_->iteration++;
-    VLOG(V_DEBUG) << "Setting Zero for " << name() << " in round " << params_->iteration;
+  CASES(block_->params.type, visable_size *= sizeof(T));
+  if (block_->params.iteration == iteration-1) {
+    block_->buf->InitWithZero();
+    block_->params.iteration++;
+    VLOG(V_DEBUG) << "Setting Zero for " << name() << " in round " << block_->params.iteration;
     return true;
-  }else if (params_->iteration == iteration) {
-    VLOG(V_DEBUG) << "Has been Set Zero " << name() << " in round " << params_->iteration;
+  }else if (block_->params.iteration == iteration) {
+    VLOG(V_DEBUG) << "Has been Set Zero " << name() << " in round " << block_->params.iteration;
     return false;
   }else {
     LOG(FATAL) <<  "Illegal iteration: "
-               << params_->iteration << " vs " << iteration;
+               << block_->params.iteration << " vs " << iteration;
   }
 }
 
 bool Tensor::IsFullShape() const {
-  CHECK_NOTNULL(params_.get());
+  CHECK_NOTNULL(block_);
   size_t visable_size = count();
-  CASES(params_->type, visable_size *= sizeof(T));
-  CHECK_NOTNULL(buf_.get());
-  //CHECK(buf_->size() % visable_size == 0);
-  return buf_->size() == visable_size;
+  CASES(block_->params.type, visable_size *= sizeof(T));
+  CHECK_NOTNULL(block_->buf);
+  //CHECK(block_->buf->size() % visable_size == 0);
+  return block_->buf->size() == visable_size;
 }
 
 void Tensor::SetOffsetWithId(int id) {
@@ -313,41 +320,85 @@ void Tensor::SetOffsetWithId(int id) {
   CHECK(IsDynamicShape());
   CHECK(dims() > 1);
   size_t unit = count()/dims(0);
-  CASES(params_->type, unit *= sizeof(T));
+  CASES(block_->params.type, unit *= sizeof(T));
   size_t offset = unit*id; 
-  CHECK(offset < buf_->size())
-    << id  << "\t" << unit << "\t" << buf_->size() << debug_info();
-  params_->offset = offset;
+  CHECK(offset < block_->buf->size())
+    << id  << "\t" << unit << "\t" << block_->buf->size() << debug_info();
+  block_->params.offset = offset;
 }
 
 
 void Tensor::SyncWith(const Tensor& t) {
   //CHECK(t.device_type() != device_type());
-  CHECK(t.buf_ && buf_);
+  CHECK(t.buffer() && buffer());
   CHECK(t.shape_.n_elements() > 0 && shape_.n_elements() > 0);
   size_t size = count();
-  CHECK_NOTNULL(params_.get());
-  CASES(params_->type, size*= sizeof(T));
-  CHECK(size <= t.buf_->size());
+  CHECK_NOTNULL(block_);
+  CASES(block_->params.type, size*= sizeof(T));
+  CHECK(size <= t.block_->buf->size());
   //cudaMemcpyDefault can remove such a complexity
   //but for development, specified it clearly is better.
   if (t.device_type() == CPU && device_type() == GPU) {
-    //checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   //t.buf_->size(), cudaMemcpyHostToDevice));
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
+    //checkCudaError(cudaMemcpy(block_->buf->data(), t.block_->buf->data(), 
+                   //t.block_->buf->size(), cudaMemcpyHostToDevice));
+    checkCudaError(cudaMemcpy(block_->buf->data(), t.block_->buf->data(), 
                    size, cudaMemcpyHostToDevice));
   }else if (t.device_type() == GPU && device_type() == CPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
+    checkCudaError(cudaMemcpy(block_->buf->data(), t.block_->buf->data(), 
                    size, cudaMemcpyDeviceToHost));
   }else if (t.device_type() == CPU && device_type() == CPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
+    checkCudaError(cudaMemcpy(block_->buf->data(), t.block_->buf->data(), 
                    size, cudaMemcpyHostToHost));
   }else if (t.device_type() == GPU && device_type() == GPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
+    checkCudaError(cudaMemcpy(block_->buf->data(), t.block_->buf->data(), 
                    size, cudaMemcpyDeviceToDevice));
   }else{
     LOG(FATAL) << "which device on earth?";
   }
 }
 
+size_t Tensor::bytes() const {
+  CHECK_NOTNULL(block_);
+  size_t size = count();
+  CASES(block_->params.type, size *= sizeof(T));
+  return size;
+}
+
+void Tensor::SyncWithHost(const void* data) {
+  CHECK(buffer() && data);
+  size_t size = count();
+  CASES(block_->params.type, size *= sizeof(T));
+  CHECK(size + block_->params.offset <= block_->buf->size());
+  if (device_type() == GPU) {
+    checkCudaError(cudaMemcpy(mutable_data<char>(), data, size,
+                              cudaMemcpyHostToDevice));
+  }else if (mutable_data<char>() != data) {
+    memcpy(mutable_data<char>(), data, size);
+  }
+}
+
+void Tensor::CopyToHost(void* data) const {
+  CHECK(buffer() && data);
+  size_t size = count();
+  CASES(block_->params.type, size *= sizeof(T));
+  if (device_type() == GPU) {
+    checkCudaError(cudaMemcpy(data, this->data<char>(), size,
+                              cudaMemcpyDeviceToHost));
+  }else if (this->data<char>() != data) {
+    memcpy(data, this->data<char>(), size);
+  }
+}
+
+void Tensor::BindExternal(void* data) {
+  CHECK(buffer() && data);
+  CHECK(device_type() == CPU) << name() << " is not on the host";
+  CHECK(block_->params.offset == 0) << name();
+  block_->buf->BindExternal(data);
+}
+
+void Tensor::UnbindExternal() {
+  if (buffer())
+    block_->buf->UnbindExternal();
+}
+
 } //namespace midend
@@ -9,30 +9,61 @@
 
 #include <vector>
 #include <string>
-#include <memory>
+#include <atomic>
 
 
 namespace midend {
 
 //data
+//The buffer is reference counted intrusively,
+//because it may be shared by several tensors(the share-memory operators).
+//data_ and size_ are kept in the base class,
+//so reading them does not go through the virtual table.
 class TensorBufferBase {
  public:
-  TensorBufferBase(Allocator* alloc) : alloc_(alloc) {}
+  TensorBufferBase(Allocator* alloc)
+    : alloc_(alloc), data_(NULL), size_(0), owned_(NULL), external_(false), ref_(1) {}
   FORCE_INLINE DeviceType device_type() const { return alloc_->type(); }
   virtual ~TensorBufferBase() {}
-  virtual void* data()  const = 0;
-  virtual size_t size() const = 0;
+  FORCE_INLINE void* data()  const { return data_; }
+  FORCE_INLINE size_t size() const { return size_; }
   virtual void InitWithZero() = 0;
   virtual void* Resize(size_t size) = 0;
+  //user memory takes the place of the buffer(zero-copy feeding),
+  //the handles sharing the buffer all see it
+  FORCE_INLINE void BindExternal(void* data) {
+    if (!external_) owned_ = data_;
+    external_ = true;
+    data_ = data;
+  }
+  FORCE_INLINE void UnbindExternal() {
+    if (external_) data_ = owned_;
+    external_ = false;
+  }
+  FORCE_INLINE bool IsExternal() const { return external_; }
+  FORCE_INLINE void Ref() { ref_.fetch_add(1, std::memory_order_relaxed); }
+  FORCE_INLINE void Unref() {
+    if (ref_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete this;
+  }
 
  protected:
   Allocator* const alloc_;
+  void* data_;
+  size_t size_;
+  void* owned_;
+  bool external_;
+
+ private:
+  std::atomic<int> ref_;
 };
 
 //metadata
+//the dimensions are stored inline, so copying a shape never touches the heap
 class TensorShape {
  public:
-  TensorShape() : n_elements_(0), shape_(0) {}
+  static const int kMaxDims = 8;
+  TensorShape() : n_elements_(0), ndims_(0) {}
   explicit TensorShape(const TensorShapeDef& shape);
   explicit TensorShape(const std::vector<int>& shape);
   explicit TensorShape(const TensorShape& shape);
@@ -40,14 +71,14 @@ class TensorShape {
   TensorShape& operator =(const TensorShape& b);
   TensorShape& operator =(TensorShape&& b);
   FORCE_INLINE int n_elements() const { return n_elements_; }
-  FORCE_INLINE int dim() const { return shape_.size(); }
+  FORCE_INLINE int dim() const { return ndims_; }
   FORCE_INLINE int dim(unsigned idx) const {
-    CHECK(idx < shape_.size()) << idx << "\t" << shape_.size();
-    return shape_.at(idx); 
+    CHECK(idx < ndims_) << idx << "\t" << ndims_;
+    return shape_[idx]; 
   }
   FORCE_INLINE TensorShapeDef to_def() const {
     TensorShapeDef def;
-    for (int s : shape_)  def.add_dim(s);
+    for (int i = 0; i < ndims_; i++)  def.add_dim(shape_[i]);
     return def;
   }
   void SetDim(int d, int size);
@@ -55,10 +86,14 @@ class TensorShape {
   std::string debug_info() const;
 
  private:
-  std::vector<int> shape_;
+  int shape_[kMaxDims];
+  int ndims_;
   int n_elements_;
 };
 
+//tensor names are interned, a tensor only keeps a pointer to its name
+const std::string* InternTensorName(const std::string& name);
+
 class TensorCApi;
 class Tensor {
  public:
@@ -66,20 +101,27 @@ class Tensor {
   Tensor(const std::string& name, Allocator *a, DataType type, const TensorShape& shape);
   Tensor(const std::string& name, Allocator *a, DataType type, TensorShape&& shape);
   Tensor(const std::string& name, const Tensor& t);
-  Tensor(const Tensor& t) { *this = t; }
+  Tensor(const Tensor& t);
+  Tensor(Tensor&& t);
+  ~Tensor();
   Tensor& operator =(const Tensor& t);
+  Tensor& operator =(Tensor&& t);
 
-  inline DeviceType device_type() const { return buf_->device_type(); }
-  inline std::string name()       const { return name_;               }
-  inline bool empty()             const { return buf_ == nullptr;     }
-  inline bool IsDynamicShape()    const { return params_->dynamic;    }
-  inline DataType data_type()     const { return params_->type;       }
-  inline void SetAsDynamic()            { params_->dynamic = true;    }
+  inline DeviceType device_type() const { return block_->buf->device_type(); }
+  inline const std::string& name() const { return *name_;               }
+  inline bool empty()             const { return !block_ || !block_->buf; }
+  inline bool IsDynamicShape()    const { return block_->params.dynamic;    }
+  inline DataType data_type()     const { return block_->params.type;       }
+  inline void SetAsDynamic()            { block_->params.dynamic = true;    }
+  inline bool IsStashed()         const { return block_->params.stashed;    }
+  inline void SetAsStashed()            { block_->params.stashed = true;    }
   //for opeators
   inline int count()         const { return shape_.n_elements(); }
   inline int dims()          const { return shape_.dim();        }
   inline int dims(int idx)   const { return shape_.dim(idx);     }
-  inline size_t debug_size() const { return buf_->size();        }
+  inline size_t debug_size() const { return block_->buf->size(); }
+  //of the count() elements
+  size_t bytes() const;
 
   //allocate a new buffer
   void Rebase(Allocator *a, DataType type, const TensorShape& shape);
@@ -94,11 +136,11 @@ class Tensor {
   bool ScaleDynamicDimension(int new_dim);
   template <typename T>
     T* mutable_data() const {
-      return reinterpret_cast<T*>((char*)(buf_->data()) + params_->offset); 
+      return reinterpret_cast<T*>((char*)(block_->buf->data()) + block_->params.offset); 
   }
   template <typename T>
     const T* data() const {
-      return reinterpret_cast<T*>((char*)(buf_->data()) + params_->offset); 
+      return reinterpret_cast<T*>((char*)(block_->buf->data()) + block_->params.offset); 
   }
 
   void SetZeroInitEnforced();
@@ -109,6 +151,12 @@ class Tensor {
 
   //bool ShareBufWith(const Tensor& t);
   void SyncWith(const Tensor& t);
+  //count() elements from/to the host memory
+  void SyncWithHost(const void* data);
+  void CopyToHost(void* data) const;
+  //only for the cpu tensors, the user memory must hold count() elements
+  void BindExternal(void* data);
+  void UnbindExternal();
 
   std::string debug_info() const;
   template <typename T>
@@ -119,7 +167,7 @@ class Tensor {
 
   struct Params {
     Params() : type(DataType(0)), offset(0), dynamic(false),
-               zero_init_enforced(false), iteration(0) {}
+               zero_init_enforced(false), iteration(0), stashed(false) {}
     DataType type;
     size_t offset;
     //dynamic is used in two cases:
@@ -130,18 +178,41 @@ class Tensor {
     bool dynamic;
     bool zero_init_enforced;
     int iteration;
+    //stashed means the buffer only holds the current round,
+    //the former rounds are kept by an ActivationStash
+    bool stashed;
   };
 
  private:
-  std::shared_ptr<TensorBufferBase> buf_;
-  std::shared_ptr<Params> params_;
+  //The copies of a tensor share one block, which holds the params and
+  //a reference of the buffer. So a copy only increases one counter.
+  struct Block {
+    Block() : buf(NULL), ref(1) {}
+    ~Block() { if (buf) buf->Unref(); }
+    TensorBufferBase* buf;
+    Params params;
+    std::atomic<int> ref;
+  };
+  FORCE_INLINE TensorBufferBase* buffer() const {
+    return block_ ? block_->buf : NULL;
+  }
+  FORCE_INLINE void Release() {
+    if (block_ && block_->ref.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      delete block_;
+    block_ = NULL;
+  }
+  //a new block keeps the params of the current one
+  void ResetBlock(TensorBufferBase* buf);
+
+  Block* block_;
   TensorShape shape_;
-  std::string name_;
+  const std::string* name_;
 };
 
 FORCE_INLINE TensorShape::TensorShape(const TensorShapeDef& shape) {
   CHECK(shape.dim_size() > 0);
-  shape_.resize(shape.dim_size());
+  CHECK(shape.dim_size() <= kMaxDims) << shape.DebugString();
+  ndims_ = shape.dim_size();
   n_elements_ = 1;    
   for (int idx = 0; idx < shape.dim_size(); idx++) {
     CHECK(shape.dim(idx) != 0);
@@ -151,12 +222,14 @@ FORCE_INLINE TensorShape::TensorShape(const TensorShapeDef& shape) {
 }
 
 //mainly for test usage
-FORCE_INLINE TensorShape::TensorShape(const std::vector<int>& shape) 
-    : shape_(shape) {
+FORCE_INLINE TensorShape::TensorShape(const std::vector<int>& shape) {
+  CHECK(shape.size() <= kMaxDims) << shape.size();
+  ndims_ = shape.size();
   n_elements_ = 1;    
-  for (int dim : shape) {
-    CHECK(dim != 0);
-    n_elements_ *= dim; 
+  for (int idx = 0; idx < ndims_; idx++) {
+    CHECK(shape[idx] != 0);
+    shape_[idx] = shape[idx];
+    n_elements_ *= shape[idx]; 
   }
 }
 
@@ -165,20 +238,19 @@ FORCE_INLINE TensorShape::TensorShape(const TensorShape& shape) {
 }
 
 FORCE_INLINE TensorShape::TensorShape(TensorShape&& shape) {
-  n_elements_ = shape.n_elements_;
-  shape_ = std::move(shape.shape_);
+  *this = shape;
 }
 
 FORCE_INLINE TensorShape& TensorShape::operator =(const TensorShape& b) {
   n_elements_ = b.n_elements_;
-  shape_ = b.shape_;
+  ndims_ = b.ndims_;
+  for (int i = 0; i < ndims_; i++)
+    shape_[i] = b.shape_[i];
   return *this;
 }
 
 FORCE_INLINE TensorShape& TensorShape::operator =(TensorShape&& b) {
-  n_elements_ = b.n_elements_;
-  shape_ = std::move(b.shape_);
-  return *this;
+  return *this = b;
 }
 
 FORCE_INLINE void TensorShape::SetDim(int d, int size) {
@@ -190,11 +262,48 @@ FORCE_INLINE void TensorShape::SetDim(int d, int size) {
 
 FORCE_INLINE void TensorShape::AddDim(int size) {
   CHECK(size != 0);
-  shape_.push_back(size);
+  CHECK(ndims_ < kMaxDims);
+  shape_[ndims_++] = size;
   if (0 == n_elements_) n_elements_ = 1;
   n_elements_ *= size;
 }
 
+FORCE_INLINE Tensor::Tensor(const Tensor& t)
+    : block_(t.block_), shape_(t.shape_), name_(t.name_) {
+  if (block_) block_->ref.fetch_add(1, std::memory_order_relaxed);
+}
+
+FORCE_INLINE Tensor::Tensor(Tensor&& t)
+    : block_(t.block_), shape_(t.shape_), name_(t.name_) {
+  t.block_ = NULL;
+}
+
+FORCE_INLINE Tensor::~Tensor() {
+  Release();
+}
+
+FORCE_INLINE Tensor& Tensor::operator =(const Tensor& t) {
+  if (block_ != t.block_) {
+    if (t.block_) t.block_->ref.fetch_add(1, std::memory_order_relaxed);
+    Release();
+    block_ = t.block_;
+  }
+  shape_ = t.shape_;
+  name_  = t.name_;
+  return *this;
+}
+
+FORCE_INLINE Tensor& Tensor::operator =(Tensor&& t) {
+  if (this != &t) {
+    Release();
+    block_ = t.block_;
+    t.block_ = NULL;
+    shape_ = t.shape_;
+    name_  = t.name_;
+  }
+  return *this;
+}
+
 } //namespace midend 
 
 #endif
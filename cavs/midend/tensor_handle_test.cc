@@ -0,0 +1,81 @@
+#include "cavs/midend/tensor.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+
+#include <chrono>
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace midend;
+
+template <typename FUNC>
+double NanoSecondsPerIter(int iters, FUNC f) {
+  auto start = chrono::high_resolution_clock::now();
+  for (int i = 0; i < iters; i++)
+    f(i);
+  auto end = chrono::high_resolution_clock::now();
+  return chrono::duration<double, nano>(end - start).count() / iters;
+}
+
+int main() {
+  Allocator* alloc = GetAllocator(DeviceTypeToString(CPU));
+  CHECK_NOTNULL(alloc);
+  Tensor t("Node:Node:lstm_cell_output", alloc, DT_FLOAT, TensorShape(vector<int>{256, 4, 150}));
+  t.SetAsDynamic();
+
+  //copies share the buffer and the params
+  {
+    Tensor copy(t);
+    CHECK(copy.data<float>() == t.data<float>());
+    CHECK(copy.name() == t.name());
+    CHECK(&copy.name() == &t.name());
+    copy.SetOffsetWithId(3);
+    CHECK(t.data<float>() == copy.data<float>());
+    t.SetOffsetWithId(0);
+    Tensor moved(std::move(copy));
+    CHECK(moved.data<float>() == t.data<float>());
+  }
+  //share-memory tensors share the buffer only
+  {
+    Tensor shared("Node:Node:reshape", t);
+    shared.Reshape(vector<int>{256, 600});
+    CHECK(shared.data<float>() == t.data<float>());
+    CHECK(t.dims() == 3 && shared.dims() == 2);
+  }
+  //rebase detaches the handle
+  {
+    Tensor fetched;
+    fetched.Rebase(alloc, t);
+    CHECK(fetched.data<float>() != t.data<float>());
+    CHECK(fetched.count() == t.count());
+  }
+
+  //microbenchmark of the handle operations in the hot paths
+  const int iters = 1 << 22;
+  vector<Tensor> tensors(16);
+  TensorShapeDef flat, cube;
+  flat.add_dim(256); flat.add_dim(600);
+  cube.add_dim(256); cube.add_dim(4); cube.add_dim(150);
+  double copy_ns = NanoSecondsPerIter(iters, [&](int i) { tensors[i & 15] = t; });
+  double copy_ctor_ns = NanoSecondsPerIter(iters, [&](int i) {
+    Tensor copy(t);
+    tensors[i & 15].Reshape(copy);
+  });
+  double reshape_ns = NanoSecondsPerIter(iters, [&](int i) {
+    tensors[i & 15].Reshape((i & 1) ? flat : cube);
+  });
+  double offset_ns = NanoSecondsPerIter(iters, [&](int i) { t.SetOffsetWithId(i & 255); });
+  size_t read = 0;
+  double name_count_ns = NanoSecondsPerIter(iters, [&](int i) {
+    read += tensors[i & 15].name().size() + tensors[i & 15].count();
+  });
+  CHECK(read > 0);
+
+  LOG(INFO) << "copy assign:\t"      << copy_ns      << " ns";
+  LOG(INFO) << "copy construct:\t"   << copy_ctor_ns << " ns";
+  LOG(INFO) << "reshape:\t"          << reshape_ns   << " ns";
+  LOG(INFO) << "SetOffsetWithId:\t"  << offset_ns    << " ns";
+  LOG(INFO) << "name()+count():\t"   << name_count_ns << " ns";
+  return 0;
+}
@@ -44,6 +44,13 @@ OpDefBuilder& OpDefBuilder::Device(const string& dev) {
     op_def_.set_device(GPU);
   else 
     op_def_.set_device(CPU);
+  //such as "CPU_NUMA0", which names the allocator of the device
+  if (dev != "GPU" && dev != "CPU") {
+    CHECK(dev.compare(0, 3, "CPU") == 0) << "Unknown device: " << dev;
+    OpDef::AttrDef *attr = op_def_.add_attr();
+    attr->set_name("Allocator");
+    attr->mutable_value()->set_s(dev);
+  }
   return *this;
 }
 
@@ -6,5 +6,13 @@ int main() {
   OpDefBuilder("Add").Input("A").Input("B").Output("C").Device("GPU")
       .Finalize(&op_def);
   LOG(INFO) << "\n" << op_def.DebugString();
+
+  OpDef numa_def;
+  OpDefBuilder("Placeholder").Output("A").Shape({2, 3}).Device("CPU_NUMA0")
+      .Finalize(&numa_def);
+  CHECK(numa_def.device() == CPU);
+  CHECK(numa_def.attr_size() == 1 && numa_def.attr(0).name() == "Allocator");
+  CHECK(numa_def.attr(0).value().s() == "CPU_NUMA0");
+  LOG(INFO) << "\n" << numa_def.DebugString();
   return 0;
 }
@@ -33,6 +33,23 @@ size_t GetHash(const OpDef& op_def) {
   return hash_fn(s);
 }
 
+uint64_t GetStableHash(const string& s) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+string HashToString(uint64_t hash) {
+  static const char digits[] = "0123456789abcdef";
+  string ret(16, '0');
+  for (int i = 15; i >= 0; i--, hash >>= 4)
+    ret[i] = digits[hash & 0xf];
+  return ret;
+}
+
 bool IsVariableName(const string& edge) {
   return (edge.length() >= 8 && edge.substr(0, 8) == "Variable")
       || (edge.length() >= 3 && edge.substr(0, 3) == "DDV" );
@@ -1,5 +1,6 @@
 #include "cavs/proto/op_def.pb.h"
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -19,6 +20,9 @@ std::string GetOriginName(const std::string& op);
 const char* DeviceTypeToString(DeviceType type);
 
 size_t GetHash(const OpDef& op_def);
+//the same in every process and build(FNV-1a), for the names kept on disk
+uint64_t GetStableHash(const std::string& s);
+std::string HashToString(uint64_t hash);
 
 bool IsVariableName(const std::string& edge);
 bool IsGradientName(const std::string& edge);
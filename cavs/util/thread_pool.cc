@@ -0,0 +1,235 @@
+#include "cavs/util/thread_pool.h"
+#include "cavs/util/logging.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <sstream>
+
+using std::string;
+
+namespace {
+
+struct CurrentWorker {
+  const ThreadPool* pool;
+  int id;
+};
+thread_local CurrentWorker current_worker = {NULL, -1};
+
+//scheduling a shard costs a few microseconds
+const double kMinShardCost = 10000;
+//more shards than threads balance the uneven ones
+const int kShardsPerThread = 4;
+
+struct GlobalConfig {
+  int num_threads;
+  bool pin;
+  bool created;
+};
+GlobalConfig* global_config() {
+  static GlobalConfig config = {
+    (int)std::max(1u, std::thread::hardware_concurrency()), false, false};
+  return &config;
+}
+
+struct CounterRegistry {
+  std::mutex mu;
+  std::map<string, std::unique_ptr<ThreadPool::KernelCounters>> counters;
+};
+CounterRegistry* counter_registry() {
+  static CounterRegistry registry;
+  return &registry;
+}
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} //namespace
+
+ThreadPool::ThreadPool(int num_threads, bool pin)
+    : pending_(0), next_(0), stop_(false) {
+  CHECK(num_threads > 0);
+  for (int i = 0; i < num_threads; i++)
+    workers_.emplace_back(new Worker());
+  for (int i = 0; i < num_threads; i++) {
+    workers_[i]->thread = std::thread(&ThreadPool::Loop, this, i);
+    if (pin) Pin(i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& w : workers_)
+    w->thread.join();
+}
+
+ThreadPool* ThreadPool::Get() {
+  static ThreadPool pool(
+      (global_config()->created = true, global_config()->num_threads),
+      global_config()->pin);
+  return &pool;
+}
+
+void ThreadPool::Configure(int num_threads, bool pin) {
+  CHECK(!global_config()->created)
+    << "the thread pool must be configured before it is used";
+  CHECK(num_threads > 0);
+  global_config()->num_threads = num_threads;
+  global_config()->pin = pin;
+}
+
+ThreadPool::KernelCounters* ThreadPool::Counters(const string& kernel) {
+  CounterRegistry* r = counter_registry();
+  std::lock_guard<std::mutex> lock(r->mu);
+  auto& c = r->counters[kernel];
+  if (!c) c.reset(new KernelCounters());
+  return c.get();
+}
+
+string ThreadPool::UtilizationInfo() {
+  CounterRegistry* r = counter_registry();
+  std::ostringstream os;
+  os << "kernel\tcalls\tshards/call\tutilization\n";
+  std::lock_guard<std::mutex> lock(r->mu);
+  for (auto& iter : r->counters) {
+    const KernelCounters* c = iter.second.get();
+    if (c->calls == 0) continue;
+    double util = (c->wall_ns > 0) ?
+      (double)c->busy_ns / ((double)c->wall_ns * Get()->NumThreads()) : 0;
+    os << iter.first << "\t" << c->calls << "\t"
+       << (double)c->shards / c->calls << "\t" << util << "\n";
+  }
+  return os.str();
+}
+
+int ThreadPool::CurrentThreadId() const {
+  return (current_worker.pool == this) ? current_worker.id : -1;
+}
+
+int64_t ThreadPool::GrainSize(int64_t total, double cost_per_unit, int num_threads) {
+  CHECK(cost_per_unit > 0);
+  int64_t grain = std::max<int64_t>(1, kMinShardCost / cost_per_unit);
+  int64_t max_shards = (int64_t)num_threads * kShardsPerThread;
+  return std::max(grain, (total + max_shards - 1) / max_shards);
+}
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end, int64_t grain,
+    const std::function<void(int64_t, int64_t)>& fn, KernelCounters* counters) {
+  if (end <= begin)
+    return;
+  grain = std::max<int64_t>(grain, 1);
+  const int64_t shards = (end - begin + grain - 1) / grain;
+  const int64_t start = counters ? NowNs() : 0;
+  if (shards == 1 || NumThreads() == 1) {
+    fn(begin, end);
+  }else {
+    //the tasks may still hold the state after the caller returns
+    struct State {
+      std::atomic<int64_t> next;
+      std::atomic<int64_t> done;
+      std::mutex mu;
+      std::condition_variable cv;
+    };
+    std::shared_ptr<State> state(new State());
+    state->next = 0;
+    state->done = 0;
+    auto run_shards = [=, &fn]() {
+      int64_t i;
+      while ((i = state->next++) < shards) {
+        int64_t shard_start = counters ? NowNs() : 0;
+        fn(begin + i*grain, std::min(end, begin + (i+1)*grain));
+        if (counters) counters->busy_ns += NowNs() - shard_start;
+        if (++state->done == shards) {
+          std::lock_guard<std::mutex> lock(state->mu);
+          state->cv.notify_all();
+        }
+      }
+    };
+    int helpers = std::min<int64_t>(shards-1, NumThreads());
+    for (int i = 0; i < helpers; i++)
+      Schedule(run_shards);
+    run_shards();
+    std::unique_lock<std::mutex> lock(state->mu);
+    state->cv.wait(lock, [&] { return state->done == shards; });
+  }
+  if (counters) {
+    counters->calls++;
+    counters->shards += shards;
+    counters->wall_ns += NowNs() - start;
+    if (shards == 1 || NumThreads() == 1)
+      counters->busy_ns += NowNs() - start;
+  }
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  int id = CurrentThreadId();
+  if (id < 0)
+    id = next_++ % workers_.size();
+  pending_++;
+  {
+    std::lock_guard<std::mutex> lock(workers_[id]->mu);
+    workers_[id]->tasks.push_back(std::move(task));
+  }
+  //the lock pairs with the check in Loop, so that the wakeup is not lost
+  { std::lock_guard<std::mutex> lock(mu_); }
+  cv_.notify_one();
+}
+
+bool ThreadPool::PopOwn(int id, std::function<void()>* task) {
+  Worker* w = workers_[id].get();
+  std::lock_guard<std::mutex> lock(w->mu);
+  if (w->tasks.empty())
+    return false;
+  *task = std::move(w->tasks.back());
+  w->tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::Steal(int id, std::function<void()>* task) {
+  for (int i = 1; i < workers_.size(); i++) {
+    Worker* w = workers_[(id + i) % workers_.size()].get();
+    std::lock_guard<std::mutex> lock(w->mu);
+    if (!w->tasks.empty()) {
+      *task = std::move(w->tasks.front());
+      w->tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Pin(int id) {
+  int cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(id % cores, &set);
+  if (pthread_setaffinity_np(workers_[id]->thread.native_handle(),
+                             sizeof(set), &set) != 0)
+    LOG(WARNING) << "Pinning worker " << id << " failed";
+}
+
+void ThreadPool::Loop(int id) {
+  current_worker.pool = this;
+  current_worker.id = id;
+  while (true) {
+    std::function<void()> task;
+    if (PopOwn(id, &task) || Steal(id, &task)) {
+      pending_--;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0)
+      return;
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef CAVS_UTIL_THREAD_POOL_H_
+#define CAVS_UTIL_THREAD_POOL_H_
+
+#include "cavs/util/macros.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//CPU threads with one task queue each.
+//A worker runs the newest task of its own queue first(the one it has just
+//made ready, whose inputs are still in its cache), and steals the oldest
+//task of the others when its queue is empty.
+//One pool is shared by the statements(inter-op) and the kernels(intra-op),
+//so that the two levels never run more threads than the cores.
+class ThreadPool {
+ public:
+  //per kernel, to see how well the kernel is spread over the threads
+  struct KernelCounters {
+    std::atomic<int64_t> calls;
+    std::atomic<int64_t> shards;
+    //the time spent in the shards, and in the whole ParallelFor
+    std::atomic<int64_t> busy_ns;
+    std::atomic<int64_t> wall_ns;
+    KernelCounters() : calls(0), shards(0), busy_ns(0), wall_ns(0) {}
+  };
+
+  //pinned workers are bound to the cores one by one
+  explicit ThreadPool(int num_threads, bool pin = false);
+  ~ThreadPool();
+  //called from a worker, the task goes to the queue of that worker
+  void Schedule(std::function<void()> task);
+  //runs fn on the shards of [begin, end), each of at least grain units.
+  //The caller runs shards too, so it can be called from a worker.
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                   const std::function<void(int64_t, int64_t)>& fn,
+                   KernelCounters* counters = NULL);
+  FORCE_INLINE int NumThreads() const { return workers_.size(); }
+  //the index of the worker running the caller, -1 for the other threads
+  int CurrentThreadId() const;
+
+  //the shard size for units of the given cost(about a nanosecond each),
+  //large enough to amortize the scheduling, small enough to balance the load
+  static int64_t GrainSize(int64_t total, double cost_per_unit, int num_threads);
+
+  //shared by the sessions and the kernels,
+  //with one thread per core unless it is configured before the first use
+  static ThreadPool* Get();
+  static void Configure(int num_threads, bool pin);
+  static KernelCounters* Counters(const std::string& kernel);
+  static std::string UtilizationInfo();
+
+ private:
+  struct Worker {
+    std::mutex mu;
+    std::deque<std::function<void()>> tasks;
+    std::thread thread;
+  };
+  bool PopOwn(int id, std::function<void()>* task);
+  bool Steal(int id, std::function<void()>* task);
+  void Loop(int id);
+  void Pin(int id);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<int> pending_;
+  std::atomic<unsigned> next_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+#endif
@@ -3,9 +3,11 @@
 
 #include "cavs/util/macros_gpu.h"
 
+#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <utility>
+#include <vector>
 
 class Timing {
  public:
@@ -24,8 +26,11 @@ class Timing {
       Get()->event_[name] = std::make_pair(start, stop);
     }
 
-    if (Get()->time_in_ms_.find(name) == Get()->time_in_ms_.end())
-      Get()->time_in_ms_[name] = 0;
+    {
+      std::lock_guard<std::mutex> lock(Get()->time_mu_);
+      if (Get()->time_in_ms_.find(name) == Get()->time_in_ms_.end())
+        Get()->time_in_ms_[name] = 0;
+    }
     cudaEvent_t start = Get()->event_[name].first;
     checkCudaError(cudaEventRecord(start));
   }
@@ -42,26 +47,64 @@ class Timing {
     checkCudaError(cudaEventSynchronize(stop));
     float ms = 0;
     checkCudaError(cudaEventElapsedTime(&ms, start, stop));
+    std::lock_guard<std::mutex> lock(Get()->time_mu_);
     CHECK(Get()->time_in_ms_.find(name) != Get()->time_in_ms_.end());
     Get()->time_in_ms_[name] += ms;
   }
 
+  //summed over the threads
   static float TimeInMs(const std::string& name) {
-    CHECK(Get()->time_in_ms_.find(name) != Get()->time_in_ms_.end()); 
-    return Get()->time_in_ms_[name];
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    bool found = false;
+    float ms = 0;
+    for (auto* t : registry()) {
+      std::lock_guard<std::mutex> time_lock(t->time_mu_);
+      if (t->time_in_ms_.find(name) != t->time_in_ms_.end()) {
+        found = true;
+        ms += t->time_in_ms_[name];
+      }
+    }
+    CHECK(found) << name;
+    return ms;
   }
   static void Reset(const std::string& name) {
-    CHECK(Get()->time_in_ms_.find(name) != Get()->time_in_ms_.end()); 
-    Get()->time_in_ms_[name] = 0;
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    bool found = false;
+    for (auto* t : registry()) {
+      std::lock_guard<std::mutex> time_lock(t->time_mu_);
+      if (t->time_in_ms_.find(name) != t->time_in_ms_.end()) {
+        found = true;
+        t->time_in_ms_[name] = 0;
+      }
+    }
+    CHECK(found) << name;
   }
 
  private:
+  //one for each thread, so that the sessions running on
+  //different threads time themselves without interfering.
+  //They are never freed, the readers may still visit them.
   static Timing* Get() {
-    static Timing t; 
-    return &t;
+    thread_local Timing* t = NULL;
+    if (!t) {
+      t = new Timing();
+      std::lock_guard<std::mutex> lock(registry_mutex());
+      registry().push_back(t);
+    }
+    return t;
+  }
+  static std::vector<Timing*>& registry() {
+    static std::vector<Timing*> timings;
+    return timings;
+  }
+  static std::mutex& registry_mutex() {
+    static std::mutex mu;
+    return mu;
   }
   std::unordered_map<std::string, bool> status_;//0 null; 1:timing
   std::unordered_map<std::string, std::pair<cudaEvent_t, cudaEvent_t>> event_;
+  //read by the other threads
+  std::mutex time_mu_;
   std::unordered_map<std::string, float> time_in_ms_;
 
 };